@@ -0,0 +1,230 @@
+// Copyright (c) 2025-2026 Juantgd. All Rights Reserved.
+
+// 缓冲池内存块的页类型对比压测，用于选择buffer_hugepages
+// 对普通页、透明大页与预留大页分别分配同样大小的缓冲池，统计分配耗时、
+// 实际由大页支撑的内存、向随机缓冲区拷贝消息的耗时，
+// 以及逐个缓冲区注册与按内存块注册为固定缓冲区的耗时
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <sys/uio.h>
+
+#include <liburing.h>
+
+#include "utils/numa.h"
+
+namespace {
+
+using bench_clock = std::chrono::steady_clock;
+using jdocs::kHugePageSize;
+
+// io_uring每个实例最多注册的固定缓冲区数量
+constexpr uint32_t kMaxRegBuffers = 1 << 14;
+
+enum page_mode_t { kPageNormal, kPageThp, kPageHugetlb };
+
+const char *const kPageModeNames[] = {"off", "thp", "hugetlb"};
+
+struct bench_options {
+  // 缓冲池总大小，单位MiB
+  uint32_t mbytes{32};
+  uint32_t buffer{2048};
+  // 普通页的内存块大小，大页模式下至少为一个大页
+  uint32_t block{2048 * 256};
+  // 每条消息的大小与拷贝次数
+  uint32_t msg{256};
+  uint32_t copies{4000000};
+  uint32_t seed{1};
+};
+
+struct bench_result {
+  // 实际使用的页类型，预留大页不足时退回透明大页
+  page_mode_t backing;
+  double alloc_ms;
+  // 由大页支撑的内存，单位KiB
+  uint64_t huge_kb;
+  double copy_ns;
+  // 注册并注销全部固定缓冲区的耗时，-1表示注册失败或数量超出注册上限
+  double reg_buffer_us;
+  double reg_block_us;
+};
+
+bool parse_option(const char *arg, const char *name, uint32_t *value) {
+  size_t len = strlen(name);
+  if (strncmp(arg, name, len) != 0 || arg[len] != '=')
+    return false;
+  *value = static_cast<uint32_t>(strtoul(arg + len + 1, nullptr, 0));
+  return true;
+}
+
+void usage() {
+  printf("usage: pool_bench [--mbytes=32] [--buffer=2048] [--block=524288]\n"
+         "                  [--msg=256] [--copies=4000000] [--seed=1]\n");
+}
+
+inline bool is_power_of_two(uint32_t n) { return n && !(n & (n - 1)); }
+
+bool parse_options(int argc, char *argv[], bench_options *options) {
+  for (int i = 1; i < argc; ++i) {
+    if (!parse_option(argv[i], "--mbytes", &options->mbytes) &&
+        !parse_option(argv[i], "--buffer", &options->buffer) &&
+        !parse_option(argv[i], "--block", &options->block) &&
+        !parse_option(argv[i], "--msg", &options->msg) &&
+        !parse_option(argv[i], "--copies", &options->copies) &&
+        !parse_option(argv[i], "--seed", &options->seed))
+      return false;
+  }
+  // 与服务端相同，缓冲区大小与块大小均为2的幂
+  return options->mbytes && is_power_of_two(options->buffer) &&
+         is_power_of_two(options->block) &&
+         options->block >= options->buffer && options->msg &&
+         options->msg <= options->buffer && options->copies;
+}
+
+// 从/proc/self/smaps_rollup中读取由大页支撑的内存，单位KiB
+uint64_t huge_kbytes() {
+  std::ifstream file("/proc/self/smaps_rollup");
+  std::string line;
+  uint64_t value, total = 0;
+  while (std::getline(file, line)) {
+    if (sscanf(line.c_str(), "AnonHugePages: %lu", &value) == 1 ||
+        sscanf(line.c_str(), "Private_Hugetlb: %lu", &value) == 1)
+      total += value;
+  }
+  return total;
+}
+
+double elapsed(bench_clock::time_point begin) {
+  return std::chrono::duration<double, std::micro>(bench_clock::now() - begin)
+      .count();
+}
+
+// 注册iovecs中的全部固定缓冲区后立即注销，返回耗时，失败时返回-1
+double register_cost(struct io_uring *ring,
+                     const std::vector<struct iovec> &iovecs) {
+  auto begin = bench_clock::now();
+  int ret = io_uring_register_buffers(ring, iovecs.data(),
+                                      static_cast<unsigned>(iovecs.size()));
+  if (ret) {
+    fprintf(stderr, "io_uring_register_buffers: %s\n", strerror(-ret));
+    return -1;
+  }
+  io_uring_unregister_buffers(ring);
+  return elapsed(begin);
+}
+
+bool run_bench(struct io_uring *ring, page_mode_t mode,
+               const bench_options &options, bench_result *result) {
+  *result = {};
+  result->backing = mode;
+  size_t block = options.block;
+  if (mode != kPageNormal && block < kHugePageSize)
+    block = kHugePageSize;
+  size_t total = size_t(options.mbytes) << 20;
+  size_t blocks = (total + block - 1) / block;
+  uint64_t huge_begin = huge_kbytes();
+  std::vector<char *> pool;
+  auto begin = bench_clock::now();
+  for (size_t i = 0; i != blocks; ++i) {
+    void *addr;
+    if (mode == kPageNormal) {
+      addr = jdocs::alloc_block(block);
+    } else {
+      bool hugetlb = mode == kPageHugetlb;
+      addr = jdocs::alloc_huge_block(block, &hugetlb);
+      if (mode == kPageHugetlb && !hugetlb)
+        result->backing = kPageThp;
+    }
+    if (!addr) {
+      for (char *p : pool)
+        jdocs::free_block(p, block);
+      return false;
+    }
+    pool.push_back(static_cast<char *>(addr));
+  }
+  result->alloc_ms = elapsed(begin) / 1000;
+  uint64_t huge_end = huge_kbytes();
+  result->huge_kb = huge_end > huge_begin ? huge_end - huge_begin : 0;
+
+  // 每次拷贝写入随机选择的缓冲区，模拟大量连接各自使用不同的缓冲区
+  uint32_t per_block = static_cast<uint32_t>(block / options.buffer);
+  uint64_t buffers = uint64_t(per_block) * blocks;
+  std::vector<uint32_t> targets(options.copies);
+  std::mt19937 rng(options.seed);
+  std::uniform_int_distribution<uint64_t> dist(0, buffers - 1);
+  for (auto &target : targets)
+    target = static_cast<uint32_t>(dist(rng));
+  std::vector<char> message(options.msg, 'x');
+  begin = bench_clock::now();
+  for (uint32_t target : targets) {
+    char *buffer = pool[target / per_block] +
+                   size_t(target % per_block) * options.buffer;
+    memcpy(buffer, message.data(), options.msg);
+  }
+  result->copy_ns = elapsed(begin) * 1000 / options.copies;
+
+  std::vector<struct iovec> iovecs;
+  if (buffers <= kMaxRegBuffers) {
+    for (uint64_t i = 0; i != buffers; ++i)
+      iovecs.push_back({pool[i / per_block] +
+                            size_t(i % per_block) * options.buffer,
+                        options.buffer});
+    result->reg_buffer_us = register_cost(ring, iovecs);
+  } else {
+    result->reg_buffer_us = -1;
+  }
+  iovecs.clear();
+  for (char *p : pool)
+    iovecs.push_back({p, block});
+  result->reg_block_us = register_cost(ring, iovecs);
+
+  for (char *p : pool)
+    jdocs::free_block(p, block);
+  return true;
+}
+
+void print_result(page_mode_t mode, const bench_result &r) {
+  printf("%-8s %-8s %10.2f %10lu %9.2f %13.1f %12.1f\n", kPageModeNames[mode],
+         kPageModeNames[r.backing], r.alloc_ms, r.huge_kb, r.copy_ns,
+         r.reg_buffer_us, r.reg_block_us);
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+  bench_options options;
+  if (!parse_options(argc, argv, &options)) {
+    usage();
+    return EXIT_FAILURE;
+  }
+  struct io_uring ring;
+  int ret = io_uring_queue_init(8, &ring, 0);
+  if (ret < 0) {
+    fprintf(stderr, "io_uring_queue_init: %s\n", strerror(-ret));
+    return EXIT_FAILURE;
+  }
+  printf("pool: %u MiB, buffer: %u B, block: %u B, msg: %u B, copies: %u\n",
+         options.mbytes, options.buffer, options.block, options.msg,
+         options.copies);
+  printf("%-8s %-8s %10s %10s %9s %13s %12s\n", "mode", "backing",
+         "alloc(ms)", "huge(KiB)", "copy(ns)", "reg_buf(us)", "reg_blk(us)");
+  bool ok = true;
+  for (page_mode_t mode : {kPageNormal, kPageThp, kPageHugetlb}) {
+    bench_result result;
+    if (!run_bench(&ring, mode, options, &result)) {
+      ok = false;
+      break;
+    }
+    print_result(mode, result);
+  }
+  io_uring_queue_exit(&ring);
+  return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
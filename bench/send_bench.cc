@@ -0,0 +1,303 @@
+// Copyright (c) 2025-2026 Juantgd. All Rights Reserved.
+
+// 普通发送与零拷贝发送的对比压测，用于选择send_zc_threshold
+// 对每个消息大小分别使用io_uring的send与send_zc发送相同的数据量，
+// 统计吞吐量、发送线程每字节的CPU时间以及每条消息的完成事件数量
+// 未指定--host时在本机回环地址上启动一个只读取数据的接收线程，
+// 测试网卡时在对端运行任意丢弃数据的服务，例如`nc -lk 9000 > /dev/null`
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <liburing.h>
+
+namespace {
+
+using bench_clock = std::chrono::steady_clock;
+
+struct bench_options {
+  std::string host;
+  uint16_t port{0};
+  // 每个消息大小发送的总字节数
+  uint64_t bytes{256ull << 20};
+  // 同时在途的发送请求数量，服务端每个连接同一时刻只有一个
+  uint32_t depth{1};
+  std::vector<uint32_t> sizes{64,   256,   1024,  4096,   8192,
+                              16384, 32768, 65536, 262144};
+};
+
+struct bench_result {
+  double seconds;
+  double cpu_seconds;
+  uint64_t messages;
+  uint64_t cqes;
+};
+
+bool parse_option(const char *arg, const char *name, uint32_t *value) {
+  size_t len = strlen(name);
+  if (strncmp(arg, name, len) != 0 || arg[len] != '=')
+    return false;
+  *value = static_cast<uint32_t>(strtoul(arg + len + 1, nullptr, 0));
+  return true;
+}
+
+bool parse_sizes(const char *arg, std::vector<uint32_t> *sizes) {
+  sizes->clear();
+  while (*arg) {
+    char *end;
+    uint32_t size = static_cast<uint32_t>(strtoul(arg, &end, 0));
+    if (end == arg || size == 0)
+      return false;
+    sizes->push_back(size);
+    arg = *end == ',' ? end + 1 : end;
+  }
+  return !sizes->empty();
+}
+
+void usage() {
+  printf("usage: send_bench [--host=] [--port=0] [--mbytes=256] [--depth=1]\n"
+         "                  [--sizes=64,256,1024,...]\n");
+}
+
+bool parse_options(int argc, char *argv[], bench_options *options) {
+  uint32_t value;
+  for (int i = 1; i < argc; ++i) {
+    if (strncmp(argv[i], "--host=", 7) == 0) {
+      options->host = argv[i] + 7;
+    } else if (strncmp(argv[i], "--sizes=", 8) == 0) {
+      if (!parse_sizes(argv[i] + 8, &options->sizes))
+        return false;
+    } else if (parse_option(argv[i], "--port", &value)) {
+      options->port = static_cast<uint16_t>(value);
+    } else if (parse_option(argv[i], "--mbytes", &value)) {
+      options->bytes = uint64_t(value) << 20;
+    } else if (!parse_option(argv[i], "--depth", &options->depth)) {
+      return false;
+    }
+  }
+  return options->bytes && options->depth &&
+         (options->host.empty() || options->port);
+}
+
+double cpu_seconds() {
+  struct rusage usage;
+  getrusage(RUSAGE_THREAD, &usage);
+  return static_cast<double>(usage.ru_utime.tv_sec + usage.ru_stime.tv_sec) +
+         static_cast<double>(usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) /
+             1e6;
+}
+
+// 本机的接收端，逐个接受连接并读取数据直到对端关闭
+void run_sink(int listen_fd) {
+  std::vector<char> buffer(1 << 20);
+  for (;;) {
+    int fd = accept(listen_fd, nullptr, nullptr);
+    if (fd < 0)
+      return;
+    while (read(fd, buffer.data(), buffer.size()) > 0) {
+    }
+    close(fd);
+  }
+}
+
+int start_sink(uint16_t *port) {
+  int fd = socket(AF_INET, SOCK_STREAM, 0);
+  sockaddr_in addr{};
+  addr.sin_family = AF_INET;
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  addr.sin_port = htons(*port);
+  socklen_t len = sizeof(addr);
+  if (bind(fd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) < 0 ||
+      listen(fd, 16) < 0 ||
+      getsockname(fd, reinterpret_cast<sockaddr *>(&addr), &len) < 0) {
+    perror("sink");
+    close(fd);
+    return -1;
+  }
+  *port = ntohs(addr.sin_port);
+  return fd;
+}
+
+int connect_sink(const std::string &host, uint16_t port) {
+  sockaddr_in addr{};
+  addr.sin_family = AF_INET;
+  addr.sin_port = htons(port);
+  if (inet_pton(AF_INET, host.c_str(), &addr.sin_addr) != 1) {
+    fprintf(stderr, "invalid host: %s\n", host.c_str());
+    return -1;
+  }
+  int fd = socket(AF_INET, SOCK_STREAM, 0);
+  if (connect(fd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) < 0) {
+    perror("connect");
+    close(fd);
+    return -1;
+  }
+  int one = 1;
+  setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+  return fd;
+}
+
+// 以depth个在途请求发送bytes字节，每个请求使用各自的缓冲区
+// 零拷贝发送的缓冲区在通知事件到达后才能再次使用
+bool run_bench(struct io_uring *ring, int fd, uint32_t size, bool zero_copy,
+               const bench_options &options, bench_result *result) {
+  uint64_t total = options.bytes / size;
+  if (total == 0)
+    total = 1;
+  std::vector<std::vector<char>> buffers(options.depth,
+                                         std::vector<char>(size, 'x'));
+  // 每个缓冲区尚未完成的事件数量：发送结果以及零拷贝的通知
+  std::vector<uint32_t> busy(options.depth, 0);
+  uint64_t submitted = 0, completed = 0;
+  *result = {};
+  double cpu_begin = cpu_seconds();
+  auto begin = bench_clock::now();
+  while (completed < total) {
+    for (uint32_t i = 0; i != options.depth && submitted < total; ++i) {
+      if (busy[i])
+        continue;
+      struct io_uring_sqe *sqe = io_uring_get_sqe(ring);
+      if (zero_copy) {
+        io_uring_prep_send_zc(sqe, fd, buffers[i].data(), size,
+                              MSG_WAITALL | MSG_NOSIGNAL, 0);
+      } else {
+        io_uring_prep_send(sqe, fd, buffers[i].data(), size,
+                           MSG_WAITALL | MSG_NOSIGNAL);
+      }
+      io_uring_sqe_set_data64(sqe, i);
+      busy[i] = 1;
+      ++submitted;
+    }
+    struct io_uring_cqe *cqe;
+    int ret = io_uring_submit_and_wait(ring, 1);
+    if (ret < 0 && ret != -EINTR) {
+      fprintf(stderr, "io_uring_submit_and_wait: %s\n", strerror(-ret));
+      return false;
+    }
+    unsigned head, count = 0;
+    io_uring_for_each_cqe(ring, head, cqe) {
+      ++count;
+      uint64_t i = io_uring_cqe_get_data64(cqe);
+      if (cqe->flags & IORING_CQE_F_NOTIF) {
+        --busy[i];
+        continue;
+      }
+      if (cqe->res < 0) {
+        fprintf(stderr, "send failed: %s\n", strerror(-cqe->res));
+        return false;
+      }
+      // 零拷贝发送在结果之后还有一个通知事件
+      if (!(cqe->flags & IORING_CQE_F_MORE))
+        --busy[i];
+      ++completed;
+    }
+    io_uring_cq_advance(ring, count);
+    result->cqes += count;
+  }
+  // 等待剩余的通知事件，保证下一轮开始时缓冲区均可用
+  for (uint32_t i = 0; i != options.depth; ++i) {
+    while (busy[i]) {
+      struct io_uring_cqe *cqe;
+      if (io_uring_wait_cqe(ring, &cqe) < 0)
+        return false;
+      --busy[io_uring_cqe_get_data64(cqe)];
+      io_uring_cqe_seen(ring, cqe);
+      ++result->cqes;
+    }
+  }
+  result->seconds =
+      std::chrono::duration<double>(bench_clock::now() - begin).count();
+  result->cpu_seconds = cpu_seconds() - cpu_begin;
+  result->messages = total;
+  return true;
+}
+
+void print_result(uint32_t size, const char *name, const bench_result &r) {
+  double bytes = static_cast<double>(r.messages) * size;
+  printf("%9u %-5s %10.1f %12.3f %10.2f\n", size, name,
+         bytes / r.seconds / (1 << 20), r.cpu_seconds * 1e9 / bytes,
+         static_cast<double>(r.cqes) / static_cast<double>(r.messages));
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+  bench_options options;
+  if (!parse_options(argc, argv, &options)) {
+    usage();
+    return EXIT_FAILURE;
+  }
+  std::thread sink;
+  int listen_fd = -1;
+  if (options.host.empty()) {
+    listen_fd = start_sink(&options.port);
+    if (listen_fd < 0)
+      return EXIT_FAILURE;
+    sink = std::thread(run_sink, listen_fd);
+    options.host = "127.0.0.1";
+  }
+  struct io_uring ring;
+  int ret = io_uring_queue_init(256, &ring, 0);
+  if (ret < 0) {
+    fprintf(stderr, "io_uring_queue_init: %s\n", strerror(-ret));
+    return EXIT_FAILURE;
+  }
+  printf("target: %s:%u, %lu MiB per run, depth: %u\n", options.host.c_str(),
+         options.port, options.bytes >> 20, options.depth);
+  printf("%9s %-5s %10s %12s %10s\n", "size(B)", "mode", "MiB/s",
+         "cpu(ns)/B", "cqes/msg");
+  // 零拷贝在吞吐量与CPU时间上均不差于普通发送的最小消息大小
+  uint32_t crossover = 0;
+  bool ok = true;
+  for (uint32_t size : options.sizes) {
+    // 每种方式使用新的连接，避免前一轮残留的发送队列影响结果
+    bench_result copy, zc;
+    int fd = connect_sink(options.host, options.port);
+    ok = fd >= 0 && run_bench(&ring, fd, size, false, options, &copy);
+    if (fd >= 0)
+      close(fd);
+    if (!ok)
+      break;
+    fd = connect_sink(options.host, options.port);
+    ok = fd >= 0 && run_bench(&ring, fd, size, true, options, &zc);
+    if (fd >= 0)
+      close(fd);
+    if (!ok)
+      break;
+    print_result(size, "send", copy);
+    print_result(size, "zc", zc);
+    bool better = zc.seconds <= copy.seconds &&
+                  zc.cpu_seconds / static_cast<double>(zc.messages) <=
+                      copy.cpu_seconds / static_cast<double>(copy.messages);
+    if (better && !crossover)
+      crossover = size;
+    else if (!better)
+      crossover = 0;
+  }
+  if (ok) {
+    if (crossover)
+      printf("suggested send_zc_threshold: %u\n", crossover);
+    else
+      printf("send_zc never won, suggested send_zc_threshold: 0\n");
+  }
+  io_uring_queue_exit(&ring);
+  if (listen_fd >= 0) {
+    shutdown(listen_fd, SHUT_RDWR);
+    close(listen_fd);
+    sink.join();
+  }
+  return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,175 @@
+// Copyright (c) 2025-2026 Juantgd. All Rights Reserved.
+
+// 时间轮计时器压测工具，对比侵入式回调与std::function回调两种计时器节点
+// 统计每个计时器占用的内存（节点大小与堆内存）、添加耗时以及触发耗时
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <new>
+#include <random>
+#include <vector>
+
+#include "core/timer.h"
+
+namespace {
+
+using bench_clock = std::chrono::steady_clock;
+using jdocs::TimeWheel;
+
+// 统计计时器创建过程中的堆内存分配
+uint64_t heap_bytes = 0;
+uint64_t heap_allocs = 0;
+
+struct bench_options {
+  uint32_t timers{1000000};
+  // 计时器的到期时间均匀分布在之后的spread个刻度内
+  uint32_t spread{1000};
+  uint32_t seed{1};
+};
+
+// 改动前的计时器节点布局，只用于比较节点大小
+struct legacy_timer_node {
+  uint64_t expires_;
+  std::function<void()> callback_;
+  legacy_timer_node *next, **pprev;
+  bool flag;
+};
+
+// 模拟连接对象中嵌入的计时器，使用成员函数作为回调
+struct intrusive_owner {
+  uint64_t fired{0};
+  TimeWheel::timer_node timer =
+      TimeWheel::timer_node::Bind<&intrusive_owner::on_timeout>(this);
+  void on_timeout() { ++fired; }
+};
+
+// 通过兼容接口使用lambda作为回调
+struct function_owner {
+  uint64_t fired{0};
+  TimeWheel::timer_node timer{[this] { ++fired; }};
+};
+
+struct bench_result {
+  double create_ns;
+  double add_ns;
+  double fire_ns;
+  uint64_t heap_bytes;
+  uint64_t heap_allocs;
+  uint64_t fired;
+};
+
+bool parse_option(const char *arg, const char *name, uint32_t *value) {
+  size_t len = strlen(name);
+  if (strncmp(arg, name, len) != 0 || arg[len] != '=')
+    return false;
+  *value = static_cast<uint32_t>(strtoul(arg + len + 1, nullptr, 0));
+  return true;
+}
+
+void usage() {
+  printf("usage: timer_bench [--timers=1000000] [--spread=1000] [--seed=1]\n");
+}
+
+bool parse_options(int argc, char *argv[], bench_options *options) {
+  for (int i = 1; i < argc; ++i) {
+    if (!parse_option(argv[i], "--timers", &options->timers) &&
+        !parse_option(argv[i], "--spread", &options->spread) &&
+        !parse_option(argv[i], "--seed", &options->seed))
+      return false;
+  }
+  return options->timers && options->spread;
+}
+
+double elapsed_ns(bench_clock::time_point begin) {
+  return std::chrono::duration<double, std::nano>(bench_clock::now() - begin)
+      .count();
+}
+
+template <typename Owner>
+bench_result run_bench(const bench_options &options,
+                       const std::vector<uint32_t> &delays) {
+  bench_result result{};
+  uint64_t bytes = heap_bytes, allocs = heap_allocs;
+  auto begin = bench_clock::now();
+  // 计时器嵌入在所属对象中，对象创建后地址不能改变
+  std::unique_ptr<Owner[]> owners(new Owner[options.timers]);
+  result.create_ns = elapsed_ns(begin) / options.timers;
+  // 减去所属对象数组本身的分配
+  result.heap_bytes = heap_bytes - bytes - sizeof(Owner) * options.timers;
+  result.heap_allocs = heap_allocs - allocs - 1;
+
+  // 刻度为1毫秒，延迟即为刻度数
+  TimeWheel wheel(1);
+  begin = bench_clock::now();
+  for (uint32_t i = 0; i != options.timers; ++i)
+    wheel.AddTimer(&owners[i].timer, delays[i]);
+  result.add_ns = elapsed_ns(begin) / options.timers;
+
+  begin = bench_clock::now();
+  for (uint32_t i = 0; i != options.spread; ++i)
+    wheel.Tick();
+  result.fire_ns = elapsed_ns(begin) / options.timers;
+  for (uint32_t i = 0; i != options.timers; ++i)
+    result.fired += owners[i].fired;
+  return result;
+}
+
+void print_result(const char *name, size_t node_size,
+                  const bench_result &result, uint32_t timers) {
+  printf("%-10s %9zu %14.1f %12.1f %11.1f %9.1f %10.1f %10lu\n", name,
+         node_size, static_cast<double>(result.heap_bytes) / timers,
+         static_cast<double>(result.heap_allocs) / timers, result.create_ns,
+         result.add_ns, result.fire_ns, result.fired);
+}
+
+} // namespace
+
+void *operator new(size_t size) {
+  heap_bytes += size;
+  ++heap_allocs;
+  void *ptr = malloc(size ? size : 1);
+  if (!ptr)
+    throw std::bad_alloc();
+  return ptr;
+}
+
+void *operator new[](size_t size) { return operator new(size); }
+
+void operator delete(void *ptr) noexcept { free(ptr); }
+void operator delete(void *ptr, size_t) noexcept { free(ptr); }
+void operator delete[](void *ptr) noexcept { free(ptr); }
+void operator delete[](void *ptr, size_t) noexcept { free(ptr); }
+
+int main(int argc, char *argv[]) {
+  bench_options options;
+  if (!parse_options(argc, argv, &options)) {
+    usage();
+    return EXIT_FAILURE;
+  }
+  // 两种节点使用相同的到期时间序列
+  std::vector<uint32_t> delays(options.timers);
+  std::mt19937 rng(options.seed);
+  std::uniform_int_distribution<uint32_t> dist(1, options.spread);
+  for (auto &delay : delays)
+    delay = dist(rng);
+
+  printf("timers: %u, spread: %u ticks, legacy node size: %zu bytes\n",
+         options.timers, options.spread, sizeof(legacy_timer_node));
+  printf("%-10s %9s %14s %12s %11s %9s %10s %10s\n", "callback", "node(B)",
+         "heap(B)/timer", "allocs/timer", "create(ns)", "add(ns)", "fire(ns)",
+         "fired");
+  bench_result intrusive = run_bench<intrusive_owner>(options, delays);
+  print_result("intrusive", sizeof(TimeWheel::timer_node), intrusive,
+               options.timers);
+  bench_result function = run_bench<function_owner>(options, delays);
+  print_result("function", sizeof(TimeWheel::timer_node), function,
+               options.timers);
+  return intrusive.fired == options.timers && function.fired == options.timers
+             ? EXIT_SUCCESS
+             : EXIT_FAILURE;
+}
@@ -0,0 +1,408 @@
+// Copyright (c) 2025-2026 Juantgd. All Rights Reserved.
+
+// websocket压测工具，模拟多个客户端对文档服务进行编辑
+// 每个连接同一时刻只有一个未确认的编辑请求（闭环压测），
+// 统计编辑请求从发送到收到ack的延迟分布以及整体吞吐量
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <arpa/inet.h>
+#include <endian.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+namespace {
+
+using bench_clock = std::chrono::steady_clock;
+
+struct bench_options {
+  std::string host{"127.0.0.1"};
+  uint16_t port{7788};
+  uint32_t connections{64};
+  uint32_t threads{4};
+  uint32_t duration{10};
+  uint32_t warmup{2};
+  uint32_t docs{8};
+  uint32_t payload{32};
+  uint32_t user_base{100000};
+};
+
+struct bench_connection {
+  int fd{-1};
+  uint32_t user_id{0};
+  // 已知的最新文档版本，只会小于等于服务端的实际版本
+  uint64_t version{0};
+  // 下一次编辑是插入还是删除，交替进行以避免文档无限增长
+  bool insert{true};
+  bench_clock::time_point send_time;
+  // 接收缓冲区以及分片消息的拼接缓冲区
+  std::string in;
+  std::string message;
+};
+
+struct bench_result {
+  uint64_t acks{0};
+  uint64_t broadcasts{0};
+  uint64_t errors{0};
+  std::vector<uint32_t> latencies;
+};
+
+std::atomic<bool> measuring{false};
+std::atomic<bool> stopping{false};
+
+bool parse_option(const char *arg, const char *name, uint32_t *value) {
+  size_t len = strlen(name);
+  if (strncmp(arg, name, len) != 0 || arg[len] != '=')
+    return false;
+  *value = static_cast<uint32_t>(strtoul(arg + len + 1, nullptr, 0));
+  return true;
+}
+
+void usage() {
+  printf("usage: ws_bench [--host=127.0.0.1] [--port=7788] "
+         "[--connections=64]\n"
+         "                [--threads=4] [--duration=10] [--warmup=2] "
+         "[--docs=8]\n"
+         "                [--payload=32] [--user_base=100000]\n");
+}
+
+bool parse_options(int argc, char *argv[], bench_options *options) {
+  for (int i = 1; i < argc; ++i) {
+    uint32_t value;
+    if (strncmp(argv[i], "--host=", 7) == 0) {
+      options->host = argv[i] + 7;
+    } else if (parse_option(argv[i], "--port", &value)) {
+      options->port = static_cast<uint16_t>(value);
+    } else if (!parse_option(argv[i], "--connections",
+                             &options->connections) &&
+               !parse_option(argv[i], "--threads", &options->threads) &&
+               !parse_option(argv[i], "--duration", &options->duration) &&
+               !parse_option(argv[i], "--warmup", &options->warmup) &&
+               !parse_option(argv[i], "--docs", &options->docs) &&
+               !parse_option(argv[i], "--payload", &options->payload) &&
+               !parse_option(argv[i], "--user_base", &options->user_base)) {
+      return false;
+    }
+  }
+  return options->connections && options->threads && options->docs &&
+         options->payload;
+}
+
+bool write_all(int fd, const char *data, size_t length) {
+  while (length) {
+    ssize_t n = write(fd, data, length);
+    if (n < 0) {
+      if (errno == EINTR || errno == EAGAIN)
+        continue;
+      return false;
+    }
+    data += n;
+    length -= static_cast<size_t>(n);
+  }
+  return true;
+}
+
+// 发送一个带掩码的文本帧，客户端发送的帧必须带掩码
+bool send_text_frame(int fd, const std::string &text) {
+  char frame[14];
+  size_t header = 2;
+  frame[0] = static_cast<char>(0x81);
+  if (text.size() < 126) {
+    frame[1] = static_cast<char>(0x80 | text.size());
+  } else if (text.size() <= UINT16_MAX) {
+    frame[1] = static_cast<char>(0x80 | 126);
+    uint16_t len = htobe16(static_cast<uint16_t>(text.size()));
+    memcpy(frame + 2, &len, 2);
+    header = 4;
+  } else {
+    frame[1] = static_cast<char>(0x80 | 127);
+    uint64_t len = htobe64(text.size());
+    memcpy(frame + 2, &len, 8);
+    header = 10;
+  }
+  // 掩码固定为0，负载无需变换
+  memset(frame + header, 0, 4);
+  header += 4;
+  std::string out(frame, header);
+  out.append(text);
+  return write_all(fd, out.data(), out.size());
+}
+
+// 从接收缓冲区中取出一条完整消息，分片消息会被拼接，控制帧会被忽略
+bool next_message(bench_connection *conn, std::string *message) {
+  for (;;) {
+    const std::string &in = conn->in;
+    if (in.size() < 2)
+      return false;
+    uint8_t byte0 = static_cast<uint8_t>(in[0]);
+    uint64_t length = static_cast<uint8_t>(in[1]) & 0x7F;
+    size_t header = 2;
+    if (length == 126) {
+      if (in.size() < 4)
+        return false;
+      uint16_t len;
+      memcpy(&len, in.data() + 2, 2);
+      length = be16toh(len);
+      header = 4;
+    } else if (length == 127) {
+      if (in.size() < 10)
+        return false;
+      uint64_t len;
+      memcpy(&len, in.data() + 2, 8);
+      length = be64toh(len);
+      header = 10;
+    }
+    if (in.size() < header + length)
+      return false;
+    uint8_t opcode = byte0 & 0x0F;
+    bool fin = (byte0 & 0x80) != 0;
+    if (opcode < 0x08)
+      conn->message.append(in, header, length);
+    conn->in.erase(0, header + length);
+    if (opcode < 0x08 && fin) {
+      message->swap(conn->message);
+      conn->message.clear();
+      return true;
+    }
+  }
+}
+
+// 从消息中提取"v"字段的值，不存在时返回0
+uint64_t message_version(const std::string &message) {
+  size_t pos = message.find("\"v\":");
+  if (pos == std::string::npos)
+    return 0;
+  return strtoull(message.c_str() + pos + 4, nullptr, 10);
+}
+
+bool send_edit(bench_connection *conn, const bench_options &options) {
+  std::string text("{\"type\":\"edit\",\"v\":");
+  text.append(std::to_string(conn->version)).append(",\"ops\":{\"ops\":[");
+  if (conn->insert) {
+    text.append("{\"insert\":\"")
+        .append(std::string(options.payload, 'x'))
+        .append("\"}");
+  } else {
+    text.append("{\"delete\":")
+        .append(std::to_string(options.payload))
+        .append("}");
+  }
+  text.append("]}}");
+  conn->insert = !conn->insert;
+  conn->send_time = bench_clock::now();
+  return send_text_frame(conn->fd, text);
+}
+
+// 以阻塞方式读取直到得到一条完整消息
+bool read_message(bench_connection *conn, std::string *message) {
+  char buf[4096];
+  while (!next_message(conn, message)) {
+    ssize_t n = read(conn->fd, buf, sizeof(buf));
+    if (n <= 0)
+      return false;
+    conn->in.append(buf, static_cast<size_t>(n));
+  }
+  return true;
+}
+
+// 建立连接，完成websocket握手并打开文档
+bool connect_client(bench_connection *conn, const bench_options &options,
+                    uint32_t index) {
+  sockaddr_in addr{};
+  addr.sin_family = AF_INET;
+  addr.sin_port = htons(options.port);
+  if (inet_pton(AF_INET, options.host.c_str(), &addr.sin_addr) != 1) {
+    fprintf(stderr, "invalid host: %s\n", options.host.c_str());
+    return false;
+  }
+  conn->fd = socket(AF_INET, SOCK_STREAM, 0);
+  if (conn->fd < 0 ||
+      connect(conn->fd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr))) {
+    perror("connect");
+    return false;
+  }
+  int one = 1;
+  setsockopt(conn->fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+  conn->user_id = options.user_base + index;
+  std::string request("GET /document?user_id=");
+  request.append(std::to_string(conn->user_id))
+      .append(" HTTP/1.1\r\nHost: ")
+      .append(options.host)
+      .append("\r\nUpgrade: websocket\r\nConnection: Upgrade\r\n"
+              "Sec-WebSocket-Key: dGhlIHNhbXBsZSBub25jZQ==\r\n"
+              "Sec-WebSocket-Version: 13\r\n\r\n");
+  if (!write_all(conn->fd, request.data(), request.size()))
+    return false;
+  char buf[1024];
+  size_t end;
+  while ((end = conn->in.find("\r\n\r\n")) == std::string::npos) {
+    ssize_t n = read(conn->fd, buf, sizeof(buf));
+    if (n <= 0)
+      return false;
+    conn->in.append(buf, static_cast<size_t>(n));
+  }
+  if (conn->in.compare(0, 12, "HTTP/1.1 101") != 0) {
+    fprintf(stderr, "handshake failed: %s\n",
+            conn->in.substr(0, conn->in.find("\r\n")).c_str());
+    return false;
+  }
+  conn->in.erase(0, end + 4);
+  std::string open("{\"type\":\"open\",\"doc_name\":\"bench-");
+  open.append(std::to_string(index % options.docs)).append("\"}");
+  if (!send_text_frame(conn->fd, open))
+    return false;
+  // 打开文档前可能先收到其他用户加入的通知
+  std::string message;
+  do {
+    if (!read_message(conn, &message))
+      return false;
+  } while (message.find("\"type\":\"open\"") == std::string::npos);
+  conn->version = message_version(message);
+  return true;
+}
+
+void bench_main(std::vector<bench_connection> *conns,
+                const bench_options *options, bench_result *result) {
+  int epfd = epoll_create1(0);
+  for (size_t i = 0; i < conns->size(); ++i) {
+    bench_connection &conn = (*conns)[i];
+    fcntl(conn.fd, F_SETFL, fcntl(conn.fd, F_GETFL) | O_NONBLOCK);
+    epoll_event ev{};
+    ev.events = EPOLLIN;
+    ev.data.u64 = i;
+    epoll_ctl(epfd, EPOLL_CTL_ADD, conn.fd, &ev);
+    if (!send_edit(&conn, *options))
+      ++result->errors;
+  }
+  epoll_event events[64];
+  char buf[16384];
+  std::string message;
+  while (!stopping.load(std::memory_order_relaxed)) {
+    int nr = epoll_wait(epfd, events, 64, 100);
+    for (int i = 0; i < nr; ++i) {
+      bench_connection &conn = (*conns)[events[i].data.u64];
+      ssize_t n;
+      while ((n = read(conn.fd, buf, sizeof(buf))) > 0)
+        conn.in.append(buf, static_cast<size_t>(n));
+      if (n == 0) {
+        epoll_ctl(epfd, EPOLL_CTL_DEL, conn.fd, nullptr);
+        ++result->errors;
+        continue;
+      }
+      while (next_message(&conn, &message)) {
+        bool record = measuring.load(std::memory_order_relaxed);
+        if (message.find("\"type\":\"op\"") != std::string::npos) {
+          conn.version = std::max(conn.version, message_version(message));
+          if (record)
+            ++result->broadcasts;
+          continue;
+        }
+        if (message.find("\"type\":\"ack\"") == std::string::npos) {
+          // 通知消息不计入统计，其余均视为错误响应
+          if (message.find("\"type\":\"notify\"") != std::string::npos)
+            continue;
+          if (record)
+            ++result->errors;
+        }
+        // 自身的编辑已被应用，服务端版本至少前进了一个
+        ++conn.version;
+        if (record) {
+          ++result->acks;
+          result->latencies.push_back(static_cast<uint32_t>(
+              std::chrono::duration_cast<std::chrono::microseconds>(
+                  bench_clock::now() - conn.send_time)
+                  .count()));
+        }
+        if (!send_edit(&conn, *options))
+          ++result->errors;
+      }
+    }
+  }
+  close(epfd);
+}
+
+uint32_t percentile(const std::vector<uint32_t> &sorted, double p) {
+  if (sorted.empty())
+    return 0;
+  size_t index = static_cast<size_t>(p * static_cast<double>(sorted.size()));
+  return sorted[std::min(index, sorted.size() - 1)];
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+  bench_options options;
+  if (!parse_options(argc, argv, &options)) {
+    usage();
+    return EXIT_FAILURE;
+  }
+  if (options.threads > options.connections)
+    options.threads = options.connections;
+  std::vector<std::vector<bench_connection>> conns(options.threads);
+  auto setup_begin = bench_clock::now();
+  for (uint32_t i = 0; i < options.connections; ++i) {
+    std::vector<bench_connection> &group = conns[i % options.threads];
+    group.emplace_back();
+    if (!connect_client(&group.back(), options, i)) {
+      fprintf(stderr, "connection %u setup failed.\n", i);
+      return EXIT_FAILURE;
+    }
+  }
+  double setup =
+      std::chrono::duration<double>(bench_clock::now() - setup_begin).count();
+  std::vector<bench_result> results(options.threads);
+  std::vector<std::thread> threads;
+  for (uint32_t i = 0; i < options.threads; ++i)
+    threads.emplace_back(bench_main, &conns[i], &options, &results[i]);
+  std::this_thread::sleep_for(std::chrono::seconds(options.warmup));
+  measuring.store(true);
+  auto begin = bench_clock::now();
+  std::this_thread::sleep_for(std::chrono::seconds(options.duration));
+  measuring.store(false);
+  double elapsed =
+      std::chrono::duration<double>(bench_clock::now() - begin).count();
+  stopping.store(true);
+  for (auto &thread : threads)
+    thread.join();
+  for (auto &group : conns) {
+    for (auto &conn : group)
+      close(conn.fd);
+  }
+
+  bench_result total;
+  for (auto &result : results) {
+    total.acks += result.acks;
+    total.broadcasts += result.broadcasts;
+    total.errors += result.errors;
+    total.latencies.insert(total.latencies.end(), result.latencies.begin(),
+                           result.latencies.end());
+  }
+  std::sort(total.latencies.begin(), total.latencies.end());
+  printf("connections: %u, threads: %u, docs: %u, payload: %u bytes\n",
+         options.connections, options.threads, options.docs, options.payload);
+  printf("setup: %u connections opened in %.3f s (%.0f/s)\n",
+         options.connections, setup,
+         static_cast<double>(options.connections) / setup);
+  printf("edits: %lu (%.0f/s), broadcasts: %lu (%.0f/s), errors: %lu\n",
+         total.acks, static_cast<double>(total.acks) / elapsed,
+         total.broadcasts, static_cast<double>(total.broadcasts) / elapsed,
+         total.errors);
+  printf("latency(us): p50 %u, p90 %u, p99 %u, p99.9 %u, max %u\n",
+         percentile(total.latencies, 0.5), percentile(total.latencies, 0.9),
+         percentile(total.latencies, 0.99), percentile(total.latencies, 0.999),
+         total.latencies.empty() ? 0 : total.latencies.back());
+  return 0;
+}
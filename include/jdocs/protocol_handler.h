@@ -16,6 +16,10 @@ public:
   // 应用层协议处理函数
   virtual void RecvDataHandle(void *buffer, size_t length) = 0;
   virtual void TimeoutHandle() = 0;
+  // 服务器平滑退出时调用，按协议通知对端后关闭连接
+  virtual void ShutdownHandle() = 0;
+  // 没有解析到一半的数据且没有等待中的交互，热升级时只移交空闲的连接
+  virtual bool Idle() const { return false; }
 
 protected:
   TcpConnection *connection_;
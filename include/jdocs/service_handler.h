@@ -20,8 +20,17 @@ public:
   virtual bool parse_parameters(
       std::unordered_map<std::string, std::vector<std::string>> args) = 0;
 
+  // 返回值会作为回复立即发送，不能在此阻塞等待
+  // 需要等待的处理可通过EventLoop::Spawn启动协程，完成后调用SendMessage回复
   virtual std::string handle(std::string data) = 0;
 
+  // 热升级时保存服务的会话状态，新进程通过RestoreState恢复，恢复失败时返回false
+  virtual std::string SaveState() { return {}; }
+  virtual bool RestoreState(const std::string &state) { return state.empty(); }
+
+  // 没有尚未完成的异步处理，连接可以在热升级时移交
+  virtual bool Idle() const { return true; }
+
 protected:
   TcpConnection *connection_;
 };
@@ -2,116 +2,249 @@
 
 #include "buffer.h"
 
+#include <algorithm>
+
 #include <spdlog/spdlog.h>
 
 #include "context.h"
+#include "metrics.h"
+#include "utils/numa.h"
 
 namespace jdocs {
 
-BufferPool::BufferPool(struct io_uring *ring)
-    : ring_(ring), avaliable_buf_index_(kBufferEntriesMax, true) {
-  int err;
-  buf_ring_ = io_uring_setup_buf_ring(ring_, kBufferEntriesMax, bgid_, 0, &err);
-  if (!buf_ring_) {
-    spdlog::error("io_uring_setup_buf_ring failed. error: {}", strerror(-err));
-    exit(EXIT_FAILURE);
+namespace {
+
+// 不大于n的最大的2的幂
+inline uint32_t round_down_power_of_two(uint32_t n) {
+  uint32_t result = 1;
+  while (result <= n / 2)
+    result <<= 1;
+  return result;
+}
+
+} // namespace
+
+BufferPool::BufferPool(struct io_uring *ring, const ServerConfig &config)
+    : buffer_size_(config.buffer_size), block_size_(config.block_size),
+      buffer_count_(config.block_size / config.buffer_size),
+      entries_max_(config.buffer_entries_max), ring_(ring),
+      incremental_(config.recv_buffer_inc),
+      hugepages_(config.buffer_hugepages != kHugepageOff),
+      hugetlb_(config.buffer_hugepages == kHugepageTlb),
+      avaliable_buf_index_(config.buffer_entries_max, true) {
+  std::vector<uint32_t> sizes;
+  config.RecvBufferSizes(&sizes);
+  // 每个缓冲组占用的内存上限与单一缓冲组时相同，缓冲区越大数量上限越小
+  uint64_t group_bytes = uint64_t(entries_max_) * buffer_size_;
+  recv_groups_.resize(sizes.size());
+  for (size_t i = 0; i != sizes.size(); ++i) {
+    recv_group &group = recv_groups_[i];
+    group.buffer_size = sizes[i];
+    group.block_size = std::max(block_size_, sizes[i]);
+    group.buffer_count = group.block_size / sizes[i];
+    group.entries_max = std::max(
+        group.buffer_count,
+        std::min(entries_max_,
+                 round_down_power_of_two(static_cast<uint32_t>(
+                     std::min<uint64_t>(group_bytes / sizes[i], UINT32_MAX)))));
+    group.bgid = static_cast<uint16_t>(i + 1);
+    int err;
+    // 增量模式需要6.12及以上的内核，不支持时所有缓冲组都退回普通的缓冲环
+    if (incremental_) {
+      group.buf_ring = io_uring_setup_buf_ring(ring_, group.entries_max,
+                                               group.bgid, IOU_PBUF_RING_INC,
+                                               &err);
+      // 之前的缓冲组已按增量方式创建，同一内核上不应出现这种情况
+      if (!group.buf_ring && i != 0) {
+        spdlog::error("io_uring_setup_buf_ring failed. error: {}",
+                      strerror(-err));
+        exit(EXIT_FAILURE);
+      }
+      if (!group.buf_ring) {
+        incremental_ = false;
+        spdlog::info("incremental buffer ring unavailable, falling back. {}",
+                     strerror(-err));
+      }
+    }
+    if (!group.buf_ring)
+      group.buf_ring = io_uring_setup_buf_ring(ring_, group.entries_max,
+                                               group.bgid, 0, &err);
+    if (!group.buf_ring) {
+      spdlog::error("io_uring_setup_buf_ring failed. error: {}",
+                    strerror(-err));
+      exit(EXIT_FAILURE);
+    }
   }
-  err = io_uring_register_buffers_sparse(ring_, kBufferEntriesMax);
+  // 每个发送内存块注册为一个固定缓冲区
+  int err =
+      io_uring_register_buffers_sparse(ring_, entries_max_ / buffer_count_);
   if (err) {
     spdlog::error("io_uring_register_buffers_sparse failed. error: {}",
                   strerror(-err));
     exit(EXIT_FAILURE);
   }
-  // 初始化接受缓冲池
-  alloc_recv_buffers();
+  for (size_t i = 0; i != recv_groups_.size(); ++i) {
+    recv_group &group = recv_groups_[i];
+    group.slots.resize(group.entries_max);
+    if (incremental_)
+      group.offsets.resize(group.entries_max);
+    // 初始化接受缓冲池
+    alloc_recv_buffers(static_cast<uint8_t>(i));
+  }
   // 初始化发送缓冲池
   alloc_send_buffers();
 }
 
 BufferPool::~BufferPool() {
-  int ret = io_uring_free_buf_ring(ring_, buf_ring_, kBufferEntriesMax, bgid_);
-  if (ret < 0) {
-    spdlog::error("io_uring_free_buf_ring failed. error: {}", strerror(-ret));
-    exit(EXIT_FAILURE);
-  }
-  for (auto p : recv_pool_) {
-    free(p);
+  for (auto &group : recv_groups_) {
+    int ret = io_uring_free_buf_ring(ring_, group.buf_ring, group.entries_max,
+                                     group.bgid);
+    if (ret < 0) {
+      spdlog::error("io_uring_free_buf_ring failed. error: {}",
+                    strerror(-ret));
+      exit(EXIT_FAILURE);
+    }
+    for (auto p : group.blocks) {
+      free_block(p, group.block_size);
+    }
   }
-  ret = io_uring_unregister_buffers(ring_);
+  int ret = io_uring_unregister_buffers(ring_);
   if (ret < 0) {
     spdlog::error("io_uring_unregister_buffers failed. error: {}",
                   strerror(-ret));
     exit(EXIT_FAILURE);
   }
   for (auto p : send_pool_) {
-    free(p);
+    free_block(p, block_size_);
   }
 }
 
-// 通过bid获取缓冲池中对应的缓冲区
-void *BufferPool::GetRecvBuffer(uint16_t bid) {
-  uint16_t index = bid / kBufferCount;
-  if (index > recv_pool_.size())
+// 通过缓冲组与bid获取对应的接收缓冲区
+void *BufferPool::GetRecvBuffer(uint8_t group, uint16_t bid) {
+  recv_group &g = recv_groups_[group];
+  uint32_t index = bid / g.buffer_count;
+  if (index >= g.blocks.size())
     return nullptr;
-  return static_cast<char *>(recv_pool_[index]) +
-         (kBufferSize * (bid & (kBufferCount - 1)));
+  return static_cast<char *>(g.blocks[index]) +
+         (g.buffer_size * (bid & (g.buffer_count - 1)));
+}
+
+uint8_t BufferPool::PickRecvGroup(uint32_t size) const {
+  uint8_t last = static_cast<uint8_t>(recv_groups_.size() - 1);
+  for (uint8_t i = 0; i != last; ++i) {
+    if (recv_groups_[i].buffer_size >= size)
+      return i;
+  }
+  return last;
+}
+
+void BufferPool::add_recv_buffer(recv_group &group, void *buffer_addr,
+                                 uint16_t bid, int offset) {
+  int mask = io_uring_buf_ring_mask(group.entries_max);
+  group.slots[bid] =
+      static_cast<uint16_t>((group.buf_ring->tail + offset) & mask);
+  if (incremental_)
+    group.offsets[bid] = 0;
+  io_uring_buf_ring_add(group.buf_ring, buffer_addr, group.buffer_size, bid,
+                        mask, offset);
+}
+
+const std::vector<BufferPool::recv_segment> &
+BufferPool::TakeRecvSegments(uint8_t group, uint16_t bid, uint32_t len,
+                             bool buf_more) {
+  segments_.clear();
+  segments_group_ = group;
+  recv_group &g = recv_groups_[group];
+  int mask = io_uring_buf_ring_mask(g.entries_max);
+  uint16_t slot = g.slots[bid];
+  for (;;) {
+    uint32_t offset = incremental_ ? g.offsets[bid] : 0;
+    uint32_t n = std::min(len, g.buffer_size - offset);
+    len -= n;
+    // 只有最后一个缓冲区可能未被用完，增量模式下没有数据时缓冲区也不会被消耗
+    bool keep = !len && (buf_more || (incremental_ && !n));
+    segments_.push_back(
+        {static_cast<char *>(GetRecvBuffer(group, bid)) + offset, n, bid,
+         keep});
+    if (keep)
+      g.offsets[bid] = offset + n;
+    if (!len)
+      break;
+    // 缓冲区在归还前不会被覆盖，其后位置上的缓冲区即为bundle中的下一个缓冲区
+    slot = static_cast<uint16_t>((slot + 1) & mask);
+    bid = g.buf_ring->bufs[slot].bid;
+  }
+  return segments_;
 }
 
-// 将缓冲区返回缓冲池中，使内核有新的可用缓冲区
-void BufferPool::ReplenishRecvBuffer(void *buffer_addr, uint16_t bid) {
-  io_uring_buf_ring_add(buf_ring_, buffer_addr, kBufferSize, bid,
-                        io_uring_buf_ring_mask(kBufferEntriesMax), 0);
-  io_uring_buf_ring_advance(buf_ring_, 1);
+void BufferPool::ReleaseRecvSegments() {
+  recv_group &group = recv_groups_[segments_group_];
+  int count = 0;
+  for (const recv_segment &segment : segments_) {
+    if (!segment.keep)
+      add_recv_buffer(group, GetRecvBuffer(segments_group_, segment.bid),
+                      segment.bid, count++);
+  }
+  if (count)
+    io_uring_buf_ring_advance(group.buf_ring, count);
+  segments_.clear();
 }
 
-// 扩容接收缓冲池大小
-void BufferPool::alloc_recv_buffers() {
-  if (recv_buffer_count_ == kBufferEntriesMax)
+// 扩容接收缓冲组，每次分配一个该组的内存块
+// 小缓冲区的组一次扩容得到较多的缓冲区，大缓冲区的组数量上限较小，扩容次数也更少
+void BufferPool::alloc_recv_buffers(uint8_t group) {
+  recv_group &g = recv_groups_[group];
+  if (g.buffers == g.entries_max)
     return;
-  void *buffer_addr;
-  int ret = posix_memalign(&buffer_addr, 4096, kBlockSize);
-  if (ret) {
-    spdlog::error("posix_memalign failed. error: {}", strerror(ret));
-  } else {
-    recv_pool_.push_back(buffer_addr);
-    for (uint16_t i = 0; i < kBufferCount; ++i) {
-      io_uring_buf_ring_add(buf_ring_, buffer_addr, kBufferSize,
-                            recv_buffer_count_++,
-                            io_uring_buf_ring_mask(kBufferEntriesMax), i);
-      buffer_addr = static_cast<char *>(buffer_addr) + kBufferSize;
+  // 缓冲池只在所属线程中扩容，内存块会分配在该线程所在的NUMA节点上
+  void *buffer_addr = alloc_pool_block(g.block_size);
+  if (buffer_addr) {
+    g.blocks.push_back(buffer_addr);
+    for (uint32_t i = 0; i < g.buffer_count; ++i) {
+      add_recv_buffer(g, buffer_addr, static_cast<uint16_t>(g.buffers++),
+                      static_cast<int>(i));
+      buffer_addr = static_cast<char *>(buffer_addr) + g.buffer_size;
     }
-    io_uring_buf_ring_advance(buf_ring_, kBufferCount);
+    io_uring_buf_ring_advance(g.buf_ring, static_cast<int>(g.buffer_count));
+    metrics_add(METRIC_RECV_BUFFERS, g.buffer_count);
   }
 }
 
 // 对发送缓冲区进行扩容
+void *BufferPool::alloc_pool_block(size_t size) {
+  if (!hugepages_)
+    return alloc_block(size);
+  bool hugetlb = hugetlb_;
+  void *addr = alloc_huge_block(size, &hugetlb);
+  // 预留的大页不足后不再尝试，之后的内存块均使用透明大页
+  if (hugetlb_ && !hugetlb) {
+    hugetlb_ = false;
+    spdlog::info("no reserved hugepages left, using transparent hugepages");
+  }
+  return addr;
+}
+
+// 发送缓冲区以内存块为单位注册，使用大页时注册范围由整数个大页组成，
+// 内核可以按大页固定物理页，而不是逐个缓冲区地固定4KB的页
 void BufferPool::alloc_send_buffers() {
-  if (send_buffer_count_ == kBufferEntriesMax)
+  if (send_buffer_count_ == entries_max_)
     return;
-  void *buffer_addr;
-  int ret = posix_memalign(&buffer_addr, 4096, kBlockSize);
-  if (ret) {
-    spdlog::error("posix_memalign failed. error: {}", strerror(ret));
-  } else {
-    struct iovec iovecs[kBufferCount] = {};
-    void *buffer_base = buffer_addr;
-    for (uint16_t i = 0; i < kBufferCount; ++i) {
-      iovecs[i].iov_base = buffer_addr;
-      iovecs[i].iov_len = kBufferSize;
-      buffer_addr = static_cast<char *>(buffer_addr) + kBufferSize;
-    }
-    __u64 tags[kBufferCount] = {};
-    tags[0] = context_encode(__BUF_REL, 0, 0, send_buffer_count_);
-    ret = io_uring_register_buffers_update_tag(ring_, send_buffer_count_,
-                                               iovecs, tags, kBufferCount);
-    if (ret != kBufferCount) {
+  void *buffer_addr = alloc_pool_block(block_size_);
+  if (buffer_addr) {
+    struct iovec iovec = {.iov_base = buffer_addr, .iov_len = block_size_};
+    uint32_t index = static_cast<uint32_t>(send_pool_.size());
+    __u64 tag = context_encode(__BUF_REL, 0, 0, send_buffer_count_);
+    int ret = io_uring_register_buffers_update_tag(ring_, index, &iovec, &tag,
+                                                   1);
+    if (ret != 1) {
       spdlog::error("io_uring_register_buffers_update_tag failed. error: {}",
                     strerror(-ret));
-      free(buffer_base);
+      free_block(buffer_addr, block_size_);
     } else {
-      send_pool_.push_back(buffer_base);
-      avaliable_buf_index_.RemoveIndexRange(send_buffer_count_, kBufferCount);
-      send_buffer_count_ += kBufferCount;
+      send_pool_.push_back(buffer_addr);
+      avaliable_buf_index_.RemoveIndexRange(send_buffer_count_, buffer_count_);
+      send_buffer_count_ += buffer_count_;
+      metrics_add(METRIC_SEND_BUFFERS, buffer_count_);
     }
   }
 }
@@ -122,22 +255,24 @@ int BufferPool::GetSendBufferIndex() {
   if (buf_index == -1) {
     alloc_send_buffers();
     buf_index = static_cast<int>(avaliable_buf_index_.GetAndSetIndex());
+    if (buf_index == -1)
+      metrics_add(METRIC_SEND_BUFFER_EXHAUSTED);
   }
   return buf_index;
 }
 
 void *BufferPool::GetSendBuffer(uint16_t bidx) {
-  if (bidx >= kBufferEntriesMax)
+  if (bidx >= entries_max_)
     return NULL;
-  uint32_t index = bidx / kBufferCount;
+  uint32_t index = bidx / buffer_count_;
   if (index >= send_pool_.size())
     return NULL;
   return static_cast<char *>(send_pool_[index]) +
-         (kBufferSize * (bidx & (kBufferCount - 1)));
+         (buffer_size_ * (bidx & (buffer_count_ - 1)));
 }
 
 void BufferPool::ReplenishSendBuffer(uint16_t bidx) {
-  if (bidx >= kBufferEntriesMax)
+  if (bidx >= entries_max_)
     return;
   // avaliable_buf_index_.push(bidx);
   if (!avaliable_buf_index_.RemoveIndex(bidx))
@@ -8,30 +8,34 @@
 
 #include <liburing.h>
 
+#include "config.h"
 #include "utils/bitmap.h"
 
 namespace jdocs {
 
-// 缓冲区块大小，默认2048字节
-constexpr uint32_t kBufferSize = 2048;
-namespace {
-// 线程缓冲区条目最大数量
-constexpr uint32_t kBufferEntriesMax = 1 << 14;
-// 缓冲池扩容大小（块大小），默认512KB
-constexpr uint32_t kBlockSize = 2048 * 256;
-// 将块分割为缓冲区的数量
-constexpr uint32_t kBufferCount = kBlockSize / kBufferSize;
-} // namespace
-
 // 提供recv/send操作所需要的缓冲区
 // 其中发送缓冲区通过注册固定缓冲区以便后续使用零拷贝操作
+// 接收缓冲区按大小分为多个缓冲组，每个缓冲组拥有各自的缓冲环，
+// 连接根据最近收到的数据量选择缓冲组，小消息不会占用大缓冲区，大消息不会被切碎
+// 缓冲区大小、块大小以及条目最大数量由配置决定，且均为2的幂
+// 内核支持时接收缓冲区按增量方式使用，一个缓冲区可以容纳多次接收的数据
+// 可选使用2MB大页作为内存块，发送缓冲区以内存块为单位注册为固定缓冲区
 class BufferPool {
 public:
-  BufferPool(struct io_uring *ring);
+  // 接收完成事件中位于同一个缓冲区的一段数据
+  struct recv_segment {
+    char *data;
+    uint32_t len;
+    uint16_t bid;
+    // 缓冲区仍有剩余空间且由内核继续使用，不能归还
+    bool keep;
+  };
+
+  BufferPool(struct io_uring *ring, const ServerConfig &config);
   ~BufferPool();
 
-  // 通过bid获取缓冲池中对应的缓冲区
-  void *GetRecvBuffer(uint16_t bid);
+  // 通过缓冲组与bid获取对应的接收缓冲区
+  void *GetRecvBuffer(uint8_t group, uint16_t bid);
 
   // 获取可用的发送缓冲区下标，没有则返回-1
   int GetSendBufferIndex();
@@ -39,28 +43,99 @@ public:
   // 通过缓冲区下标获取发送缓冲区
   void *GetSendBuffer(uint16_t bidx);
 
+  // 发送缓冲区所在的固定缓冲区下标，即其所属内存块的注册位置
+  inline uint16_t GetSendBufferRegIndex(uint16_t bidx) const {
+    return static_cast<uint16_t>(bidx / buffer_count_);
+  }
+
   // 补充发送缓冲池，使其能被下一个发送请求所使用
   void ReplenishSendBuffer(uint16_t bidx);
 
-  // 将缓冲区返回缓冲池中，使内核有新的可用缓冲区
-  void ReplenishRecvBuffer(void *buffer_addr, uint16_t bid);
+  // 取出一个接收完成事件收到的数据，bid为完成事件中的缓冲区id，len为数据长度
+  // bundle模式下数据从该缓冲区开始，依次分布在缓冲环中相邻的多个缓冲区里
+  // 返回的数据段在调用ReleaseRecvSegments前有效
+  const std::vector<recv_segment> &TakeRecvSegments(uint8_t group, uint16_t bid,
+                                                    uint32_t len,
+                                                    bool buf_more);
+
+  // 归还上一次取出的数据段中已用完的缓冲区
+  void ReleaseRecvSegments();
+
+  // 按缓冲组的扩容策略扩容，已达到该组的数量上限时不做任何操作
+  void alloc_recv_buffers(uint8_t group);
+
+  // 选择能完整容纳size字节的最小缓冲组，没有时选择最大的缓冲组
+  uint8_t PickRecvGroup(uint32_t size) const;
 
-  // 扩容缓冲池大小
-  void alloc_recv_buffers();
+  inline uint8_t GetRecvGroupCount() const {
+    return static_cast<uint8_t>(recv_groups_.size());
+  }
 
-  inline uint16_t GetBgid() const { return bgid_; }
+  inline uint16_t GetBgid(uint8_t group) const {
+    return recv_groups_[group].bgid;
+  }
+
+  inline uint32_t GetRecvBufferSize(uint8_t group) const {
+    return recv_groups_[group].buffer_size;
+  }
+
+  // 发送缓冲区大小
+  inline uint32_t GetBufferSize() const { return buffer_size_; }
+
+  inline bool IsIncremental() const { return incremental_; }
+
+  // 已取出且尚未归还的发送缓冲区数量，包括等待零拷贝发送完成通知的缓冲区
+  inline uint32_t GetSendBuffersInUse() const {
+    return avaliable_buf_index_.size() - (entries_max_ - send_buffer_count_);
+  }
 
 private:
+  // 接收缓冲组，每次扩容分配一个内存块并分割为缓冲区
+  struct recv_group {
+    uint32_t buffer_size;
+    // 扩容时分配的内存块大小以及分割出的缓冲区数量
+    uint32_t block_size;
+    uint32_t buffer_count;
+    // 缓冲环条目数量，即该组缓冲区数量的上限
+    uint32_t entries_max;
+    // 当前缓冲区数量
+    uint32_t buffers{0};
+    uint16_t bgid;
+    struct io_uring_buf_ring *buf_ring{nullptr};
+    std::vector<void *> blocks;
+    // 每个缓冲区最近一次放入缓冲环时所在的位置，用于找到bundle中后续的缓冲区
+    std::vector<uint16_t> slots;
+    // 增量模式下每个缓冲区已被使用的长度
+    std::vector<uint32_t> offsets;
+  };
+
   void alloc_send_buffers();
-  // 当前接收缓冲区数量，最大不超过2^15
-  uint16_t recv_buffer_count_{0};
-  // 当前发送缓冲区数量，最大数量限制同上
+  // 按配置的页类型分配缓冲池的内存块
+  void *alloc_pool_block(size_t size);
+  // 将接收缓冲区放入缓冲环中尾部之后的第offset个位置，需随后推进尾部
+  void add_recv_buffer(recv_group &group, void *buffer_addr, uint16_t bid,
+                       int offset);
+  // 发送缓冲区大小
+  uint32_t buffer_size_;
+  // 发送缓冲池扩容大小（块大小）
+  uint32_t block_size_;
+  // 将块分割为发送缓冲区的数量
+  uint32_t buffer_count_;
+  // 发送缓冲区条目最大数量
+  uint32_t entries_max_;
+  // 当前发送缓冲区数量，最大不超过2^15
   uint16_t send_buffer_count_{0};
-  // 缓冲组id
-  uint16_t bgid_{1};
   struct io_uring *ring_;
-  struct io_uring_buf_ring *buf_ring_;
-  std::vector<void *> recv_pool_;
+  // 接收缓冲环按增量方式使用（IOU_PBUF_RING_INC）
+  bool incremental_{false};
+  // 内存块使用大页，以及是否仍尝试预留的大页（MAP_HUGETLB）
+  bool hugepages_;
+  bool hugetlb_;
+  // 按缓冲区大小从小到大排列
+  std::vector<recv_group> recv_groups_;
+  // 上一次取出的数据段所属的缓冲组
+  uint8_t segments_group_{0};
+  std::vector<recv_segment> segments_;
   std::vector<void *> send_pool_;
   BitMap avaliable_buf_index_;
 };
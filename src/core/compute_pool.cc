@@ -0,0 +1,98 @@
+// Copyright (c) 2025-2026 Juantgd. All Rights Reserved.
+
+#include "compute_pool.h"
+
+#include <pthread.h>
+
+#include <spdlog/spdlog.h>
+
+namespace jdocs {
+
+ComputePool::ComputePool(uint32_t threads, uint32_t capacity)
+    : capacity_(capacity) {
+  queues_.reserve(threads);
+  for (uint32_t i = 0; i != threads; ++i)
+    queues_.push_back(std::make_unique<job_queue>());
+  threads_.reserve(threads);
+  for (uint32_t i = 0; i != threads; ++i)
+    threads_.emplace_back([this, i] { run(i); });
+}
+
+ComputePool::~ComputePool() {
+  {
+    std::lock_guard<std::mutex> lock(sleep_mutex_);
+    stopping_.store(true, std::memory_order_relaxed);
+  }
+  sleep_cv_.notify_all();
+  for (auto &thread : threads_)
+    thread.join();
+}
+
+bool ComputePool::Submit(std::function<void()> job) {
+  // 先占用名额再放入队列，计数不会因任务先被取出而下溢
+  // 与计算线程休眠前的检查配合，两者至少有一方能看到对方的修改，不会丢失唤醒
+  if (queued_.fetch_add(1, std::memory_order_seq_cst) >= capacity_) {
+    queued_.fetch_sub(1, std::memory_order_relaxed);
+    return false;
+  }
+  job_queue &queue =
+      *queues_[next_.fetch_add(1, std::memory_order_relaxed) % queues_.size()];
+  {
+    std::lock_guard<std::mutex> lock(queue.mutex);
+    queue.jobs.push_back(std::move(job));
+  }
+  if (sleepers_.load(std::memory_order_seq_cst)) {
+    std::lock_guard<std::mutex> lock(sleep_mutex_);
+    sleep_cv_.notify_one();
+  }
+  return true;
+}
+
+bool ComputePool::take(uint32_t index, std::function<void()> *job) {
+  size_t count = queues_.size();
+  for (size_t i = 0; i != count; ++i) {
+    job_queue &queue = *queues_[(index + i) % count];
+    std::lock_guard<std::mutex> lock(queue.mutex);
+    if (queue.jobs.empty())
+      continue;
+    // 自己的队列从头部取出，保持提交顺序，窃取时从尾部取出，减少与队列所有者的竞争
+    if (i == 0) {
+      *job = std::move(queue.jobs.front());
+      queue.jobs.pop_front();
+    } else {
+      *job = std::move(queue.jobs.back());
+      queue.jobs.pop_back();
+    }
+    queued_.fetch_sub(1, std::memory_order_relaxed);
+    return true;
+  }
+  return false;
+}
+
+void ComputePool::run(uint32_t index) {
+  pthread_setname_np(pthread_self(), "compute");
+  std::function<void()> job;
+  for (;;) {
+    if (stopping_.load(std::memory_order_relaxed))
+      return;
+    if (take(index, &job)) {
+      // 任务中未捕获的异常不能结束计算线程
+      try {
+        job();
+      } catch (const std::exception &e) {
+        spdlog::error("unhandled exception in compute job: {}", e.what());
+      }
+      job = nullptr;
+      continue;
+    }
+    std::unique_lock<std::mutex> lock(sleep_mutex_);
+    sleepers_.fetch_add(1, std::memory_order_seq_cst);
+    sleep_cv_.wait(lock, [this] {
+      return stopping_.load(std::memory_order_relaxed) ||
+             queued_.load(std::memory_order_seq_cst) != 0;
+    });
+    sleepers_.fetch_sub(1, std::memory_order_relaxed);
+  }
+}
+
+} // namespace jdocs
@@ -0,0 +1,65 @@
+// Copyright (c) 2025-2026 Juantgd. All Rights Reserved.
+
+#ifndef JDOCS_CORE_COMPUTE_POOL_H_
+#define JDOCS_CORE_COMPUTE_POOL_H_
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace jdocs {
+
+// 用于执行耗时计算的线程池，避免阻塞worker线程的事件循环
+// 每个计算线程拥有一个任务队列，提交的任务轮流放入各个队列，
+// 计算线程优先从自己队列的头部取任务，队列为空时从其他队列的尾部窃取
+class ComputePool {
+public:
+  // capacity为所有队列中等待执行的任务总数上限
+  ComputePool(uint32_t threads, uint32_t capacity);
+  // 等待正在执行的任务结束，尚未开始的任务直接丢弃
+  // 析构时worker线程已全部退出，任务的结果已无人接收
+  ~ComputePool();
+
+  ComputePool(const ComputePool &) = delete;
+  ComputePool &operator=(const ComputePool &) = delete;
+
+  // 可由任意线程调用，等待执行的任务已达上限时返回false，调用方需自行执行
+  bool Submit(std::function<void()> job);
+
+  inline uint32_t GetThreadCount() const {
+    return static_cast<uint32_t>(threads_.size());
+  }
+
+private:
+  struct alignas(64) job_queue {
+    std::mutex mutex;
+    std::deque<std::function<void()>> jobs;
+  };
+
+  void run(uint32_t index);
+  // 取出一个任务，所有队列均为空时返回false
+  bool take(uint32_t index, std::function<void()> *job);
+
+  std::vector<std::unique_ptr<job_queue>> queues_;
+  std::vector<std::thread> threads_;
+  uint32_t capacity_;
+  // 提交任务时选择队列的计数
+  std::atomic<uint32_t> next_{0};
+  // 所有队列中等待执行的任务数量，包括正在放入队列的任务
+  std::atomic<uint32_t> queued_{0};
+  // 没有任务时计算线程在条件变量上休眠，只有存在休眠线程时提交方才需要加锁唤醒
+  std::atomic<uint32_t> sleepers_{0};
+  std::mutex sleep_mutex_;
+  std::condition_variable sleep_cv_;
+  std::atomic<bool> stopping_{false};
+};
+
+} // namespace jdocs
+
+#endif
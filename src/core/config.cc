@@ -0,0 +1,372 @@
+// Copyright (c) 2025-2026 Juantgd. All Rights Reserved.
+
+#include "config.h"
+
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include <spdlog/spdlog.h>
+
+#include "utils/numa.h"
+
+namespace jdocs {
+
+namespace {
+
+// 缓冲区编号为16位，且缓冲环最多支持32768个条目
+constexpr uint32_t kMaxBufferEntries = 1 << 15;
+
+// 接收缓冲组的数量上限，缓冲组下标与缓冲组id都较小，便于放入user_data中
+constexpr uint32_t kMaxRecvBufferGroups = 8;
+
+inline bool is_power_of_two(uint32_t n) { return n && !(n & (n - 1)); }
+
+inline uint32_t round_up_power_of_two(uint32_t n) {
+  uint32_t result = 1;
+  while (result < n)
+    result <<= 1;
+  return result;
+}
+
+inline std::string trim(const std::string &str) {
+  size_t begin = str.find_first_not_of(" \t\r\n");
+  if (begin == std::string::npos)
+    return {};
+  size_t end = str.find_last_not_of(" \t\r\n");
+  return str.substr(begin, end - begin + 1);
+}
+
+bool parse_value(const std::string &str, uint32_t *value) {
+  if (str.empty() || str[0] == '-')
+    return false;
+  char *end = nullptr;
+  errno = 0;
+  unsigned long result = strtoul(str.c_str(), &end, 0);
+  if (errno || *end != '\0' || result > UINT32_MAX)
+    return false;
+  *value = static_cast<uint32_t>(result);
+  return true;
+}
+
+bool parse_value(const std::string &str, int32_t *value) {
+  if (str.empty())
+    return false;
+  char *end = nullptr;
+  errno = 0;
+  long result = strtol(str.c_str(), &end, 0);
+  if (errno || *end != '\0' || result < INT32_MIN || result > INT32_MAX)
+    return false;
+  *value = static_cast<int32_t>(result);
+  return true;
+}
+
+bool parse_value(const std::string &str, bool *value) {
+  if (str == "true" || str == "1" || str == "on") {
+    *value = true;
+  } else if (str == "false" || str == "0" || str == "off") {
+    *value = false;
+  } else {
+    return false;
+  }
+  return true;
+}
+
+bool parse_value(const std::string &str, std::string *value) {
+  *value = str;
+  return true;
+}
+
+template <typename T, size_t N>
+bool parse_enum(const std::string &str,
+                const std::pair<const char *, T> (&table)[N], T *value) {
+  for (const auto &item : table) {
+    if (str == item.first) {
+      *value = item.second;
+      return true;
+    }
+  }
+  return false;
+}
+
+bool parse_value(const std::string &str, ring_mode_t *value) {
+  static const std::pair<const char *, ring_mode_t> table[] = {
+#define X(name, mode) {name, mode},
+      RING_MODE_MAP(X)
+#undef X
+  };
+  return parse_enum(str, table, value);
+}
+
+bool parse_value(const std::string &str, accept_mode_t *value) {
+  static const std::pair<const char *, accept_mode_t> table[] = {
+#define X(name, mode) {name, mode},
+      ACCEPT_MODE_MAP(X)
+#undef X
+  };
+  return parse_enum(str, table, value);
+}
+
+bool parse_value(const std::string &str, dispatch_policy_t *value) {
+  static const std::pair<const char *, dispatch_policy_t> table[] = {
+#define X(name, policy) {name, policy},
+      DISPATCH_POLICY_MAP(X)
+#undef X
+  };
+  return parse_enum(str, table, value);
+}
+
+bool parse_value(const std::string &str, slow_consumer_t *value) {
+  static const std::pair<const char *, slow_consumer_t> table[] = {
+#define X(name, policy) {name, policy},
+      SLOW_CONSUMER_MAP(X)
+#undef X
+  };
+  return parse_enum(str, table, value);
+}
+
+bool parse_value(const std::string &str, hugepage_t *value) {
+  static const std::pair<const char *, hugepage_t> table[] = {
+#define X(name, mode) {name, mode},
+      HUGEPAGE_MAP(X)
+#undef X
+  };
+  return parse_enum(str, table, value);
+}
+
+bool parse_value(const std::string &str, steering_t *value) {
+  static const std::pair<const char *, steering_t> table[] = {
+#define X(name, mode) {name, mode},
+      STEERING_MAP(X)
+#undef X
+  };
+  return parse_enum(str, table, value);
+}
+
+} // namespace
+
+bool ServerConfig::Set(const std::string &key, const std::string &value) {
+#define X(type, name, default_value, desc)                                     \
+  if (key == #name) {                                                          \
+    if (!parse_value(value, &name)) {                                          \
+      spdlog::error("invalid value for config {}: {}", key, value);            \
+      return false;                                                            \
+    }                                                                          \
+    return true;                                                               \
+  }
+  SERVER_CONFIG_MAP(X)
+#undef X
+  spdlog::error("unknown config: {}", key);
+  return false;
+}
+
+bool ServerConfig::LoadFile(const std::string &path) {
+  std::ifstream file(path);
+  if (!file.is_open()) {
+    spdlog::error("open config file {} failed. error: {}", path,
+                  strerror(errno));
+    return false;
+  }
+  std::string line;
+  uint32_t line_number = 0;
+  while (std::getline(file, line)) {
+    ++line_number;
+    line = trim(line);
+    if (line.empty() || line[0] == '#')
+      continue;
+    size_t pos = line.find('=');
+    if (pos == std::string::npos) {
+      spdlog::error("{}:{}: expected key = value", path, line_number);
+      return false;
+    }
+    if (!Set(trim(line.substr(0, pos)), trim(line.substr(pos + 1)))) {
+      spdlog::error("{}:{}: invalid config line", path, line_number);
+      return false;
+    }
+  }
+  return true;
+}
+
+bool ServerConfig::ParseArgs(int argc, char *argv[]) {
+  // 先加载配置文件，使命令行参数能够覆盖配置文件中的值
+  for (int i = 1; i < argc; ++i) {
+    if (strncmp(argv[i], "--config=", 9) == 0 && !LoadFile(argv[i] + 9))
+      return false;
+  }
+  for (int i = 1; i < argc; ++i) {
+    std::string arg(argv[i]);
+    if (arg.compare(0, 2, "--") != 0) {
+      spdlog::error("invalid argument: {}", arg);
+      return false;
+    }
+    size_t pos = arg.find('=');
+    if (pos == std::string::npos) {
+      spdlog::error("invalid argument: {}, expected --key=value", arg);
+      return false;
+    }
+    std::string key = arg.substr(2, pos - 2);
+    if (key == "config")
+      continue;
+    if (!Set(key, arg.substr(pos + 1)))
+      return false;
+  }
+  return Validate();
+}
+
+bool ServerConfig::Validate() {
+  if (port == 0 || port > UINT16_MAX) {
+    spdlog::error("invalid port: {}", port);
+    return false;
+  }
+  if (queue_depth == 0 || fd_table_size == 0 || timer_tick == 0) {
+    spdlog::error("queue_depth, fd_table_size and timer_tick must be positive");
+    return false;
+  }
+  if (wait_batch_max == 0 || wait_batch_max > queue_depth) {
+    spdlog::error("wait_batch_max must be between 1 and queue_depth");
+    return false;
+  }
+  if (wait_batch_max > 1 && wait_timeout_us == 0) {
+    spdlog::error("wait_timeout_us must be positive when batching");
+    return false;
+  }
+  // 直接文件描述符在user_data中只占16位，连接表的下标同样不能超过该范围
+  if (fd_table_size > 65536) {
+    spdlog::error("fd_table_size must not exceed 65536");
+    return false;
+  }
+  // 缓冲区通过位运算定位，因此缓冲区大小与每块缓冲区数量都需要为2的幂
+  if (buffer_size < 64 || !is_power_of_two(buffer_size)) {
+    spdlog::error("buffer_size must be a power of two no less than 64");
+    return false;
+  }
+  if (block_size < buffer_size)
+    block_size = buffer_size;
+  uint32_t buffer_count = round_up_power_of_two(block_size / buffer_size);
+  if (buffer_count * buffer_size != block_size) {
+    spdlog::warn("block_size {} adjusted to {}", block_size,
+                 buffer_count * buffer_size);
+    block_size = buffer_count * buffer_size;
+  }
+  // 大页模式下每个内存块由整数个大页组成，注册发送缓冲区时也按整块注册
+  if (buffer_hugepages != kHugepageOff && block_size < kHugePageSize) {
+    spdlog::warn("block_size {} adjusted to {} for hugepages", block_size,
+                 kHugePageSize);
+    block_size = static_cast<uint32_t>(kHugePageSize);
+    buffer_count = block_size / buffer_size;
+  }
+  if (buffer_entries_max > kMaxBufferEntries)
+    buffer_entries_max = kMaxBufferEntries;
+  if (!is_power_of_two(buffer_entries_max) ||
+      buffer_entries_max < buffer_count) {
+    spdlog::error("buffer_entries_max must be a power of two no less than {}",
+                  buffer_count);
+    return false;
+  }
+  // 各缓冲组按大小从小到大排列，连接据此选择能容纳最近消息的最小缓冲组
+  std::vector<uint32_t> sizes;
+  if (!RecvBufferSizes(&sizes)) {
+    spdlog::error("invalid recv_buffer_sizes: {}", recv_buffer_sizes);
+    return false;
+  }
+  for (size_t i = 0; i != sizes.size(); ++i) {
+    if (sizes[i] < 64 || !is_power_of_two(sizes[i]) ||
+        (i && sizes[i] <= sizes[i - 1])) {
+      spdlog::error("recv_buffer_sizes must be ascending powers of two no "
+                    "less than 64");
+      return false;
+    }
+  }
+  if (sizes.size() > kMaxRecvBufferGroups) {
+    spdlog::error("recv_buffer_sizes allows at most {} sizes",
+                  kMaxRecvBufferGroups);
+    return false;
+  }
+  // 两个水位之间留出间隔，避免在临界点附近反复暂停与恢复
+  if (accept_resume_watermark == 0 ||
+      accept_resume_watermark >= accept_pause_watermark ||
+      accept_pause_watermark > 100) {
+    spdlog::error("accept watermarks must satisfy 0 < resume < pause <= 100");
+    return false;
+  }
+  if (upgrade && upgrade_socket.empty()) {
+    spdlog::error("upgrade requires upgrade_socket");
+    return false;
+  }
+  if (drain_pace > drain_timeout) {
+    spdlog::error("drain_pace must not exceed drain_timeout");
+    return false;
+  }
+  if (send_queue_budget == 0) {
+    spdlog::error("send_queue_budget must be positive");
+    return false;
+  }
+  if (mailbox_capacity < 2 || !is_power_of_two(mailbox_capacity)) {
+    spdlog::error("mailbox_capacity must be a power of two no less than 2");
+    return false;
+  }
+  if (compute_threads && compute_queue_capacity == 0) {
+    spdlog::error("compute_queue_capacity must be positive");
+    return false;
+  }
+  if (doc_history_capacity == 0)
+    doc_history_capacity = 1;
+  uint32_t nr_cpus = std::thread::hardware_concurrency();
+  if (sqpoll_cpu < -1 ||
+      (nr_cpus && sqpoll_cpu >= static_cast<int32_t>(nr_cpus))) {
+    spdlog::error("sqpoll_cpu {} out of range", sqpoll_cpu);
+    return false;
+  }
+  if (master_cpu < -1 ||
+      (nr_cpus && master_cpu >= static_cast<int32_t>(nr_cpus))) {
+    spdlog::error("master_cpu {} out of range", master_cpu);
+    return false;
+  }
+  std::vector<int> cpus;
+  if (!worker_cpus.empty() && !parse_cpu_list(worker_cpus, &cpus)) {
+    spdlog::error("invalid worker_cpus: {}", worker_cpus);
+    return false;
+  }
+  // 按接收CPU引导连接时，需要知道每个worker线程绑定的CPU
+  if (accept_mode == kAcceptModeReuseport &&
+      reuseport_steering == kSteeringIncomingCpu && cpus.empty()) {
+    spdlog::error("reuseport_steering=cpu requires worker_cpus");
+    return false;
+  }
+  return true;
+}
+
+bool ServerConfig::RecvBufferSizes(std::vector<uint32_t> *sizes) const {
+  sizes->clear();
+  if (trim(recv_buffer_sizes).empty()) {
+    sizes->push_back(buffer_size);
+    return true;
+  }
+  size_t begin = 0;
+  for (;;) {
+    size_t end = recv_buffer_sizes.find(',', begin);
+    uint32_t size;
+    if (!parse_value(trim(recv_buffer_sizes.substr(begin, end - begin)),
+                     &size))
+      return false;
+    sizes->push_back(size);
+    if (end == std::string::npos)
+      return true;
+    begin = end + 1;
+  }
+}
+
+std::string ServerConfig::Usage() {
+  std::string usage("options:\n  --config=path  load options from file\n");
+#define X(type, name, default_value, desc)                                     \
+  usage.append("  --" #name "=value  ").append(desc).append("\n");
+  SERVER_CONFIG_MAP(X)
+#undef X
+  return usage;
+}
+
+} // namespace jdocs
@@ -0,0 +1,202 @@
+// Copyright (c) 2025-2026 Juantgd. All Rights Reserved.
+
+#ifndef JDOCS_CORE_CONFIG_H_
+#define JDOCS_CORE_CONFIG_H_
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace jdocs {
+
+// io_uring实例的任务运行模式：配置值、枚举值
+#define RING_MODE_MAP(X)                                                       \
+  X("defer", kRingModeDeferTaskrun)                                            \
+  X("coop", kRingModeCoopTaskrun)                                              \
+  X("sqpoll", kRingModeSqpoll)
+
+enum ring_mode_t : uint8_t {
+#define X(name, mode) mode,
+  RING_MODE_MAP(X)
+#undef X
+};
+
+// 新连接的接受方式：配置值、枚举值
+// master模式由master线程统一接受连接后分发给worker线程，
+// reuseport模式下每个worker线程拥有各自的监听套接字并直接接受连接
+#define ACCEPT_MODE_MAP(X)                                                     \
+  X("master", kAcceptModeMaster)                                               \
+  X("reuseport", kAcceptModeReuseport)
+
+enum accept_mode_t : uint8_t {
+#define X(name, mode) mode,
+  ACCEPT_MODE_MAP(X)
+#undef X
+};
+
+// reuseport模式下新连接在各监听套接字之间的引导方式：配置值、枚举值
+#define STEERING_MAP(X)                                                        \
+  X("none", kSteeringNone)                                                     \
+  X("cpu", kSteeringIncomingCpu)                                               \
+  X("bpf", kSteeringBpf)
+
+enum steering_t : uint8_t {
+#define X(name, mode) mode,
+  STEERING_MAP(X)
+#undef X
+};
+
+// 新连接分配给worker线程的策略：配置值、枚举值
+// round_robin为轮询，least_conn选择连接数最少的线程，
+// least_cpu选择最近繁忙程度最低的线程，p2c随机选择两个线程并取连接数较少者
+#define DISPATCH_POLICY_MAP(X)                                                 \
+  X("round_robin", kDispatchRoundRobin)                                        \
+  X("least_conn", kDispatchLeastConn)                                          \
+  X("least_cpu", kDispatchLeastCpu)                                            \
+  X("p2c", kDispatchPowerOfTwo)
+
+enum dispatch_policy_t : uint8_t {
+#define X(name, policy) policy,
+  DISPATCH_POLICY_MAP(X)
+#undef X
+};
+
+// 连接的发送队列超出预算时的处理策略：配置值、枚举值
+// wait继续排队，并暂停接收该连接的数据，直到队列回落到预算的一半以下，
+// drop丢弃可丢弃的消息（例如在线状态通知），disconnect直接关闭连接
+// 任何策略下队列超出预算的kSendQueueHardCap倍时都会关闭连接
+#define SLOW_CONSUMER_MAP(X)                                                   \
+  X("wait", kSlowConsumerWait)                                                 \
+  X("drop", kSlowConsumerDrop)                                                 \
+  X("disconnect", kSlowConsumerDisconnect)
+
+enum slow_consumer_t : uint8_t {
+#define X(name, policy) policy,
+  SLOW_CONSUMER_MAP(X)
+#undef X
+};
+
+// 缓冲池内存块使用的页：配置值、枚举值
+// off使用普通页，thp使用透明大页，hugetlb优先使用预留的2MB大页，不足时退回透明大页
+#define HUGEPAGE_MAP(X)                                                        \
+  X("off", kHugepageOff)                                                       \
+  X("thp", kHugepageThp)                                                       \
+  X("hugetlb", kHugepageTlb)
+
+enum hugepage_t : uint8_t {
+#define X(name, mode) mode,
+  HUGEPAGE_MAP(X)
+#undef X
+};
+
+// 服务器配置项定义：类型、名称、默认值、说明
+// 名称同时作为配置文件中的键名以及命令行参数名
+#define SERVER_CONFIG_MAP(X)                                                   \
+  X(uint32_t, port, 7788, "listening port")                                    \
+  X(uint32_t, worker_threads, 0,                                               \
+    "number of worker threads, 0 means hardware concurrency")                  \
+  X(uint32_t, queue_depth, 2048, "io_uring submission queue entries")          \
+  X(uint32_t, fd_table_size, 8192, "direct descriptor table size per ring")    \
+  X(uint32_t, accept_pause_watermark, 95,                                      \
+    "pause accepting once every worker fills this percent of its fd table")    \
+  X(uint32_t, accept_resume_watermark, 85,                                     \
+    "resume accepting once a worker drops below this percent of its fd table") \
+  X(uint32_t, conn_idle_timeout, 60000, "idle connection timeout in ms")       \
+  X(bool, idle_lazy, true,                                                     \
+    "track activity on recv and re-arm idle timers only when they fire")       \
+  X(uint32_t, buffer_size, 2048, "recv/send buffer size in bytes")             \
+  X(uint32_t, block_size, 2048 * 256,                                          \
+    "buffer pool growth block size in bytes")                                  \
+  X(uint32_t, buffer_entries_max, 1 << 14, "maximum buffers per pool")         \
+  X(hugepage_t, buffer_hugepages, kHugepageOff,                               \
+    "back buffer pool blocks with 2 MB pages: off, thp or hugetlb")            \
+  X(std::string, recv_buffer_sizes, "512,4096,65536",                          \
+    "comma separated recv buffer size classes, empty uses buffer_size")        \
+  X(uint32_t, send_queue_budget, 1 << 20,                                      \
+    "bytes a connection may queue for sending before slow_consumer applies")   \
+  X(slow_consumer_t, slow_consumer, kSlowConsumerDrop,                         \
+    "policy for connections over send_queue_budget: wait, drop or disconnect") \
+  X(uint32_t, send_zc_threshold, 16384,                                        \
+    "queued sends of at least this many bytes use send_zc, 0 disables it")     \
+  X(bool, recv_bundle, true,                                                   \
+    "let one recv completion fill several buffers if the kernel supports it")  \
+  X(bool, recv_buffer_inc, true,                                               \
+    "consume recv buffers incrementally if the kernel supports it")            \
+  X(uint32_t, timer_tick, 100, "time wheel tick in ms")                        \
+  X(bool, timer_tickless, true,                                                \
+    "wake only for the earliest pending timer instead of every tick")          \
+  X(uint32_t, doc_history_capacity, 50,                                        \
+    "document revisions kept for transforming stale edits")                    \
+  X(ring_mode_t, ring_mode, kRingModeDeferTaskrun,                             \
+    "io_uring setup mode: defer, coop or sqpoll")                              \
+  X(uint32_t, sqpoll_idle, 1000, "sqpoll thread idle time in ms before sleep") \
+  X(int32_t, sqpoll_cpu, -1,                                                   \
+    "cpu the sqpoll threads are bound to, -1 leaves them unbound")             \
+  X(bool, sqpoll_shared, false,                                                \
+    "let all rings share the sqpoll thread of the master ring")                \
+  X(uint32_t, wait_batch_max, 1,                                               \
+    "max completions a worker waits for per wakeup, 1 disables batching")      \
+  X(uint32_t, wait_timeout_us, 50,                                             \
+    "max time in us a worker waits to fill a completion batch")                \
+  X(uint32_t, busy_poll_us, 0,                                                 \
+    "time in us a worker polls for completions before sleeping, 0 disables")   \
+  X(std::string, worker_cpus, "",                                              \
+    "cpus the workers are pinned to in order, e.g. 0-7,16 or auto")            \
+  X(int32_t, master_cpu, -1,                                                   \
+    "cpu the master thread is pinned to, -1 leaves it unpinned")               \
+  X(bool, numa_local, true,                                                    \
+    "allocate memory of pinned workers on the numa node of their cpu")         \
+  X(accept_mode_t, accept_mode, kAcceptModeMaster,                             \
+    "how connections are accepted: master or reuseport")                       \
+  X(steering_t, reuseport_steering, kSteeringNone,                             \
+    "reuseport connection steering: none, cpu or bpf")                         \
+  X(dispatch_policy_t, dispatch_policy, kDispatchRoundRobin,                   \
+    "master mode dispatch: round_robin, least_conn, least_cpu or p2c")         \
+  X(uint32_t, drain_timeout, 30000,                                            \
+    "graceful shutdown deadline in ms, remaining connections are then closed") \
+  X(uint32_t, drain_pace, 5000,                                                \
+    "spread going away notices over this many ms to pace reconnects")          \
+  X(std::string, upgrade_socket, "",                                           \
+    "unix socket path on which a new process can take over this one")          \
+  X(bool, upgrade, false,                                                      \
+    "start by taking over the process listening on upgrade_socket")            \
+  X(bool, upgrade_connections, true,                                           \
+    "also take over idle websocket connections during an upgrade")             \
+  X(uint32_t, mailbox_capacity, 1024,                                          \
+    "cross thread message batches each worker mailbox can hold")               \
+  X(uint32_t, compute_threads, 2,                                              \
+    "threads running heavy document work off the workers, 0 to disable")       \
+  X(uint32_t, compute_queue_capacity, 1024,                                    \
+    "jobs that can wait for a compute thread before work runs inline")         \
+  X(uint32_t, offload_threshold, 65536,                                        \
+    "estimated cost in bytes from which document work is offloaded")
+
+struct ServerConfig {
+#define X(type, name, value, desc) type name{value};
+  SERVER_CONFIG_MAP(X)
+#undef X
+
+  // 设置单个配置项，键名不存在或值非法时返回false
+  bool Set(const std::string &key, const std::string &value);
+
+  // 从配置文件中加载配置，每行格式为key = value，#开头的行为注释
+  bool LoadFile(const std::string &path);
+
+  // 解析命令行参数，格式为--key=value，其中--config=path用于指定配置文件
+  // 配置文件先于其他命令行参数加载，因此命令行参数会覆盖配置文件中的值
+  bool ParseArgs(int argc, char *argv[]);
+
+  // 校验配置项之间的约束，部分不满足约束的值会被修正为合法值
+  bool Validate();
+
+  // 解析recv_buffer_sizes，得到从小到大排列的接收缓冲区大小，为空时只有buffer_size
+  // 格式非法时返回false
+  bool RecvBufferSizes(std::vector<uint32_t> *sizes) const;
+
+  // 输出所有配置项及说明
+  static std::string Usage();
+};
+
+} // namespace jdocs
+
+#endif
@@ -5,17 +5,25 @@
 
 #include <atomic>
 #include <cstdint>
+#include <functional>
 #include <string>
+#include <vector>
 
 #include <liburing.h>
 
-#include <spdlog/spdlog.h>
+#include "utils/logger.h"
 
 namespace jdocs {
 
 namespace {
 constexpr static unsigned OP_SHIFT = 28;
-}
+// 连接id的高位为所属worker线程的编号，低位为该线程连接表中的句柄
+constexpr static unsigned CONN_ID_WORKER_BITS = 7;
+constexpr static unsigned CONN_ID_HANDLE_BITS = OP_SHIFT - CONN_ID_WORKER_BITS;
+constexpr static uint32_t CONN_ID_HANDLE_MASK = (1U << CONN_ID_HANDLE_BITS) - 1;
+// worker线程的最大数量
+constexpr static uint32_t kMaxWorkers = 1U << CONN_ID_WORKER_BITS;
+} // namespace
 
 enum {
   __ACCEPT = 0,
@@ -29,9 +37,26 @@ enum {
   __CROSS_THREAD_MSG,
   __TIMEOUT,
   __BUF_REL,
+  __SIGNAL,
+  __DRAIN,
+  __UPGRADE,
   __NOP
 };
 
+static inline uint32_t conn_id_encode(uint32_t worker, uint32_t handle) {
+  return (worker << CONN_ID_HANDLE_BITS) | (handle & CONN_ID_HANDLE_MASK);
+}
+
+// 获取连接所属worker线程的编号
+static inline uint32_t conn_id_to_worker(uint32_t conn_id) {
+  return (conn_id & 0x0FFFFFFF) >> CONN_ID_HANDLE_BITS;
+}
+
+// 获取连接在所属worker线程连接表中的句柄
+static inline uint32_t conn_id_to_handle(uint32_t conn_id) {
+  return conn_id & CONN_ID_HANDLE_MASK;
+}
+
 struct Context {
   union {
     struct {
@@ -51,8 +76,7 @@ struct Context {
   };
 };
 
-// 用于跨线程传递消息的上下文，使用时动态分配
-// 使用MSG_RING操作将高32位地址放入cqe->res字段中，低32位地址放入user_data中
+// 用于跨线程传递消息的上下文，使用时动态分配，每个接收连接持有一个引用
 struct CTContext {
   // 引用计数
   std::atomic<int> ref_count;
@@ -60,6 +84,8 @@ struct CTContext {
   uint32_t snd_conn_id;
   // 承载着发送方想要发送的数据
   std::string message;
+  // 接收方发送队列超出预算时可以丢弃，例如在线状态通知
+  bool droppable{false};
 
   CTContext(int refs, uint32_t conn_id, std::string msg)
       : ref_count(refs), snd_conn_id(conn_id), message(std::move(msg)) {}
@@ -68,33 +94,38 @@ struct CTContext {
   CTContext &operator=(const CTContext &) = delete;
 };
 
-static inline void release_context(CTContext *context) {
+class EventLoop;
+
+// 一轮事件循环中发往同一个worker线程的全部跨线程消息，
+// 通过目标线程的邮箱投递，由接收方在本地分发后释放
+struct CTBatch {
+  struct item {
+    // 接收方的连接id
+    uint32_t conn_id;
+    CTContext *context;
+  };
+  std::vector<item> items;
+  // 需要在目标线程中执行的函数，在所有消息之后按顺序执行
+  std::vector<std::function<void()>> calls;
+  // 目标线程已退出、批次无法投递时代替calls执行，参数为执行所在的事件循环
+  std::vector<std::function<void(EventLoop *)>> drops;
+};
+
+// 释放count个引用，引用计数归零时释放上下文
+static inline void release_context(CTContext *context, int count = 1) {
   // 当前引用计数为0，进行释放操作
-  if (context->ref_count.fetch_sub(1, std::memory_order_acq_rel) == 1) {
-    spdlog::info("release cross thread message context successful!");
+  if (context->ref_count.fetch_sub(count, std::memory_order_acq_rel) ==
+      count) {
+    JDOCS_LOG_TRACE("release cross thread message context successful!");
     delete context;
   }
 }
 
-static inline uint32_t ctcontext_high_addr(CTContext *context) {
-  return reinterpret_cast<uint64_t>(context) >> 32;
-}
-
-static inline uint32_t ctcontext_low_addr(CTContext *context) {
-  return reinterpret_cast<uint64_t>(context) & 0x00000000FFFFFFFF;
-}
-
-static inline CTContext *get_ctcontext(uint32_t high_addr, uint32_t low_addr) {
-  return reinterpret_cast<CTContext *>(
-      (static_cast<uint64_t>(high_addr) << 32) | low_addr);
-}
-
-// 传递跨线程上下文低32位地址，封装为user_data
-static inline uint64_t ctcontext_encode(uint32_t conn_id, uint32_t ctx_addr) {
-  struct Context context = {.op_conn_id = (__CROSS_THREAD_MSG << OP_SHIFT) |
-                                          (conn_id & 0x0FFFFFFF),
-                            .low_addr = ctx_addr};
-  return context.val;
+// 丢弃无法投递的批次，释放其中消息上下文的引用，不执行其中的函数
+static inline void release_batch(CTBatch *batch) {
+  for (auto &item : batch->items)
+    release_context(item.context);
+  delete batch;
 }
 
 static inline void user_data_encode(struct io_uring_sqe *sqe, int opcode,
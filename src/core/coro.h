@@ -0,0 +1,216 @@
+// Copyright (c) 2025-2026 Juantgd. All Rights Reserved.
+
+#ifndef JDOCS_CORE_CORO_H_
+#define JDOCS_CORE_CORO_H_
+
+#include <coroutine>
+#include <exception>
+#include <optional>
+#include <type_traits>
+#include <unordered_set>
+#include <utility>
+
+#include <spdlog/spdlog.h>
+
+namespace jdocs {
+
+template <typename T = void> class Task;
+class TaskGroup;
+
+namespace coro_detail {
+
+struct promise_base {
+  // 等待该任务结束的协程，任务结束时恢复执行
+  std::coroutine_handle<> continuation;
+  std::exception_ptr exception;
+  // 分离运行的任务所属的任务组，任务结束时由任务组销毁
+  TaskGroup *group{nullptr};
+
+  struct final_awaiter {
+    bool await_ready() noexcept { return false; }
+    template <typename P>
+    std::coroutine_handle<> await_suspend(std::coroutine_handle<P> h) noexcept;
+    void await_resume() noexcept {}
+  };
+
+  // 任务在被等待或分离运行时才开始执行
+  std::suspend_always initial_suspend() noexcept { return {}; }
+  final_awaiter final_suspend() noexcept { return {}; }
+  void unhandled_exception() { exception = std::current_exception(); }
+};
+
+template <typename T> struct promise : promise_base {
+  std::optional<T> value;
+
+  Task<T> get_return_object();
+  template <typename U> void return_value(U &&v) {
+    value.emplace(std::forward<U>(v));
+  }
+  T result() {
+    if (exception)
+      std::rethrow_exception(exception);
+    return std::move(*value);
+  }
+};
+
+template <> struct promise<void> : promise_base {
+  Task<void> get_return_object();
+  void return_void() {}
+  void result() {
+    if (exception)
+      std::rethrow_exception(exception);
+  }
+};
+
+} // namespace coro_detail
+
+// 惰性启动的协程任务，只能在所属事件循环的线程中等待与恢复
+// 被co_await时开始执行，结束后通过对称转移直接恢复等待方，不经过事件循环
+template <typename T> class Task {
+public:
+  using promise_type = coro_detail::promise<T>;
+  using handle_type = std::coroutine_handle<promise_type>;
+
+  Task() = default;
+  explicit Task(handle_type handle) : handle_(handle) {}
+  ~Task() {
+    if (handle_)
+      handle_.destroy();
+  }
+
+  Task(const Task &) = delete;
+  Task &operator=(const Task &) = delete;
+  Task(Task &&other) noexcept : handle_(std::exchange(other.handle_, {})) {}
+  Task &operator=(Task &&other) noexcept {
+    if (this != &other) {
+      if (handle_)
+        handle_.destroy();
+      handle_ = std::exchange(other.handle_, {});
+    }
+    return *this;
+  }
+
+  inline bool valid() const { return static_cast<bool>(handle_); }
+
+  bool await_ready() const noexcept { return false; }
+  std::coroutine_handle<> await_suspend(std::coroutine_handle<> waiter) {
+    handle_.promise().continuation = waiter;
+    return handle_;
+  }
+  // 任务中未捕获的异常在等待方重新抛出
+  T await_resume() { return handle_.promise().result(); }
+
+private:
+  friend class TaskGroup;
+
+  inline handle_type release() { return std::exchange(handle_, {}); }
+
+  handle_type handle_;
+};
+
+// 分离运行的任务集合，只能由单个线程使用
+// 任务结束后自动销毁，任务组析构时销毁所有尚未结束的任务，
+// 因此挂起中的任务所等待的对象需能在协程帧销毁时自行撤销等待
+class TaskGroup {
+public:
+  TaskGroup() = default;
+  ~TaskGroup() { Clear(); }
+
+  TaskGroup(const TaskGroup &) = delete;
+  TaskGroup &operator=(const TaskGroup &) = delete;
+
+  // 立即开始执行任务，直到其第一次挂起
+  void Spawn(Task<void> task) {
+    auto handle = task.release();
+    if (!handle)
+      return;
+    handle.promise().group = this;
+    tasks_.insert(handle.address());
+    handle.resume();
+  }
+
+  // 销毁所有尚未结束的任务
+  void Clear() {
+    for (void *address : tasks_)
+      std::coroutine_handle<>::from_address(address).destroy();
+    tasks_.clear();
+  }
+
+  inline size_t size() const { return tasks_.size(); }
+
+private:
+  friend struct coro_detail::promise_base;
+
+  void finish(std::coroutine_handle<coro_detail::promise<void>> handle) {
+    if (handle.promise().exception) {
+      try {
+        std::rethrow_exception(handle.promise().exception);
+      } catch (const std::exception &e) {
+        spdlog::error("unhandled exception in task: {}", e.what());
+      } catch (...) {
+        spdlog::error("unhandled exception in task");
+      }
+    }
+    tasks_.erase(handle.address());
+    handle.destroy();
+  }
+
+  // 协程帧的地址
+  std::unordered_set<void *> tasks_;
+};
+
+// 单次完成的结果，用于将基于回调的异步操作转换为可等待对象，例如异步的数据库查询
+// Set需在等待方所在的线程中调用，等待方会在Set中立即恢复执行
+template <typename T> class Completion {
+public:
+  Completion() = default;
+  Completion(const Completion &) = delete;
+  Completion &operator=(const Completion &) = delete;
+
+  void Set(T value) {
+    value_.emplace(std::move(value));
+    if (waiter_)
+      std::exchange(waiter_, {}).resume();
+  }
+
+  inline bool ready() const { return value_.has_value(); }
+
+  bool await_ready() const noexcept { return value_.has_value(); }
+  void await_suspend(std::coroutine_handle<> waiter) noexcept {
+    waiter_ = waiter;
+  }
+  T await_resume() { return std::move(*value_); }
+
+private:
+  std::optional<T> value_;
+  std::coroutine_handle<> waiter_;
+};
+
+namespace coro_detail {
+
+template <typename P>
+std::coroutine_handle<> promise_base::final_awaiter::await_suspend(
+    std::coroutine_handle<P> h) noexcept {
+  promise_base &p = h.promise();
+  if (p.continuation)
+    return p.continuation;
+  if constexpr (std::is_void_v<decltype(h.promise().result())>) {
+    if (p.group)
+      p.group->finish(h);
+  }
+  return std::noop_coroutine();
+}
+
+template <typename T> Task<T> promise<T>::get_return_object() {
+  return Task<T>(std::coroutine_handle<promise<T>>::from_promise(*this));
+}
+
+inline Task<void> promise<void>::get_return_object() {
+  return Task<void>(std::coroutine_handle<promise<void>>::from_promise(*this));
+}
+
+} // namespace coro_detail
+
+} // namespace jdocs
+
+#endif
@@ -2,44 +2,161 @@
 
 #include "event_loop.h"
 
+#include <algorithm>
+#include <chrono>
 #include <cstdlib>
 #include <cstring>
+#include <stdexcept>
+#include <thread>
 
 #include <liburing.h>
 #include <spdlog/spdlog.h>
 
+#include "metrics.h"
 #include "server.h"
+#include "upgrade.h"
 #include "utils/helpers.h"
+#include "utils/logger.h"
 
 namespace jdocs {
 
+namespace {
+// 默认的io_uring实例设置标志
+constexpr uint32_t kDefaultRingFlags =
+    IORING_SETUP_DEFER_TASKRUN | IORING_SETUP_SINGLE_ISSUER;
+// 统计事件循环繁忙程度的时间窗口，单位纳秒
+constexpr uint64_t kLoadWindowNanos = 100 * 1000 * 1000;
+// 批量大小的指数加权平均以定点数保存，小数部分的位数
+constexpr uint32_t kBatchEwmaFrac = 4;
+// 每次更新时新样本所占的权重为1/8
+constexpr uint32_t kBatchEwmaShift = 3;
+// 暂停接受新连接后，检查是否可以恢复的间隔，单位毫秒
+constexpr uint32_t kAcceptRetryDelay = 100;
+// 强制关闭剩余连接后，等待关闭完成与发送缓冲区归还的最长时间，单位毫秒
+constexpr uint64_t kDrainForceGrace = 1000;
+// 之后仍未归还的计算任务与发送数据不再等待，有意泄漏其占用的资源后退出，单位毫秒
+constexpr uint64_t kDrainLeakGrace = 5000;
+// master线程通知worker线程退出时携带的标志
+// 立即关闭所有连接
+constexpr int kDrainForce = 1;
+// 热升级，将空闲的websocket连接移交给新进程
+constexpr int kDrainHandoff = 2;
+// __SEND完成事件中bid字段为1表示连接发送队列的请求
+constexpr uint16_t kSendQueued = 1;
+// __SEND_ZC完成事件中bid字段为该值表示连接发送队列的请求，不对应任何发送缓冲区
+constexpr uint16_t kSendZcQueued = UINT16_MAX;
+// 连接切换接收缓冲组之前至少需要的接收次数
+constexpr uint32_t kRecvGroupSamples = 8;
+// __TIMEOUT完成事件中bid字段表示的超时请求用途
+// 时间轮的超时
+constexpr uint16_t kTimeoutWheel = 0;
+// 修改时间轮的超时，只有失败时产生完成事件
+constexpr uint16_t kTimeoutWheelUpdate = 1;
+// 高精度计时器的超时
+constexpr uint16_t kTimeoutPrecise = 2;
+constexpr uint16_t kTimeoutPreciseUpdate = 3;
+// 目标邮箱已满时重试投递跨线程消息的超时
+constexpr uint16_t kTimeoutMailboxRetry = 4;
+// 重试投递跨线程消息的间隔，单位微秒
+constexpr uint32_t kMailboxRetryMicros = 100;
+
+// 非事件循环线程发送门铃所使用的io_uring实例，首次使用时创建，线程退出时销毁
+struct doorbell_ring {
+  struct io_uring ring;
+  bool ready{false};
+  ~doorbell_ring() {
+    if (ready)
+      io_uring_queue_exit(&ring);
+  }
+};
+thread_local doorbell_ring local_doorbell;
+// 非事件循环线程的门铃发送失败后重试的初始与最大间隔，单位微秒
+constexpr uint32_t kDoorbellRetryMicros = 100;
+constexpr uint32_t kDoorbellRetryMaxMicros = 100000;
+
+// 通过本线程的门铃实例向ring_fd发送跨线程消息门铃，失败时返回负的错误码
+int ring_doorbell(int ring_fd) {
+  doorbell_ring &db = local_doorbell;
+  int ret;
+  if (!db.ready) {
+    ret = io_uring_queue_init(4, &db.ring, 0);
+    if (ret < 0)
+      return ret;
+    db.ready = true;
+  }
+  struct io_uring_sqe *sqe = io_uring_get_sqe(&db.ring);
+  if (!sqe)
+    return -EBUSY;
+  io_uring_prep_msg_ring(sqe, ring_fd, 0,
+                         context_encode(__CROSS_THREAD_MSG, 0, 0, 0), 0);
+  struct io_uring_cqe *cqe;
+  ret = io_uring_submit_and_wait(&db.ring, 1);
+  if (ret >= 0 && !(ret = io_uring_peek_cqe(&db.ring, &cqe))) {
+    ret = cqe->res;
+    io_uring_cqe_seen(&db.ring, cqe);
+  }
+  return ret < 0 ? ret : 0;
+}
+} // namespace
+
 EventLoop::EventLoop(JdocsServer *server, Worker *worker, bool flag)
-    : server_(server), worker_(worker), flag_(flag) {
-  SetUpIoUring(kQueueDepth);
+    : server_(server), worker_(worker), config_(&server->GetConfig()),
+      flag_(flag) {
+  SetUpIoUring(config_->queue_depth, config_->fd_table_size);
+  min_timeout_ = ring_.features & IORING_FEAT_MIN_TIMEOUT;
+  // bundle模式需要6.10及以上的内核
+  recv_bundle_ =
+      config_->recv_bundle && (ring_.features & IORING_FEAT_RECVSEND_BUNDLE);
   // 只有worker线程需要
   if (flag_) {
-    buffer_pool_ = std::make_unique<BufferPool>(&ring_);
-    time_wheel_ = std::make_unique<TimeWheel>();
-    uint32_t count;
-    timespec *tsv = time_wheel_->GetTimeoutCache(&count);
-    // 启动时，批量提交超时请求
-    for (uint32_t i = 0; i < count; ++i) {
-      __prep_timeout(&tsv[i]);
-    }
+    buffer_pool_ = std::make_unique<BufferPool>(&ring_, *config_);
+    time_wheel_ = std::make_unique<TimeWheel>(config_->timer_tick,
+                                              config_->timer_tickless);
+    // tickless模式下只在有计时器时设置超时，空闲的worker线程不会被定时唤醒
+    if (config_->timer_tickless)
+      armed_tick_ = UINT64_MAX;
+    else
+      prep_tick_timeout();
+    mailbox_ = std::make_unique<Mailbox<CTBatch *>>(config_->mailbox_capacity);
+    ct_batches_.resize(server_->GetWorkerCount(), nullptr);
+    // reuseport模式下由worker线程直接接受新连接
+    if (config_->accept_mode == kAcceptModeReuseport)
+      prep_accept(server_->GetListeningFd(worker_->GetIndex()));
     // spdlog::info("[start]: {}", get_current_millis());
   }
 }
 
-EventLoop::~EventLoop() { DestroyIoUring(); }
+EventLoop::~EventLoop() {
+  // 挂起中的协程可能等待着时间轮中的定时器，需先于时间轮销毁
+  tasks_.Clear();
+  // 释放尚未投递与尚未处理的跨线程消息
+  for (CTBatch *batch : ct_batches_)
+    if (batch)
+      release_batch(batch);
+  if (mailbox_)
+    mailbox_->Drain([](CTBatch *batch) { release_batch(batch); });
+  // 内核可能仍在读取发送缓冲区，不再释放
+  if (drain_leaked_)
+    (void)buffer_pool_.release();
+  DestroyIoUring();
+}
 
 int EventLoop::Run() {
   running_ = true;
   struct io_uring_cqe *cqe;
   int ret = 0;
+  load_window_start_ = get_current_nanos();
   while (running_) {
     unsigned head, completion_count = 0;
+    if (!ct_pending_workers_.empty())
+      flush_cross_thread_msgs();
+    // 仍有批次因目标邮箱已满而未投递，设置短超时保证等待结束后能够重试
+    if (!ct_pending_workers_.empty() && !ct_retry_armed_)
+      prep_mailbox_retry();
+    if (timer_rearm_)
+      arm_timer();
     // 等待完成队列
-    ret = io_uring_submit_and_wait(&ring_, 1);
+    ret = wait_completions();
     if (ret < 0) {
       if (ret == -EINTR)
         continue;
@@ -47,6 +164,8 @@ int EventLoop::Run() {
       spdlog::error("io_uring_wait_cqe failed. error msg: {}", strerror(-ret));
       break;
     }
+    uint64_t wake_nanos = get_current_nanos();
+    now_millis_ = wake_nanos / 1000000;
     // 当完成队列中有完成条目，则批量获取完成条目，并对其进行处理
     io_uring_for_each_cqe(&ring_, head, cqe) {
       if (EventHandler(cqe))
@@ -54,10 +173,117 @@ int EventLoop::Run() {
       ++completion_count;
     }
     io_uring_cq_advance(&ring_, completion_count);
+    metrics_add(METRIC_CQE_BATCHES);
+    metrics_add(METRIC_CQES, completion_count);
+    update_wait_target(completion_count);
+    if (!ready_.empty())
+      resume_ready();
+    update_load(wake_nanos, get_current_nanos());
   }
   return 0;
 }
 
+void EventLoop::count_send(uint32_t conn_id) {
+  TcpConnection *connection = worker_->GetConnection(conn_id);
+  if (connection)
+    connection->SendQueued();
+}
+
+void EventLoop::resume_ready() {
+  // 恢复的协程可能再次加入就绪队列，直到队列为空
+  std::vector<std::coroutine_handle<>> ready;
+  while (!ready_.empty()) {
+    ready.swap(ready_);
+    for (std::coroutine_handle<> handle : ready)
+      handle.resume();
+    ready.clear();
+  }
+}
+
+// 只有worker线程按近期的批量大小等待多个完成事件，master线程每次只等待一个
+int EventLoop::wait_completions() {
+  if (!flag_)
+    return io_uring_submit_and_wait(&ring_, 1);
+  if (config_->busy_poll_us && busy_poll())
+    return 0;
+  if (wait_target_ <= 1)
+    return io_uring_submit_and_wait(&ring_, 1);
+  struct io_uring_cqe *cqe;
+  // 内核支持时，等待min_wait后只要存在完成事件即返回，否则继续等待第一个完成事件
+  if (min_timeout_)
+    return io_uring_submit_and_wait_min_timeout(
+        &ring_, &cqe, wait_target_, NULL, config_->wait_timeout_us, NULL);
+  struct __kernel_timespec ts;
+  ts.tv_sec = config_->wait_timeout_us / 1000000;
+  ts.tv_nsec = (config_->wait_timeout_us % 1000000) * 1000L;
+  int ret =
+      io_uring_submit_and_wait_timeout(&ring_, &cqe, wait_target_, &ts, NULL);
+  if (ret != -ETIME)
+    return ret;
+  metrics_add(METRIC_WAIT_TIMEOUTS);
+  // 超时后仍没有完成事件，说明当前较为空闲，不再定时唤醒
+  if (io_uring_cq_ready(&ring_))
+    return 0;
+  return io_uring_submit_and_wait(&ring_, 1);
+}
+
+// 提交请求后在限定时间内轮询完成队列，找到完成事件时返回true
+// DEFER_TASKRUN模式下完成事件只有在进入内核时才会产生，因此需要主动获取
+bool EventLoop::busy_poll() {
+  int ret = io_uring_submit(&ring_);
+  if (ret < 0)
+    return false;
+  uint64_t deadline = get_current_nanos() + config_->busy_poll_us * 1000ULL;
+  do {
+    if (io_uring_cq_ready(&ring_)) {
+      metrics_add(METRIC_BUSY_POLL_HITS);
+      return true;
+    }
+    io_uring_get_events(&ring_);
+  } while (get_current_nanos() < deadline);
+  return false;
+}
+
+void EventLoop::update_wait_target(unsigned count) {
+  // 超时返回时没有完成事件，不计入批量大小分布
+  if (count >= 32)
+    metrics_add(METRIC_CQE_BATCHES_32);
+  else if (count >= 8)
+    metrics_add(METRIC_CQE_BATCHES_8_31);
+  else if (count >= 2)
+    metrics_add(METRIC_CQE_BATCHES_2_7);
+  else if (count == 1)
+    metrics_add(METRIC_CQE_BATCHES_1);
+  if (!flag_ || config_->wait_batch_max <= 1)
+    return;
+  // 下一次等待的数量跟随近期的平均批量大小，超时返回的较小批量会使其逐渐回落
+  // 先衰减旧值再加入本次样本，稳定时平均值等于批量大小
+  batch_ewma_ -= batch_ewma_ >> kBatchEwmaShift;
+  batch_ewma_ += (count << kBatchEwmaFrac) >> kBatchEwmaShift;
+  uint32_t target = (batch_ewma_ + (1U << (kBatchEwmaFrac - 1))) >>
+                    kBatchEwmaFrac;
+  target = std::clamp(target, 1U, config_->wait_batch_max);
+  if (target != wait_target_) {
+    wait_target_ = target;
+    metrics_set(METRIC_WAIT_TARGET, target);
+  }
+}
+
+void EventLoop::update_load(uint64_t wake_nanos, uint64_t now_nanos) {
+  load_busy_nanos_ += now_nanos - wake_nanos;
+  uint64_t elapsed = now_nanos - load_window_start_;
+  if (elapsed < kLoadWindowNanos)
+    return;
+  uint32_t busy = static_cast<uint32_t>(load_busy_nanos_ * 1000 / elapsed);
+  // 指数加权平均，平滑短时间的负载抖动
+  busy_permille_ = (busy_permille_ * 3 + busy) / 4;
+  load_busy_nanos_ = 0;
+  load_window_start_ = now_nanos;
+  metrics_set(METRIC_LOOP_BUSY, busy_permille_);
+  if (flag_)
+    worker_->GetLoad()->busy.store(busy_permille_, std::memory_order_relaxed);
+}
+
 int EventLoop::EventHandler(struct io_uring_cqe *cqe) {
   int ret = 0;
   // 获取操作码，调用对应的处理函数进行处理
@@ -92,6 +318,15 @@ int EventLoop::EventHandler(struct io_uring_cqe *cqe) {
   case __TIMEOUT:
     ret = handle_timeout(cqe);
     break;
+  case __SIGNAL:
+    ret = handle_signal(cqe);
+    break;
+  case __DRAIN:
+    ret = handle_drain(cqe);
+    break;
+  case __UPGRADE:
+    ret = handle_upgrade(cqe);
+    break;
   case __NOP:
     return 0;
   default:
@@ -101,20 +336,57 @@ int EventLoop::EventHandler(struct io_uring_cqe *cqe) {
   return ret;
 }
 
-void EventLoop::SetUpIoUring(uint32_t entries) {
+void EventLoop::SetUpIoUring(uint32_t entries, uint32_t fd_table_size) {
   struct io_uring_params params;
   memset(&params, 0, sizeof(struct io_uring_params));
-  params.flags = IORING_SETUP_DEFER_TASKRUN | IORING_SETUP_SINGLE_ISSUER;
-  // 设置轮询线程超时闲置时间，默认1000ms
-  // params.sq_thread_idle = kThreadIdleTime;
+  switch (config_->ring_mode) {
+  case kRingModeDeferTaskrun:
+    // 完成事件的任务推迟到等待完成事件时才运行，减少中断与上下文切换
+    params.flags = kDefaultRingFlags;
+    break;
+  case kRingModeCoopTaskrun:
+    // 有待运行任务时不再打断用户态，而是设置IORING_SQ_TASKRUN标志，
+    // 由下一次进入内核时运行
+    params.flags = IORING_SETUP_COOP_TASKRUN | IORING_SETUP_TASKRUN_FLAG |
+                   IORING_SETUP_SINGLE_ISSUER;
+    break;
+  case kRingModeSqpoll:
+    // 由内核轮询线程获取提交队列中的请求，提交时无需系统调用，代价是轮询线程占用CPU
+    params.flags = IORING_SETUP_SQPOLL | IORING_SETUP_SINGLE_ISSUER;
+    // 设置轮询线程超时闲置时间，闲置超时后轮询线程休眠，由下一次提交唤醒
+    params.sq_thread_idle = config_->sqpoll_idle;
+    if (config_->sqpoll_cpu >= 0) {
+      params.flags |= IORING_SETUP_SQ_AFF;
+      params.sq_thread_cpu = static_cast<uint32_t>(config_->sqpoll_cpu);
+    }
+    // worker线程的io_uring实例共享master线程的轮询线程
+    if (flag_ && config_->sqpoll_shared) {
+      params.flags |= IORING_SETUP_ATTACH_WQ;
+      params.wq_fd = static_cast<uint32_t>(server_->GetMasterRingFd());
+    }
+    break;
+  }
   int ret = io_uring_queue_init_params(entries, &ring_, &params);
+  // 内核不支持所选模式时，依次退化为默认模式以及不设置任何标志
+  for (uint32_t flags : {kDefaultRingFlags, 0U}) {
+    if (ret >= 0 || (ret != -EINVAL && ret != -EPERM))
+      break;
+    if (params.flags == flags)
+      continue;
+    spdlog::warn("io_uring setup flags {:#x} unsupported, fall back to {:#x}. "
+                 "error msg: {}",
+                 params.flags, flags, strerror(-ret));
+    memset(&params, 0, sizeof(struct io_uring_params));
+    params.flags = flags;
+    ret = io_uring_queue_init_params(entries, &ring_, &params);
+  }
   if (ret < 0) {
     spdlog::error("io_uring_queue_init_params failed. error msg: {}",
                   strerror(-ret));
     exit(EXIT_FAILURE);
   }
   // 向io_uring实例中注册直接文件描述符表，默认2048个直接文件描述符
-  ret = io_uring_register_files_sparse(&ring_, kFdTableSize);
+  ret = io_uring_register_files_sparse(&ring_, fd_table_size);
   if (ret < 0) {
     spdlog::error("io_uring_register_files_sparse failed. error msg: {}",
                   strerror(-ret));
@@ -150,12 +422,14 @@ struct io_uring_sqe *EventLoop::GetSqe() {
   return sqe;
 }
 
-int EventLoop::prep_recv(int fd, uint32_t conn_id) {
+int EventLoop::prep_recv(int fd, uint32_t conn_id, uint8_t group) {
   struct io_uring_sqe *sqe = GetSqe();
   io_uring_prep_recv_multishot(sqe, fd, NULL, 0, 0);
   sqe->flags |= IOSQE_FIXED_FILE | IOSQE_BUFFER_SELECT;
-  sqe->buf_group = buffer_pool_->GetBgid();
-  user_data_encode(sqe, __RECV, conn_id, fd, 0);
+  sqe->buf_group = buffer_pool_->GetBgid(group);
+  if (recv_bundle_)
+    sqe->ioprio |= IORING_RECVSEND_BUNDLE;
+  user_data_encode(sqe, __RECV, conn_id, fd, group);
   return 0;
 }
 
@@ -168,20 +442,46 @@ int EventLoop::prep_send(int fd, uint32_t conn_id, void *data, size_t length,
   if (flag)
     sqe->flags |= IOSQE_IO_LINK;
   user_data_encode(sqe, __SEND, conn_id, fd, 0);
+  count_send(conn_id);
   return 0;
 }
 
+// 每个连接同一时刻只有一个，不计入连接的发送请求数量
+// 较小的数据直接拷贝，零拷贝发送多一个通知事件并且需要固定用户内存，
+// 只有数据足够大时固定内存的开销才低于拷贝的开销
+bool EventLoop::prep_send_queued(int fd, uint32_t conn_id, void *data,
+                                 size_t length, bool flag) {
+  struct io_uring_sqe *sqe = GetSqe();
+  bool zero_copy =
+      config_->send_zc_threshold && length >= config_->send_zc_threshold;
+  if (zero_copy) {
+    io_uring_prep_send_zc(sqe, fd, data, length, MSG_WAITALL | MSG_NOSIGNAL,
+                          0);
+    user_data_encode(sqe, __SEND_ZC, conn_id, fd, kSendZcQueued);
+    metrics_add(METRIC_SENDS_ZC);
+  } else {
+    io_uring_prep_send(sqe, fd, data, length, MSG_WAITALL | MSG_NOSIGNAL);
+    user_data_encode(sqe, __SEND, conn_id, fd, kSendQueued);
+    metrics_add(METRIC_SENDS_COPY);
+  }
+  sqe->flags |= IOSQE_FIXED_FILE;
+  if (flag)
+    sqe->flags |= IOSQE_IO_LINK;
+  return zero_copy;
+}
+
 // 零拷贝发送操作
 int EventLoop::prep_send_zc(int fd, uint32_t conn_id, void *data, uint16_t bidx,
                             size_t length, bool flag) {
   struct io_uring_sqe *sqe = GetSqe();
   io_uring_prep_send_zc(sqe, fd, data, length, MSG_WAITALL | MSG_NOSIGNAL, 0);
-  sqe->buf_index = bidx;
+  sqe->buf_index = buffer_pool_->GetSendBufferRegIndex(bidx);
   sqe->ioprio = IORING_RECVSEND_FIXED_BUF;
   sqe->flags |= IOSQE_FIXED_FILE;
   if (flag)
     sqe->flags |= IOSQE_IO_LINK;
   user_data_encode(sqe, __SEND_ZC, conn_id, fd, bidx);
+  count_send(conn_id);
   return 0;
 }
 
@@ -196,31 +496,217 @@ int EventLoop::prep_close(int fd, uint32_t conn_id) {
   return 0;
 }
 
-// 准备向其他事件循环中的io_uring实例提交sqe，实现跨线程通讯
+// 准备一个跨线程消息，发往同一个worker线程的消息会在本轮事件循环结束前合并为一个批次
 int EventLoop::prep_cross_thread_msg(uint32_t conn_id, CTContext *context) {
-  struct io_uring_sqe *sqe = GetSqe();
-  uint64_t user_data = ctcontext_encode(conn_id, ctcontext_low_addr(context));
-  int ring_fd = server_->ConnectionIdToRingFd(conn_id);
+  uint32_t worker = conn_id_to_worker(conn_id);
   // 在同一个事件循环中
-  if (ring_fd == ring_.ring_fd) {
-    std::shared_ptr<TcpConnection> connection = worker_->GetConnection(conn_id);
-    if (!connection || connection->closed()) {
-      spdlog::info("[{}] conn_id: {} not online", worker_->GetName(), conn_id);
-      release_context(context);
-      return 0;
-    }
-    // 调用对应的处理函数进行处理
-    connection->CrossThreadMsgHandle(context->message.data(),
-                                     context->message.size());
+  if (worker == worker_->GetIndex()) {
+    deliver_cross_thread_msg(conn_id, context);
     release_context(context);
     return 0;
   }
-  io_uring_prep_msg_ring(sqe, ring_fd, ctcontext_high_addr(context), user_data,
-                         0);
-  user_data_encode(sqe, __NOP, conn_id, 0, 0);
+  CTBatch *&batch = ct_batches_[worker];
+  if (!batch) {
+    batch = new CTBatch;
+    ct_pending_workers_.push_back(worker);
+  }
+  batch->items.push_back({conn_id, context});
+  metrics_add(METRIC_CT_MSGS_SENT);
   return 0;
 }
 
+void EventLoop::prep_cross_thread_call(uint32_t worker,
+                                       std::function<void()> fn,
+                                       std::function<void(EventLoop *)> drop) {
+  if (worker == worker_->GetIndex()) {
+    fn();
+    return;
+  }
+  CTBatch *&batch = ct_batches_[worker];
+  if (!batch) {
+    batch = new CTBatch;
+    ct_pending_workers_.push_back(worker);
+  }
+  batch->calls.push_back(std::move(fn));
+  if (drop)
+    batch->drops.push_back(std::move(drop));
+}
+
+void EventLoop::reject_batch(CTBatch *batch) {
+  for (auto &drop : batch->drops)
+    drop(this);
+  release_batch(batch);
+}
+
+void EventLoop::PostFromAnyThread(std::function<void()> fn) {
+  // 事件循环已退出时丢弃fn
+  if (mailbox_->closed())
+    return;
+  CTBatch *batch = new CTBatch;
+  batch->calls.push_back(std::move(fn));
+  int ret;
+  // 调用方不是事件循环线程，邮箱已满时可以等待消费者取出
+  while ((ret = mailbox_->Push(batch)) < 0) {
+    if (mailbox_->closed()) {
+      delete batch;
+      return;
+    }
+    std::this_thread::yield();
+  }
+  if (ret == 0)
+    return;
+  // 邮箱已由空变为非空，之后的生产者不会再发送门铃，失败时必须按退避间隔重试，
+  // 直到发送成功或事件循环退出
+  uint32_t delay = kDoorbellRetryMicros;
+  while ((ret = ring_doorbell(ring_.ring_fd)) < 0 && !mailbox_->closed()) {
+    spdlog::error("doorbell from compute thread failed, retry in {} us. "
+                  "error msg: {}",
+                  delay, strerror(-ret));
+    std::this_thread::sleep_for(std::chrono::microseconds(delay));
+    delay = std::min(delay * 2, kDoorbellRetryMaxMicros);
+  }
+}
+
+bool EventLoop::Offload(std::function<void()> work,
+                        std::function<void()> done) {
+  ComputePool *pool = server_->GetComputePool();
+  if (!pool)
+    return false;
+  bool ok = pool->Submit(
+      [this, work = std::move(work), done = std::move(done)]() mutable {
+        // work抛出异常时仍需执行done，否则等待其结果的状态永远无法恢复
+        try {
+          work();
+        } catch (const std::exception &e) {
+          spdlog::error("offloaded work failed. error: {}", e.what());
+        }
+        PostFromAnyThread([this, done = std::move(done)] {
+          --offloads_inflight_;
+          done();
+        });
+      });
+  metrics_add(ok ? METRIC_OFFLOADED : METRIC_OFFLOAD_REJECTS);
+  // 平滑退出需等待所有done执行完毕，避免其被投递到已退出的事件循环
+  if (ok)
+    ++offloads_inflight_;
+  return ok;
+}
+
+TcpConnection *EventLoop::GetConnection(uint32_t conn_id) {
+  return worker_->GetConnection(conn_id);
+}
+
+// 在目标线程中执行fn后，再通过跨线程调用回到发起线程恢复等待方
+// 目标线程已退出时以异常恢复等待方，不在发起线程中执行时经由其邮箱投递
+void EventLoop::CallAwaiter::await_suspend(std::coroutine_handle<> waiter) {
+  state_->waiter = waiter;
+  EventLoop *origin = loop_;
+  uint32_t origin_index = loop_->worker_->GetIndex();
+  EventLoop *target = loop_->server_->GetWorkerEventLoop(worker_);
+  auto drop = [state = state_, origin](EventLoop *current) {
+    state->error = std::make_exception_ptr(
+        std::runtime_error("target worker has exited"));
+    auto resume = [state, origin] {
+      if (state->waiter)
+        origin->Post(state->waiter);
+    };
+    if (current == origin)
+      resume();
+    else
+      origin->PostFromAnyThread(std::move(resume));
+  };
+  loop_->prep_cross_thread_call(
+      worker_,
+      [state = state_, fn = std::move(fn_), origin, origin_index,
+       target]() mutable {
+        // 异常不能在目标线程的事件循环中传播，交由等待方处理
+        try {
+          state->result = fn();
+        } catch (...) {
+          state->error = std::current_exception();
+        }
+        target->prep_cross_thread_call(origin_index, [state, origin] {
+          if (state->waiter)
+            origin->Post(state->waiter);
+        });
+      },
+      std::move(drop));
+}
+
+// 将本轮事件循环中积累的跨线程消息批次投递到各个目标线程的邮箱中，
+// 只有邮箱由空变为非空时才需要通过MSG_RING发送门铃
+void EventLoop::flush_cross_thread_msgs() {
+  size_t deferred = 0;
+  for (uint32_t worker : ct_pending_workers_) {
+    Mailbox<CTBatch *> *mailbox =
+        server_->GetWorkerEventLoop(worker)->GetMailbox();
+    // 目标线程已完成平滑退出，其中的连接均已关闭，直接丢弃该批次
+    if (mailbox->closed()) {
+      reject_batch(ct_batches_[worker]);
+      ct_batches_[worker] = nullptr;
+      continue;
+    }
+    int ret = mailbox->Push(ct_batches_[worker]);
+    if (ret < 0) {
+      // 目标邮箱已满，保留该批次在之后的事件循环中重试，
+      // 期间新的消息继续追加到该批次中，保证消息顺序
+      ct_pending_workers_[deferred++] = worker;
+      metrics_add(METRIC_MAILBOX_FULL);
+      continue;
+    }
+    ct_batches_[worker] = nullptr;
+    metrics_add(METRIC_CT_BATCHES_SENT);
+    if (ret == 1)
+      send_doorbell(worker);
+  }
+  ct_pending_workers_.resize(deferred);
+}
+
+void EventLoop::send_doorbell(uint32_t worker) {
+  struct io_uring_sqe *sqe = GetSqe();
+  // 目标线程收到的完成事件中携带发送方的编号
+  io_uring_prep_msg_ring(sqe, server_->GetWorkerRingFd(worker), 0,
+                         context_encode(__CROSS_THREAD_MSG,
+                                        worker_->GetIndex(), 0, 0),
+                         0);
+  // 发送成功时不产生完成事件，失败时由本线程重新发送，避免门铃丢失后邮箱无法被唤醒
+  user_data_encode(sqe, __CROSS_THREAD_MSG, worker, 0, 0);
+  sqe->flags |= IOSQE_CQE_SKIP_SUCCESS;
+  metrics_add(METRIC_CT_DOORBELLS);
+}
+
+// 分发一个跨线程消息批次并释放
+void EventLoop::deliver_cross_thread_batch(CTBatch *batch) {
+  metrics_add(METRIC_CT_MSGS_RECEIVED, batch->items.size());
+  auto &items = batch->items;
+  for (size_t i = 0, run = 0; i != items.size(); ++i) {
+    deliver_cross_thread_msg(items[i].conn_id, items[i].context);
+    // 广播消息在批次中连续出现，同一个上下文的引用合并为一次释放
+    ++run;
+    if (i + 1 == items.size() || items[i + 1].context != items[i].context) {
+      release_context(items[i].context, static_cast<int>(run));
+      run = 0;
+    }
+  }
+  for (auto &call : batch->calls)
+    call();
+  delete batch;
+}
+
+// 将跨线程消息交给本线程中的接收连接处理，不释放上下文的引用
+void EventLoop::deliver_cross_thread_msg(uint32_t conn_id,
+                                         CTContext *context) {
+  TcpConnection *connection = worker_->GetConnection(conn_id);
+  if (!connection || connection->closed()) {
+    JDOCS_LOG_DEBUG("[{}] conn_id: {} not online", worker_->GetName(),
+                    conn_id);
+    return;
+  }
+  // 调用对应的处理函数进行处理
+  connection->CrossThreadMsgHandle(context->message.data(),
+                                   context->message.size(), context->droppable);
+}
+
 // 提交取消请求，准备关闭连接
 int EventLoop::submit_cancel(int fd, uint32_t conn_id) {
   struct io_uring_sqe *sqe = GetSqe();
@@ -230,123 +716,325 @@ int EventLoop::submit_cancel(int fd, uint32_t conn_id) {
   return 0;
 }
 
-// 通过io_uring_prep_msg_ring_fd_alloc将连接的文件描述符传递给对应的ring实例
-// TODO: 是否需要close_direct？
+int EventLoop::prep_accept(int listen_fd) {
+  listen_fd_ = listen_fd;
+  struct io_uring_sqe *sqe = GetSqe();
+  io_uring_prep_multishot_accept_direct(sqe, listen_fd, NULL, NULL, 0);
+  user_data_encode(sqe, __ACCEPT, 0, listen_fd, 0);
+  return 0;
+}
+
+// master线程通过io_uring_prep_msg_ring_fd_alloc将连接的文件描述符传递给对应的ring实例
+// reuseport模式下worker线程接受的连接已位于本线程的直接文件描述符表中，直接建立连接
 int EventLoop::handle_accept(struct io_uring_cqe *cqe) {
+  // master线程暂停接受新连接后的定时检查，bid为1
+  if (!flag_ && cqe_to_bid(cqe)) {
+    resume_accept();
+    return 0;
+  }
   if (cqe->res < 0) {
+    // 平滑退出或暂停接受新连接时取消了accept请求
+    if (cqe->res == -ECANCELED)
+      return 0;
+    if (flag_ && cqe->res == -ENFILE) {
+      // 直接文件描述符表已满，稍后再重新提交accept请求
+      JDOCS_LOG_WARN("[{}] The direct descriptor table in the ring is full.",
+                     worker_->GetName());
+      if (!(cqe->flags & IORING_CQE_F_MORE)) {
+        accept_paused_ = true;
+        schedule_accept_retry();
+      }
+      return 0;
+    }
     spdlog::error("io_uring_prep_multishot_accept_direct failed. error: {}",
                   strerror(-cqe->res));
     return -1;
   }
+  metrics_add(METRIC_ACCEPTS);
   if (flag_) {
-    spdlog::error("Cannot Accept New Connection In Worker Thread.");
-    return -1;
+    JDOCS_LOG_DEBUG("[{}] New Connection Accepted, fd: {}", worker_->GetName(),
+                    cqe->res);
+    worker_->ReserveConnection();
+    add_connection(cqe->res);
+  } else {
+    JDOCS_LOG_DEBUG("[master] New Connection Accepted, fd: {}", cqe->res);
+    // 按分配策略将新连接分发给不同的worker线程
+    uint32_t worker = server_->DispatchConnection();
+    if (worker == kNoWorker) {
+      JDOCS_LOG_WARN("[master] all direct descriptor tables are full.");
+      metrics_add(METRIC_ACCEPT_DROPS);
+      prep_close(cqe->res, 0);
+    } else {
+      pass_connection(cqe->res, worker);
+    }
   }
-  spdlog::info("[master] New Connection Accepted, fd: {}", cqe->res);
-  // 通过轮询的方式将新连接分发给不同的worker线程
-  int ring_fd = server_->GetNextRingInstance()->ring_fd;
-  uint32_t conn_id = server_->GetNextConnectionId();
-  struct io_uring_sqe *sqe = GetSqe();
-  uint64_t user_data = context_encode(__FD_PASS, conn_id, 0, 0);
-  io_uring_prep_msg_ring_fd_alloc(sqe, ring_fd, cqe->res, user_data, 0);
-  user_data_encode(sqe, __NOP, conn_id, cqe->res, 0);
-  // 如果IORING_CQE_F_MORE标志未设置，则需要重新提交accept请求
-  if (!(cqe->flags & IORING_CQE_F_MORE)) {
-    sqe = GetSqe();
-    io_uring_prep_multishot_accept_direct(sqe, server_->GetListeningFd(), NULL,
-                                          NULL, 0);
-    user_data_encode(sqe, __ACCEPT, 0, server_->GetListeningFd(), 0);
+  // 所有连接表接近占满时暂停接受，新连接暂时留在内核的监听队列中
+  if (!accept_paused_ && accept_saturated(config_->accept_pause_watermark)) {
+    pause_accept();
+    return 0;
   }
+  // 如果IORING_CQE_F_MORE标志未设置，则需要重新提交accept请求
+  if (!(cqe->flags & IORING_CQE_F_MORE) && !accept_paused_)
+    prep_accept(cqe_to_fd(cqe));
   return 0;
 }
 
-// 接受主线程传递过来的直接文件描述符
+// 传递完成后master线程直接文件描述符表中的槽位不再需要，随传递请求一同关闭
+void EventLoop::pass_connection(int fd, uint32_t worker) {
+  struct io_uring_sqe *sqe = GetSqe();
+  uint64_t user_data = context_encode(__FD_PASS, 0, 0, 0);
+  io_uring_prep_msg_ring_fd_alloc(sqe, server_->GetWorkerRingFd(worker), fd,
+                                  user_data, 0);
+  sqe->flags |= IOSQE_IO_HARDLINK;
+  user_data_encode(sqe, __FD_PASS, worker, fd, 0);
+  sqe = GetSqe();
+  io_uring_prep_close_direct(sqe, static_cast<unsigned int>(fd));
+  sqe->flags |= IOSQE_CQE_SKIP_SUCCESS;
+  user_data_encode(sqe, __CLOSE, 0, fd, 0);
+}
+
+// worker线程接受master线程传递过来的直接文件描述符
+// master线程收到传递结果，目标线程的直接文件描述符表已满时不会收到任何完成事件
 int EventLoop::handle_fd_pass(struct io_uring_cqe *cqe) {
-  if (cqe->res < 0) {
-    if (cqe->res != -ENFILE) {
-      spdlog::error("io_uring_prep_msg_ring_fd_alloc failed. error: {}",
-                    strerror(-cqe->res));
-      return -1;
-    }
-    spdlog::warn("The direct descriptor table in the ring is full.");
+  if (!flag_) {
+    if (cqe->res >= 0)
+      return 0;
+    uint32_t worker = cqe_to_conn_id(cqe);
+    JDOCS_LOG_WARN("[master] pass fd to worker {} failed. error: {}", worker,
+                   strerror(-cqe->res));
+    // 连接已随master线程的槽位一同关闭，撤销分配时计入的连接数量
+    server_->CancelDispatch(worker);
+    metrics_add(METRIC_ACCEPT_DROPS);
     return 0;
   }
-  uint32_t conn_id = cqe_to_conn_id(cqe);
-  spdlog::info("[{}] Accepted a new fd: {}, conn_id: {}", worker_->GetName(),
-               cqe->res, conn_id);
-  std::shared_ptr<TcpConnection> connection =
-      std::make_shared<TcpConnection>(this, cqe->res, conn_id);
-  worker_->AddConnection(conn_id, connection);
-  AddTimer(connection->GetTimer(), kConnIdleTimeout);
-  // 开始发起接受请求
-  prep_recv(cqe->res, conn_id);
-  spdlog::info("[{}] current time: {}", worker_->GetName(),
-               get_current_millis());
+  if (cqe->res < 0) {
+    spdlog::error("io_uring_prep_msg_ring_fd_alloc failed. error: {}",
+                  strerror(-cqe->res));
+    return -1;
+  }
+  JDOCS_LOG_DEBUG("[{}] Accepted a new fd: {}", worker_->GetName(), cqe->res);
+  add_connection(cqe->res);
   return 0;
 }
 
+bool EventLoop::accept_saturated(uint32_t percent) {
+  if (!flag_)
+    return server_->WorkersAbove(percent);
+  uint64_t conns = static_cast<uint64_t>(
+      worker_->GetLoad()->connections.load(std::memory_order_relaxed));
+  return conns >= uint64_t(config_->fd_table_size) * percent / 100;
+}
+
+void EventLoop::pause_accept() {
+  JDOCS_LOG_WARN("[{}] direct descriptor tables nearly full, pause accepting",
+                 flag_ ? worker_->GetName() : std::string("master"));
+  metrics_add(METRIC_ACCEPT_PAUSES);
+  accept_paused_ = true;
+  struct io_uring_sqe *sqe = GetSqe();
+  io_uring_prep_cancel_fd(sqe, listen_fd_, IORING_ASYNC_CANCEL_ALL);
+  user_data_encode(sqe, __NOP, 0, 0, 0);
+  schedule_accept_retry();
+}
+
+// master线程没有时间轮，使用一次性的超时请求
+void EventLoop::schedule_accept_retry() {
+  if (flag_) {
+    AddTimer(&accept_timer_, kAcceptRetryDelay);
+    return;
+  }
+  accept_ts_.tv_sec = kAcceptRetryDelay / 1000;
+  accept_ts_.tv_nsec = (kAcceptRetryDelay % 1000) * 1000000L;
+  struct io_uring_sqe *sqe = GetSqe();
+  io_uring_prep_timeout(sqe, &accept_ts_, 0, 0);
+  user_data_encode(sqe, __ACCEPT, 0, listen_fd_, 1);
+}
+
+void EventLoop::resume_accept() {
+  if (draining_ || !accept_paused_)
+    return;
+  if (accept_saturated(config_->accept_resume_watermark)) {
+    schedule_accept_retry();
+    return;
+  }
+  accept_paused_ = false;
+  prep_accept(listen_fd_);
+}
+
+// 为本线程直接文件描述符表中的新连接建立连接对象，并开始接收数据
+TcpConnection *EventLoop::add_connection(int fd) {
+  // 平滑退出期间到达的连接直接关闭
+  if (draining_) {
+    worker_->GetLoad()->connections.fetch_sub(1, std::memory_order_relaxed);
+    prep_close(fd, 0);
+    return nullptr;
+  }
+  TcpConnection *connection = worker_->AddConnection(this, fd);
+  if (!connection) {
+    prep_close(fd, 0);
+    return nullptr;
+  }
+  AddTimer(connection->GetTimer(), GetIdleTimeout());
+  // 开始发起接受请求
+  prep_recv(fd, connection->conn_id(), connection->recv_group());
+  JDOCS_LOG_DEBUG("[{}] current time: {}", worker_->GetName(),
+                  get_current_millis());
+  return connection;
+}
+
 int EventLoop::handle_recv(struct io_uring_cqe *cqe) {
+  uint8_t group = static_cast<uint8_t>(cqe_to_bid(cqe));
   if (cqe->res < 0) {
+    TcpConnection *connection = worker_->GetConnection(cqe_to_conn_id(cqe));
     if (cqe->res == -ENOBUFS) {
-      spdlog::info("[{}] no avaliable buffers", worker_->GetName());
-      // 需要对缓冲池进行扩容，并重新提交接受数据请求
-      buffer_pool_->alloc_recv_buffers();
-      prep_recv(cqe_to_fd(cqe), cqe_to_conn_id(cqe));
-    } else if (cqe->res != -ECANCELED) {
+      JDOCS_LOG_DEBUG("[{}] no avaliable buffers, group: {}",
+                      worker_->GetName(), group);
+      metrics_add(METRIC_RECV_ENOBUFS);
+      // 需要对缓冲组进行扩容，并重新提交接受数据请求
+      buffer_pool_->alloc_recv_buffers(group);
+      // 已关闭的连接不再接收数据，正在移交的连接由移交结果决定是否重新提交，
+      // 暂停接收的连接由发送队列回落后重新提交
+      if (connection && !connection->closed() && !connection->handing_off() &&
+          !connection->recv_paused())
+        prep_recv(cqe_to_fd(cqe), cqe_to_conn_id(cqe),
+                  connection->recv_group());
+    } else if (cqe->res == -ECANCELED) {
+      // 切换缓冲组时取消的接收请求，以新的缓冲组重新提交
+      if (connection && !connection->closed() &&
+          !connection->handing_off() && !connection->recv_paused() &&
+          group != connection->recv_group())
+        prep_recv(cqe_to_fd(cqe), cqe_to_conn_id(cqe),
+                  connection->recv_group());
+    } else {
       spdlog::error("recv multishot failed. error: {}", strerror(-cqe->res));
       return -1;
     }
     return 0;
   }
-  std::shared_ptr<TcpConnection> connection =
-      worker_->GetConnection(cqe_to_conn_id(cqe));
+  TcpConnection *connection = worker_->GetConnection(cqe_to_conn_id(cqe));
   int fd = cqe_to_fd(cqe);
+  if (!connection) {
+    // 连接已关闭，槽位被回收后的过期完成事件
+    JDOCS_LOG_DEBUG("[{}] stale recv, conn_id: {}", worker_->GetName(),
+                    cqe_to_conn_id(cqe));
+    if (cqe->flags & IORING_CQE_F_BUFFER) {
+      buffer_pool_->TakeRecvSegments(group,
+                                     cqe->flags >> IORING_CQE_BUFFER_SHIFT,
+                                     static_cast<uint32_t>(cqe->res),
+                                     cqe->flags & IORING_CQE_F_BUF_MORE);
+      buffer_pool_->ReleaseRecvSegments();
+    }
+    return 0;
+  }
   if (!(cqe->flags & IORING_CQE_F_BUFFER)) {
     // 说明客户端关闭连接
     connection->close();
     return 0;
   }
   uint16_t bid = cqe->flags >> IORING_CQE_BUFFER_SHIFT;
-  void *recv_buf = buffer_pool_->GetRecvBuffer(bid);
-  if (!recv_buf) {
-    spdlog::error("[{}] No selected buffer.", worker_->GetName());
-    return -1;
-  }
-  spdlog::info("[{}] receive {} bytes from fd: {}, bid: {}", worker_->GetName(),
-               cqe->res, fd, bid);
+  // bundle模式下数据可能分布在多个缓冲区中，按顺序逐段交给连接处理
+  const auto &segments = buffer_pool_->TakeRecvSegments(
+      group, bid, static_cast<uint32_t>(cqe->res),
+      cqe->flags & IORING_CQE_F_BUF_MORE);
+  metrics_add(METRIC_RECV_COMPLETIONS);
+  JDOCS_LOG_DEBUG("[{}] receive {} bytes from fd: {}, group: {}, bid: {}, "
+                  "buffers: {}",
+                  worker_->GetName(), cqe->res, fd, group, bid,
+                  segments.size());
   // 对该连接对象进行业务处理
   if (!connection->closed()) {
-    spdlog::info("[{}] call receive handle.", worker_->GetName());
-    connection->RecvHandle(recv_buf, static_cast<size_t>(cqe->res));
-    // 更新连接超时定时器
-    AddTimer(connection->GetTimer(), kConnIdleTimeout);
+    JDOCS_LOG_DEBUG("[{}] call receive handle.", worker_->GetName());
+    for (const auto &segment : segments) {
+      if (connection->closed())
+        break;
+      connection->RecvHandle(segment.data, segment.len);
+    }
+    // 更新连接超时定时器，延迟模式下只记录活动时间，由定时器触发时检查
+    // 定时器已触发过时（例如websocket连接已发送ping）仍需重新添加
+    if (!config_->idle_lazy || connection->GetTimer()->IsFired())
+      AddTimer(connection->GetTimer(), GetIdleTimeout());
+    else
+      connection->Touch(now_millis_);
     if (!(cqe->flags & IORING_CQE_F_MORE)) {
-      prep_recv(fd, cqe_to_conn_id(cqe));
+      if (!connection->closed() && !connection->handing_off() &&
+          !connection->recv_paused())
+        prep_recv(fd, cqe_to_conn_id(cqe), connection->recv_group());
+    } else if (!connection->closed() && !connection->handing_off() &&
+               group == connection->recv_group()) {
+      // 切换缓冲组后旧请求中剩余的完成事件不参与统计
+      update_recv_group(connection, static_cast<uint32_t>(cqe->res), group);
     }
   }
-  // 处理完毕后需要将接收缓冲区放回缓存池中
-  buffer_pool_->ReplenishRecvBuffer(recv_buf, bid);
+  // 处理完毕后需要将已用完的接收缓冲区放回缓存池中
+  buffer_pool_->ReleaseRecvSegments();
   return 0;
 }
 
+void EventLoop::update_recv_group(TcpConnection *connection, uint32_t len,
+                                  uint8_t group) {
+  // 数据填满了缓冲区时消息可能被截断，按更大的数据量估计
+  if (len >= buffer_pool_->GetRecvBufferSize(group))
+    len = len > UINT32_MAX / 2 ? UINT32_MAX : len * 2;
+  uint32_t estimate = connection->RecordRecvSize(len);
+  // 切换后需要积累足够的样本才能再次切换，避免在两个缓冲组之间来回切换
+  if (connection->recv_samples() < kRecvGroupSamples)
+    return;
+  uint8_t target = buffer_pool_->PickRecvGroup(estimate);
+  if (target == group)
+    return;
+  JDOCS_LOG_DEBUG("[{}] conn_id: {} recv group {} -> {}, estimate: {}",
+                  worker_->GetName(), connection->conn_id(), group, target,
+                  estimate);
+  connection->set_recv_group(target);
+  metrics_add(METRIC_RECV_GROUP_SWITCHES);
+  cancel_recv(connection->fd(), connection->conn_id(), group);
+}
+
+void EventLoop::cancel_recv(int fd, uint32_t conn_id, uint8_t group) {
+  struct io_uring_sqe *sqe = GetSqe();
+  io_uring_prep_cancel64(sqe, context_encode(__RECV, conn_id, fd, group), 0);
+  sqe->flags |= IOSQE_CQE_SKIP_SUCCESS;
+  user_data_encode(sqe, __NOP, conn_id, fd, 0);
+}
+
 int EventLoop::handle_send(struct io_uring_cqe *cqe) {
+  // 发送队列的请求，包括失败在内都由连接自行处理
+  if (cqe_to_bid(cqe) == kSendQueued) {
+    TcpConnection *connection = worker_->GetConnection(cqe_to_conn_id(cqe));
+    if (connection) {
+      connection->SendQueueHandle(cqe->res, false);
+      release_deferred(connection);
+    }
+    return 0;
+  }
   if (cqe->res < 0) {
     if (cqe->res == -ECANCELED)
       return 0;
     spdlog::error("send operation failed. error: {}", strerror(-cqe->res));
     return -1;
   }
-  int fd = cqe_to_fd(cqe);
-  std::shared_ptr<TcpConnection> connection =
-      worker_->GetConnection(cqe_to_conn_id(cqe));
-  if (!connection->closed())
+  TcpConnection *connection = worker_->GetConnection(cqe_to_conn_id(cqe));
+  if (connection && !connection->closed())
     connection->SendHandle(static_cast<size_t>(cqe->res));
-  spdlog::info("[{}] send {} bytes to fd: {}", worker_->GetName(), cqe->res,
-               fd);
+  JDOCS_LOG_DEBUG("[{}] send {} bytes to fd: {}", worker_->GetName(), cqe->res,
+                  cqe_to_fd(cqe));
   return 0;
 }
 
 int EventLoop::handle_send_zc(struct io_uring_cqe *cqe) {
+  // 发送队列的请求，先产生发送结果，之后的通知事件表示数据可以修改
+  if (cqe_to_bid(cqe) == kSendZcQueued) {
+    TcpConnection *connection = worker_->GetConnection(cqe_to_conn_id(cqe));
+    if (!connection)
+      return 0;
+    if (cqe->flags & IORING_CQE_F_NOTIF) {
+      connection->SendQueueNotify();
+    } else {
+      // 没有IORING_CQE_F_MORE标志时不会再有通知事件
+      connection->SendQueueHandle(cqe->res, cqe->flags & IORING_CQE_F_MORE);
+    }
+    release_deferred(connection);
+    return 0;
+  }
   if (cqe->res < 0 && !(cqe->flags & IORING_CQE_F_NOTIF)) {
     if (cqe->res == -ECANCELED)
       return 0;
@@ -354,26 +1042,24 @@ int EventLoop::handle_send_zc(struct io_uring_cqe *cqe) {
                   strerror(-cqe->res));
     return -1;
   }
-  int fd = cqe_to_fd(cqe);
   uint16_t bidx = cqe_to_bid(cqe);
   // 此时可以复用该发送缓冲区
   if (cqe->flags & IORING_CQE_F_NOTIF) {
-    spdlog::info("[{}] send buffer recycle, buffer_index: {}",
-                 worker_->GetName(), bidx);
+    JDOCS_LOG_DEBUG("[{}] send buffer recycle, buffer_index: {}",
+                    worker_->GetName(), bidx);
     buffer_pool_->ReplenishSendBuffer(bidx);
   } else {
-    std::shared_ptr<TcpConnection> connection =
-        worker_->GetConnection(cqe_to_conn_id(cqe));
-    void *buffer_addr = buffer_pool_->GetRecvBuffer(bidx);
+    TcpConnection *connection = worker_->GetConnection(cqe_to_conn_id(cqe));
+    void *buffer_addr = buffer_pool_->GetSendBuffer(bidx);
     if (buffer_addr == NULL) {
       spdlog::error("[{}] invalid buffer, buffer_index: {}", worker_->GetName(),
                     bidx);
       return -1;
     }
-    if (!connection->closed())
+    if (connection && !connection->closed())
       connection->SendHandle(static_cast<size_t>(cqe->res));
-    spdlog::info("[{}] send {} bytes to fd: {}", worker_->GetName(), cqe->res,
-                 fd);
+    JDOCS_LOG_DEBUG("[{}] send {} bytes to fd: {}", worker_->GetName(),
+                    cqe->res, cqe_to_fd(cqe));
   }
   return 0;
 }
@@ -397,70 +1083,168 @@ int EventLoop::handle_close(struct io_uring_cqe *cqe) {
     return -1;
   }
   if (!flag_) {
-    spdlog::info("[master] connection closed, fd: {}", cqe_to_fd(cqe));
+    JDOCS_LOG_DEBUG("[master] connection closed, fd: {}", cqe_to_fd(cqe));
+    return 0;
+  }
+  JDOCS_LOG_DEBUG("[{}] connection closed, fd: {}, conn_id: {}",
+                  worker_->GetName(), cqe_to_fd(cqe), cqe_to_conn_id(cqe));
+  // 发送请求的完成事件与零拷贝发送的通知可能晚于关闭完成，
+  // 此前发送队列的内存仍被内核引用，连接延迟到最后一个完成事件时再销毁
+  TcpConnection *connection = worker_->GetConnection(cqe_to_conn_id(cqe));
+  if (connection && connection->send_pending()) {
+    connection->set_release_deferred();
     return 0;
   }
-  spdlog::info("[{}] connection closed, fd: {}, conn_id: {}",
-               worker_->GetName(), cqe_to_fd(cqe), cqe_to_conn_id(cqe));
   worker_->DelConnection(cqe_to_conn_id(cqe));
   return 0;
 }
 
+void EventLoop::release_deferred(TcpConnection *connection) {
+  if (connection->release_deferred() && !connection->send_pending())
+    worker_->DelConnection(connection->conn_id());
+}
+
 // 当取消操作完成后，需要对连接进行关闭操作
 int EventLoop::handle_cancel(struct io_uring_cqe *cqe) {
-  spdlog::info("[{}] got cancel fd: {}", worker_->GetName(), cqe_to_fd(cqe));
+  JDOCS_LOG_DEBUG("[{}] got cancel fd: {}", worker_->GetName(), cqe_to_fd(cqe));
   prep_close(cqe_to_fd(cqe), cqe_to_conn_id(cqe));
   return 0;
 }
 
-// 处理跨线程消息
+// 处理跨线程消息门铃
 int EventLoop::handle_cross_thread_msg(struct io_uring_cqe *cqe) {
-  // 通过获取cqe->res中存放的高32位地址和user_data中低32位地址
-  // 得到实际的跨线程上下文对象地址
-  uint32_t low_addr = cqe_to_addr(cqe);
-  uint32_t high_addr = static_cast<uint32_t>(cqe->res);
-  CTContext *context = get_ctcontext(high_addr, low_addr);
-  if (!context) {
-    spdlog::error("[{}] got a null cross thread message", worker_->GetName());
-    return 0;
-  }
-  spdlog::info("[{}] got a cross thread message, sender conn_id: {}",
-               worker_->GetName(), context->snd_conn_id);
-  std::shared_ptr<TcpConnection> connection =
-      worker_->GetConnection(cqe_to_conn_id(cqe));
-  if (!connection || connection->closed()) {
-    spdlog::info("[{}] conn_id: {} not online", worker_->GetName(),
-                 cqe_to_conn_id(cqe));
-    release_context(context);
+  // 本线程发出的门铃发送失败，重新发送
+  if (cqe->res < 0) {
+    spdlog::warn("[{}] doorbell to worker-{} failed. error msg: {}",
+                 worker_->GetName(), cqe_to_conn_id(cqe), strerror(-cqe->res));
+    send_doorbell(cqe_to_conn_id(cqe));
     return 0;
   }
-  // 调用对应的处理函数进行处理
-  connection->CrossThreadMsgHandle(context->message.data(),
-                                   context->message.size());
-  release_context(context);
+  JDOCS_LOG_DEBUG("[{}] got a doorbell from worker-{}", worker_->GetName(),
+                  cqe_to_conn_id(cqe));
+  mailbox_->Drain(
+      [this](CTBatch *batch) { deliver_cross_thread_batch(batch); });
   return 0;
 }
 
-// 准备下一次超时
-void EventLoop::__prep_timeout(timespec *ts) {
+void EventLoop::prep_tick_timeout() {
   io_uring_sqe *sqe = GetSqe();
-  // 使用绝对时间
-  io_uring_prep_timeout(sqe, (struct __kernel_timespec *)ts, 0,
-                        IORING_TIMEOUT_ABS);
+  if (tick_multishot_) {
+    timer_ts_.tv_sec = config_->timer_tick / 1000;
+    timer_ts_.tv_nsec = (config_->timer_tick % 1000) * 1000000L;
+    io_uring_prep_timeout(sqe, &timer_ts_, 0, IORING_TIMEOUT_MULTISHOT);
+  } else {
+    // 使用下一个刻度的绝对时间，避免处理延迟累积
+    timespec ts;
+    time_wheel_->TickToTimespec(time_wheel_->GetCurrentTick() + 1, &ts);
+    timer_ts_.tv_sec = ts.tv_sec;
+    timer_ts_.tv_nsec = ts.tv_nsec;
+    io_uring_prep_timeout(sqe, &timer_ts_, 0, IORING_TIMEOUT_ABS);
+  }
   user_data_encode(sqe, __TIMEOUT, 0, 0, 0);
 }
 
+void EventLoop::prep_abs_timeout(struct __kernel_timespec *ts, bool update,
+                                 uint16_t bid) {
+  io_uring_sqe *sqe = GetSqe();
+  if (!update) {
+    io_uring_prep_timeout(sqe, ts, 0, IORING_TIMEOUT_ABS);
+    user_data_encode(sqe, __TIMEOUT, 0, 0, bid);
+    return;
+  }
+  // 修改已提交的超时请求，成功时不产生完成事件
+  io_uring_prep_timeout_update(sqe, ts, context_encode(__TIMEOUT, 0, 0, bid),
+                               IORING_TIMEOUT_ABS);
+  user_data_encode(sqe, __TIMEOUT, 0, 0, bid + 1);
+  sqe->flags |= IOSQE_CQE_SKIP_SUCCESS;
+}
+
+void EventLoop::arm_timer() {
+  timer_rearm_ = false;
+  // 超时只会被提前，计时器取消后多出的一次唤醒在处理超时时重新计算
+  uint64_t next = time_wheel_->NextExpiry();
+  if (next < armed_tick_) {
+    timespec ts;
+    time_wheel_->TickToTimespec(next, &ts);
+    timer_ts_.tv_sec = ts.tv_sec;
+    timer_ts_.tv_nsec = ts.tv_nsec;
+    prep_abs_timeout(&timer_ts_, armed_tick_ != UINT64_MAX, kTimeoutWheel);
+    armed_tick_ = next;
+  }
+  uint64_t deadline = timer_heap_.NextDeadline();
+  if (deadline < precise_armed_) {
+    precise_ts_.tv_sec = static_cast<int64_t>(deadline / 1000000000);
+    precise_ts_.tv_nsec = static_cast<long long>(deadline % 1000000000);
+    prep_abs_timeout(&precise_ts_, precise_armed_ != UINT64_MAX,
+                     kTimeoutPrecise);
+    precise_armed_ = deadline;
+  }
+}
+
+void EventLoop::AddPreciseTimer(TimerHeap::timer_node *timer,
+                                uint32_t micros) {
+  timer_heap_.Add(timer, get_current_nanos() + uint64_t(micros) * 1000);
+  if (timer->deadline_ < precise_armed_)
+    timer_rearm_ = true;
+}
+
+// 设置一个kMailboxRetryMicros后触发的超时，以便重试投递目标邮箱已满的批次
+void EventLoop::prep_mailbox_retry() {
+  struct io_uring_sqe *sqe = GetSqe();
+  ct_retry_ts_.tv_sec = 0;
+  ct_retry_ts_.tv_nsec = kMailboxRetryMicros * 1000L;
+  io_uring_prep_timeout(sqe, &ct_retry_ts_, 0, 0);
+  user_data_encode(sqe, __TIMEOUT, 0, 0, kTimeoutMailboxRetry);
+  ct_retry_armed_ = true;
+}
+
 // 定时器事件处理函数，处理当前超时的事件
 int EventLoop::handle_timeout(struct io_uring_cqe *cqe) {
+  uint16_t bid = cqe_to_bid(cqe);
+  // 本轮事件循环开始时会重新投递，仍未成功时再次设置超时
+  if (bid == kTimeoutMailboxRetry) {
+    ct_retry_armed_ = false;
+    return 0;
+  }
+  // 修改超时请求失败，原超时请求已经触发，其完成事件中会重新设置
+  if (bid == kTimeoutWheelUpdate || bid == kTimeoutPreciseUpdate) {
+    if (cqe->res != -ENOENT && cqe->res != -EALREADY)
+      spdlog::warn("[{}] timeout update failed. error: {}", worker_->GetName(),
+                   strerror(-cqe->res));
+    return 0;
+  }
+  if (bid == kTimeoutPrecise) {
+    if (cqe->res != -ETIME) {
+      spdlog::error("precise timeout failed. error: {}", strerror(-cqe->res));
+      return -1;
+    }
+    metrics_add(METRIC_TIMER_WAKEUPS);
+    precise_armed_ = UINT64_MAX;
+    timer_heap_.Run(get_current_nanos());
+    arm_timer();
+    return 0;
+  }
+  if (cqe->res == -EINVAL && tick_multishot_ && !config_->timer_tickless) {
+    spdlog::warn("[{}] multishot timeout unsupported, falling back",
+                 worker_->GetName());
+    tick_multishot_ = false;
+    prep_tick_timeout();
+    return 0;
+  }
   if (cqe->res != -ETIME) {
     spdlog::error("io_uring_prep_timeout failed. error: {}",
                   strerror(-cqe->res));
     return -1;
   }
-  // spdlog::info("[{}][tick]: {}", worker_->GetName(), get_current_millis());
+  metrics_add(METRIC_TIMER_WAKEUPS);
   // 开始处理超时事件，处理超时任务
   time_wheel_->Update();
-  __prep_timeout(time_wheel_->GetNextTimeout());
+  if (config_->timer_tickless) {
+    armed_tick_ = UINT64_MAX;
+    arm_timer();
+  } else if (!tick_multishot_ || !(cqe->flags & IORING_CQE_F_MORE)) {
+    prep_tick_timeout();
+  }
   return 0;
 }
 
@@ -474,4 +1258,302 @@ int EventLoop::get_send_buffer(void **buffer_ptr) {
   return bidx;
 }
 
+int EventLoop::prep_signal(int signal_fd) {
+  signal_fd_ = signal_fd;
+  struct io_uring_sqe *sqe = GetSqe();
+  io_uring_prep_read(sqe, signal_fd, &siginfo_, sizeof(siginfo_), 0);
+  user_data_encode(sqe, __SIGNAL, 0, 0, 0);
+  return 0;
+}
+
+// master线程收到退出信号，停止接受新连接并通知所有worker线程平滑退出
+// 再次收到退出信号时，通知worker线程立即关闭所有连接
+int EventLoop::handle_signal(struct io_uring_cqe *cqe) {
+  if (cqe->res < 0) {
+    if (cqe->res == -EINTR || cqe->res == -EAGAIN) {
+      prep_signal(signal_fd_);
+      return 0;
+    }
+    spdlog::error("read signalfd failed. error: {}", strerror(-cqe->res));
+    return -1;
+  }
+  bool force = draining_;
+  spdlog::info("[master] got signal {}, {}", siginfo_.ssi_signo,
+               force ? "closing all connections" : "draining");
+  drain_workers(force ? kDrainForce : 0);
+  prep_signal(signal_fd_);
+  return 0;
+}
+
+// 停止接受新连接，并通过完成事件的res将退出标志告知所有worker线程
+void EventLoop::drain_workers(int flags) {
+  if (!draining_) {
+    draining_ = true;
+    if (config_->accept_mode == kAcceptModeMaster) {
+      struct io_uring_sqe *sqe = GetSqe();
+      io_uring_prep_cancel_fd(sqe, listen_fd_, IORING_ASYNC_CANCEL_ALL);
+      user_data_encode(sqe, __NOP, 0, 0, 0);
+    }
+  }
+  for (uint32_t i = 0; i != server_->GetWorkerCount(); ++i) {
+    struct io_uring_sqe *sqe = GetSqe();
+    io_uring_prep_msg_ring(sqe, server_->GetWorkerRingFd(i), flags,
+                           context_encode(__DRAIN, 0, 0, 0), 0);
+    user_data_encode(sqe, __NOP, 0, 0, 0);
+  }
+}
+
+// worker线程收到master线程的退出通知，master线程收到worker线程的退出完成通知
+int EventLoop::handle_drain(struct io_uring_cqe *cqe) {
+  if (flag_) {
+    start_drain(cqe->res);
+    return 0;
+  }
+  spdlog::info("[master] worker-{} drained", cqe_to_conn_id(cqe));
+  // 所有worker线程均已退出，结束master线程的事件循环
+  if (++drained_workers_ == server_->GetWorkerCount())
+    running_ = false;
+  return 0;
+}
+
+void EventLoop::start_drain(int flags) {
+  uint64_t now = get_current_millis();
+  if (!draining_) {
+    draining_ = true;
+    drain_start_ = now;
+    drain_deadline_ = now + config_->drain_timeout;
+    if (flags & kDrainHandoff)
+      start_handoff();
+    // 移交给新进程的连接无需通知关闭
+    drain_total_ = worker_->GetConnectionTable()->size() - handoff_pending_;
+    spdlog::info("[{}] draining {} connections", worker_->GetName(),
+                 drain_total_);
+    // reuseport模式下停止接受新连接
+    if (config_->accept_mode == kAcceptModeReuseport) {
+      TimeWheel::timer_cancel(&accept_timer_);
+      struct io_uring_sqe *sqe = GetSqe();
+      io_uring_prep_cancel_fd(sqe, listen_fd_, IORING_ASYNC_CANCEL_ALL);
+      user_data_encode(sqe, __NOP, 0, 0, 0);
+    }
+  }
+  if (flags & kDrainForce)
+    drain_deadline_ = now;
+  TimeWheel::timer_cancel(&drain_timer_);
+  drain_step();
+}
+
+void EventLoop::drain_step() {
+  Slab<TcpConnection> *table = worker_->GetConnectionTable();
+  uint64_t now = get_current_millis();
+  if (now >= drain_deadline_) {
+    // 已超过期限，关闭所有剩余连接
+    for (uint32_t i = 0; i != table->capacity(); ++i) {
+      TcpConnection *connection = table->At(i);
+      if (connection)
+        connection->close();
+    }
+  } else {
+    // 按已经过的时间占比分批发送关闭通知，使客户端分散重连
+    uint64_t elapsed = now - drain_start_;
+    uint64_t target = drain_total_;
+    if (elapsed < config_->drain_pace)
+      target = (drain_total_ * elapsed + config_->drain_pace - 1) /
+               config_->drain_pace;
+    while (drain_notified_ < target && drain_cursor_ != table->capacity()) {
+      TcpConnection *connection = table->At(drain_cursor_++);
+      if (!connection || connection->handing_off())
+        continue;
+      connection->shutdown();
+      ++drain_notified_;
+    }
+  }
+  // 所有连接均已关闭，或强制关闭后等待超时
+  // 计算线程池中的任务与内核仍持有的发送数据需另外等待，
+  // 否则任务完成后会投递到已退出的事件循环，内核也可能读取已释放的内存
+  bool exiting =
+      (table->size() == 0 || now >= drain_deadline_ + kDrainForceGrace) &&
+      !drain_pending();
+  if (!exiting && now >= drain_deadline_ + kDrainForceGrace + kDrainLeakGrace) {
+    // 最终期限已过，记录仍未归还的资源，连接表与缓冲池在退出时不再释放
+    spdlog::warn("[{}] drain timed out, offloads: {}, send buffers: {}, "
+                 "sending connections: {}",
+                 worker_->GetName(), offloads_inflight_,
+                 buffer_pool_->GetSendBuffersInUse(),
+                 pending_send_connections());
+    drain_leaked_ = true;
+    exiting = true;
+  }
+  if (exiting) {
+    spdlog::info("[{}] drained, {} connections left", worker_->GetName(),
+                 table->size());
+    // 之后其他线程不再向本线程投递消息，已投递的消息直接释放
+    mailbox_->Close();
+    mailbox_->Drain([this](CTBatch *batch) { reject_batch(batch); });
+    struct io_uring_sqe *sqe = GetSqe();
+    io_uring_prep_msg_ring(sqe, server_->GetMasterRingFd(), 0,
+                           context_encode(__DRAIN, worker_->GetIndex(), 0, 0),
+                           0);
+    user_data_encode(sqe, __NOP, 0, 0, 0);
+    io_uring_submit(&ring_);
+    running_ = false;
+    return;
+  }
+  AddTimer(&drain_timer_, config_->timer_tick);
+}
+
+bool EventLoop::drain_pending() {
+  return offloads_inflight_ || buffer_pool_->GetSendBuffersInUse() ||
+         pending_send_connections();
+}
+
+// 已关闭但仍在等待发送完成或零拷贝通知的连接也计算在内
+uint32_t EventLoop::pending_send_connections() {
+  Slab<TcpConnection> *table = worker_->GetConnectionTable();
+  uint32_t count = 0;
+  for (uint32_t i = 0; i != table->capacity(); ++i) {
+    TcpConnection *connection = table->At(i);
+    if (connection && connection->send_pending())
+      ++count;
+  }
+  return count;
+}
+
+int EventLoop::prep_upgrade_accept(int upgrade_fd) {
+  upgrade_fd_ = upgrade_fd;
+  struct io_uring_sqe *sqe = GetSqe();
+  io_uring_prep_accept(sqe, upgrade_fd, NULL, NULL, SOCK_CLOEXEC);
+  user_data_encode(sqe, __UPGRADE, 0, 0, 0);
+  return 0;
+}
+
+// master线程接受新进程的热升级连接，或收到worker线程移交连接完成的通知
+// worker线程收到连接的普通文件描述符，将其连同连接状态发送给新进程
+int EventLoop::handle_upgrade(struct io_uring_cqe *cqe) {
+  if (flag_)
+    return handle_handoff(cqe);
+  // 通知的bid为1
+  if (cqe_to_bid(cqe)) {
+    if (++handoff_workers_ == server_->GetWorkerCount())
+      server_->FinishUpgrade();
+    return 0;
+  }
+  if (cqe->res < 0) {
+    if (cqe->res == -ECANCELED)
+      return 0;
+    spdlog::error("accept upgrade connection failed. error: {}",
+                  strerror(-cqe->res));
+    prep_upgrade_accept(upgrade_fd_);
+    return 0;
+  }
+  if (draining_) {
+    close(cqe->res);
+    return 0;
+  }
+  int ret = server_->StartUpgrade(cqe->res);
+  if (ret < 0) {
+    prep_upgrade_accept(upgrade_fd_);
+    return 0;
+  }
+  spdlog::info("[master] upgrading, {}",
+               ret ? "handing off idle connections" : "draining connections");
+  drain_workers(ret ? kDrainHandoff : 0);
+  return 0;
+}
+
+// 取消连接的接收请求后，将其直接文件描述符转换为普通文件描述符
+// 取消前已接收的数据仍由本进程处理，转换完成后连接仍空闲才会移交
+void EventLoop::start_handoff() {
+  Slab<TcpConnection> *table = worker_->GetConnectionTable();
+  for (uint32_t i = 0; i != table->capacity(); ++i) {
+    TcpConnection *connection = table->At(i);
+    if (!connection || !connection->handoff_ready())
+      continue;
+    connection->set_handing_off(true);
+    int fd = connection->fd();
+    uint32_t conn_id = connection->conn_id();
+    struct io_uring_sqe *sqe = GetSqe();
+    io_uring_prep_cancel64(
+        sqe, context_encode(__RECV, conn_id, fd, connection->recv_group()), 0);
+    // 接收请求可能已经结束，取消失败时也需要继续转换
+    sqe->flags |= IOSQE_IO_HARDLINK | IOSQE_CQE_SKIP_SUCCESS;
+    user_data_encode(sqe, __NOP, conn_id, fd, 0);
+    sqe = GetSqe();
+    io_uring_prep_fixed_fd_install(sqe, fd, 0);
+    user_data_encode(sqe, __UPGRADE, conn_id, fd, 0);
+    ++handoff_pending_;
+  }
+  spdlog::info("[{}] handing off {} connections", worker_->GetName(),
+               handoff_pending_);
+  if (handoff_pending_ == 0)
+    report_handoff();
+}
+
+int EventLoop::handle_handoff(struct io_uring_cqe *cqe) {
+  uint32_t conn_id = cqe_to_conn_id(cqe);
+  int fd = cqe_to_fd(cqe);
+  TcpConnection *connection = worker_->GetConnection(conn_id);
+  if (cqe->res < 0)
+    spdlog::warn("[{}] install fd: {} failed. error: {}", worker_->GetName(),
+                 fd, strerror(-cqe->res));
+  if (connection && cqe->res >= 0 && connection->handoff_ready() &&
+      !upgrade_send(server_->GetUpgradeFd(), kUpgradeConn,
+                    connection->save_state(), &cqe->res, 1)) {
+    close(cqe->res);
+    connection->detach();
+    metrics_add(METRIC_HANDOFFS);
+    // 连接已由新进程持有，只移除直接文件描述符，不能关闭连接本身
+    struct io_uring_sqe *sqe = GetSqe();
+    io_uring_prep_close_direct(sqe, static_cast<unsigned int>(fd));
+    user_data_encode(sqe, __CLOSE, conn_id, fd, 0);
+  } else {
+    if (cqe->res >= 0)
+      close(cqe->res);
+    // 移交失败，恢复接收数据并按平滑退出的方式关闭
+    if (connection) {
+      connection->set_handing_off(false);
+      if (!connection->closed()) {
+        prep_recv(fd, conn_id, connection->recv_group());
+        connection->shutdown();
+      }
+    }
+  }
+  if (--handoff_pending_ == 0)
+    report_handoff();
+  return 0;
+}
+
+void EventLoop::report_handoff() {
+  struct io_uring_sqe *sqe = GetSqe();
+  io_uring_prep_msg_ring(sqe, server_->GetMasterRingFd(), 0,
+                         context_encode(__UPGRADE, worker_->GetIndex(), 0, 1),
+                         0);
+  user_data_encode(sqe, __NOP, 0, 0, 0);
+}
+
+// 新进程的worker线程在事件循环开始之前恢复移交过来的连接
+void EventLoop::restore_connections(std::vector<upgrade_conn> conns) {
+  uint32_t slot = 0;
+  for (auto &conn : conns) {
+    // 直接文件描述符表已满，无法恢复的连接直接关闭
+    if (slot == config_->fd_table_size) {
+      close(conn.fd);
+      continue;
+    }
+    int ret = io_uring_register_files_update(&ring_, slot, &conn.fd, 1);
+    close(conn.fd);
+    if (ret != 1) {
+      spdlog::error("[{}] register restored fd failed. error: {}",
+                    worker_->GetName(), strerror(-ret));
+      continue;
+    }
+    worker_->ReserveConnection();
+    TcpConnection *connection = add_connection(static_cast<int>(slot++));
+    // 无法恢复会话时通知客户端重新连接
+    if (connection && !connection->restore_state(conn.state))
+      connection->shutdown();
+  }
+  if (slot)
+    spdlog::info("[{}] restored {} connections", worker_->GetName(), slot);
+}
+
 } // namespace jdocs
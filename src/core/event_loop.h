@@ -3,32 +3,28 @@
 #ifndef JDOCS_CORE_EVENT_LOOP_H_
 #define JDOCS_CORE_EVENT_LOOP_H_
 
+#include <coroutine>
+#include <exception>
+#include <functional>
 #include <memory>
+#include <vector>
 
 #include <liburing.h>
+#include <sys/signalfd.h>
 
 #include "buffer.h"
+#include "config.h"
 #include "context.h"
+#include "coro.h"
+#include "mailbox.h"
 #include "timer.h"
+#include "upgrade.h"
 
 namespace jdocs {
 
-// 一些常量的定义，只能在该文件内所使用
-namespace {
-// io_uring实例队列最大条目数量
-constexpr uint32_t kQueueDepth = 2048;
-// io_uring实例注册的文件描述符表大小
-constexpr uint32_t kFdTableSize = 2048;
-// io_uring轮询线程闲置超时时间，ms为单位
-// constexpr static uint32_t kThreadIdleTime = 2000;
-
-// 闲置连接超时关闭时间，默认60s
-constexpr uint32_t kConnIdleTimeout = 60000;
-
-} // namespace
-
 class Worker;
 class JdocsServer;
+class TcpConnection;
 
 // 事件循环类，每个线程都维护着一个事件循环实例
 class EventLoop {
@@ -44,10 +40,28 @@ public:
 
   inline struct io_uring *GetRingInstance() { return &ring_; }
 
+  inline const ServerConfig &GetConfig() const { return *config_; }
+
+  // 获取单个发送缓冲区的大小
+  inline uint32_t GetBufferSize() const { return config_->buffer_size; }
+
+  // 闲置连接超时关闭时间
+  inline uint32_t GetIdleTimeout() const { return config_->conn_idle_timeout; }
+
+  // 本轮事件循环被唤醒时的单调时钟时间，单位毫秒
+  inline uint64_t NowMillis() const { return now_millis_; }
+
   // 开始事件循环处理已完成事件
   int Run();
 
-  int prep_recv(int fd, uint32_t conn_id);
+  // 在监听套接字上提交multishot accept请求，新连接直接放入直接文件描述符表中
+  int prep_accept(int listen_fd);
+
+  // 在连接上提交multishot recv请求，group为使用的接收缓冲组，同时记录在user_data中
+  int prep_recv(int fd, uint32_t conn_id, uint8_t group);
+
+  // 取消连接在缓冲组group上的接收请求，由其ECANCELED完成事件决定是否重新提交
+  void cancel_recv(int fd, uint32_t conn_id, uint8_t group);
 
   // 无需获取固定缓冲区，用于发送较小的数据包
   int prep_send(int fd, uint32_t conn_id, void *data, size_t length,
@@ -56,13 +70,62 @@ public:
   int prep_send_zc(int fd, uint32_t conn_id, void *data, uint16_t bidx,
                    size_t length, bool flag = false);
 
+  // 提交连接发送队列中的数据，完成时交给TcpConnection::SendQueueHandle处理
+  // 按发送策略选择普通发送或零拷贝发送，返回true表示使用了零拷贝发送，
+  // 此时数据在TcpConnection::SendQueueNotify之前不能修改
+  bool prep_send_queued(int fd, uint32_t conn_id, void *data, size_t length,
+                        bool flag = false);
+
   int prep_close(int fd, uint32_t conn_id);
 
   // 准备一个跨线程消息，其中conn_id为目标线程的连接id
+  // 消息会在本轮事件循环结束时与发往同一线程的其他消息一同发送
   int prep_cross_thread_msg(uint32_t conn_id, CTContext *context);
 
   int submit_cancel(int fd, uint32_t conn_id);
 
+  // master线程读取signalfd，收到退出信号后通知所有worker线程平滑退出
+  int prep_signal(int signal_fd);
+
+  // master线程接受新进程的热升级连接
+  int prep_upgrade_accept(int upgrade_fd);
+
+  // 新进程的worker线程将旧进程移交的连接注册到直接文件描述符表并恢复其会话
+  void restore_connections(std::vector<upgrade_conn> conns);
+
+  // 在目标worker线程中执行fn，与跨线程消息一同在本轮事件循环结束时发送
+  // 目标为本线程时立即执行
+  // drop在目标线程已退出而无法执行fn时代替其执行，可能在任意worker线程中执行
+  void prep_cross_thread_call(uint32_t worker, std::function<void()> fn,
+                              std::function<void(EventLoop *)> drop = nullptr);
+
+  // 可由任意线程调用，在本事件循环的线程中执行fn，通过邮箱投递并按需发送门铃
+  void PostFromAnyThread(std::function<void()> fn);
+
+  // 在计算线程池中执行work，完成后在本线程中执行done，work抛出异常时同样执行done
+  // 未启用线程池或线程池队列已满时返回false，此时work与done均不会被执行，
+  // 调用方需另外持有所需的状态并自行在本线程中执行
+  bool Offload(std::function<void()> work, std::function<void()> done);
+
+  // 获取本线程中的连接，连接已销毁时返回nullptr
+  TcpConnection *GetConnection(uint32_t conn_id);
+
+  // 在本线程中分离运行一个协程，立即执行直到其第一次挂起
+  // 事件循环销毁时仍未结束的协程会被直接销毁
+  inline void Spawn(Task<void> task) { tasks_.Spawn(std::move(task)); }
+
+  // 在本轮事件循环处理完完成事件后恢复挂起的协程，避免在事件处理过程中重入
+  inline void Post(std::coroutine_handle<> handle) {
+    ready_.push_back(handle);
+  }
+
+  class SleepAwaiter;
+  class CallAwaiter;
+  // 挂起当前协程millis毫秒，精度为时间轮的刻度，只能在worker线程中使用
+  SleepAwaiter Sleep(uint32_t millis);
+  // 在编号为worker的线程中执行fn，并将其返回值带回当前协程
+  CallAwaiter Call(uint32_t worker, std::function<std::string()> fn);
+
   // 获取发送缓冲区，用于填充发送数据
   // 若存在可用发送缓冲区，则设置buffer_ptr指向发送缓冲区地址，否则为NULL
   // 返回固定缓冲区索引，失败时返回-1
@@ -71,16 +134,38 @@ public:
   // 添加一个超时任务
   inline void AddTimer(TimeWheel::timer_node *timer, uint32_t millis) {
     time_wheel_->AddTimer(timer, millis);
+    // 早于已设置的超时，需在下一次等待完成事件前提前超时时间
+    if (timer->expires_ < armed_tick_)
+      timer_rearm_ = true;
+  }
+
+  // 添加一个micros微秒后触发的高精度计时器，已添加时重新设置其到期时间
+  // 不经过时间轮，到期时间精确到内核定时器的精度，只能在worker线程中使用
+  void AddPreciseTimer(TimerHeap::timer_node *timer, uint32_t micros);
+  inline void CancelPreciseTimer(TimerHeap::timer_node *timer) {
+    timer_heap_.Cancel(timer);
   }
 
   struct io_uring_sqe *GetSqe();
 
+  // worker线程接收跨线程消息批次的邮箱
+  inline Mailbox<CTBatch *> *GetMailbox() { return mailbox_.get(); }
+
+  // 平滑退出超过最终期限，连接表需由所属worker有意泄漏
+  inline bool drain_leaked() const { return drain_leaked_; }
+
 private:
-  void SetUpIoUring(uint32_t entries);
+  void SetUpIoUring(uint32_t entries, uint32_t fd_table_size);
   void DestroyIoUring();
 
-  // 准备下一次超时
-  void __prep_timeout(timespec *ts);
+  // 周期模式下准备每个刻度触发一次的multishot超时
+  void prep_tick_timeout();
+  // tickless模式下按时间轮中下一个需要处理的刻度设置唯一的超时请求，
+  // 同时按高精度计时器中最早的到期时间设置另一个超时请求
+  void arm_timer();
+  // 提交或修改一个绝对时间的超时请求，bid区分超时请求的用途
+  void prep_abs_timeout(struct __kernel_timespec *ts, bool update,
+                        uint16_t bid);
 
   int EventHandler(struct io_uring_cqe *cqe);
   // 事件处理函数
@@ -94,23 +179,234 @@ private:
   int handle_fd_pass(struct io_uring_cqe *cqe);
   int handle_cross_thread_msg(struct io_uring_cqe *cqe);
   int handle_timeout(struct io_uring_cqe *cqe);
+  int handle_signal(struct io_uring_cqe *cqe);
+  int handle_drain(struct io_uring_cqe *cqe);
+  int handle_upgrade(struct io_uring_cqe *cqe);
+  int handle_handoff(struct io_uring_cqe *cqe);
+  // 已关闭且延迟销毁的连接在发送队列的请求全部结束后销毁
+  void release_deferred(TcpConnection *connection);
+
+  // 按连接近期收到的数据量调整其接收缓冲组，group为本次完成事件所用的缓冲组
+  // 需要调整时取消原有的接收请求，由其ECANCELED完成事件以新的缓冲组重新提交
+  void update_recv_group(TcpConnection *connection, uint32_t len,
+                         uint8_t group);
+
+  // master线程停止接受新连接，并通知所有worker线程以flags方式退出
+  void drain_workers(int flags);
+  // worker线程进入平滑退出状态，flags见kDrainForce与kDrainHandoff
+  void start_drain(int flags);
+  // 热升级时将所有空闲连接转换为普通文件描述符，以便发送给新进程
+  void start_handoff();
+  // 通知master线程本线程的连接已全部移交
+  void report_handoff();
+  // 每个时间轮刻度执行一次，分批通知连接关闭，并检查是否可以退出
+  void drain_step();
+  // 是否仍有交给计算线程池的任务，或内核仍在使用的发送数据
+  bool drain_pending();
+  // 仍有发送请求或零拷贝通知未完成的连接数量
+  uint32_t pending_send_connections();
+
+  // 发送本轮事件循环中积累的跨线程消息批次
+  void flush_cross_thread_msgs();
+  // 丢弃无法投递的批次，先通知其中调用的发起方，再释放消息上下文
+  void reject_batch(CTBatch *batch);
+  // 存在未能投递的批次时设置一个短超时，避免事件循环无限期等待而不再重试
+  void prep_mailbox_retry();
+  // 通过MSG_RING通知目标worker线程其邮箱中有新的消息
+  void send_doorbell(uint32_t worker);
+  void deliver_cross_thread_batch(CTBatch *batch);
+  void deliver_cross_thread_msg(uint32_t conn_id, CTContext *context);
+  // 恢复本轮事件循环中就绪的协程
+  void resume_ready();
+  // 记录连接准备的发送请求，供等待发送完成的协程使用
+  void count_send(uint32_t conn_id);
+
+  // master线程将新连接传递给编号为worker的线程，并关闭本线程中的槽位
+  void pass_connection(int fd, uint32_t worker);
+  // 直接文件描述符表的占用率不低于percent时返回true
+  // master线程检查所有worker线程，worker线程只检查本线程
+  bool accept_saturated(uint32_t percent);
+  // 取消accept请求，由内核的监听队列暂存新连接，定时检查是否可以恢复
+  void pause_accept();
+  void schedule_accept_retry();
+  void resume_accept();
+
+  // 为新接受的连接建立连接对象，失败时返回nullptr
+  TcpConnection *add_connection(int fd);
+
+  // 提交请求并等待完成事件，按配置进行忙轮询与批量等待
+  int wait_completions();
+  bool busy_poll();
+  // 统计批量大小，并据此调整下一次等待的完成事件数量
+  void update_wait_target(unsigned count);
+
+  // 累计本轮处理完成事件的时间，并在每个统计窗口结束时更新繁忙程度
+  void update_load(uint64_t wake_nanos, uint64_t now_nanos);
 
   // 缓冲池，用于管理接受/发送数据缓冲区
   std::unique_ptr<BufferPool> buffer_pool_;
 
   JdocsServer *server_;
   Worker *worker_;
+  const ServerConfig *config_;
 
   struct io_uring ring_;
   bool running_{false};
 
+  // 当前统计窗口的起始时间以及窗口内处理完成事件的累计时间
+  uint64_t load_window_start_{0};
+  uint64_t now_millis_{0};
+  uint64_t load_busy_nanos_{0};
+  // 最近的繁忙程度，单位千分之一
+  uint32_t busy_permille_{0};
+
+  // 下一次等待的完成事件数量
+  uint32_t wait_target_{1};
+  // 批量大小的指数加权平均，低kBatchEwmaFrac位为小数部分
+  uint32_t batch_ewma_{1U << 4};
+  // 内核支持IORING_FEAT_MIN_TIMEOUT
+  bool min_timeout_{false};
+  // 接收请求使用bundle模式，一个完成事件可以填充多个缓冲区
+  bool recv_bundle_{false};
+
   // 时间轮，用于管理超时任务
   std::unique_ptr<TimeWheel> time_wheel_;
+  // tickless模式下已设置的超时对应的刻度，没有超时请求时为UINT64_MAX
+  // 周期模式下恒为0，添加计时器时不会触发重新设置
+  uint64_t armed_tick_{0};
+  bool timer_rearm_{false};
+  // 周期模式下使用multishot超时，内核不支持时退回为每个刻度提交一次绝对超时
+  bool tick_multishot_{true};
+  struct __kernel_timespec timer_ts_;
+  // 高精度计时器，以及已设置的超时对应的到期时间，没有超时请求时为UINT64_MAX
+  TimerHeap timer_heap_;
+  uint64_t precise_armed_{UINT64_MAX};
+  struct __kernel_timespec precise_ts_;
+
+  std::unique_ptr<Mailbox<CTBatch *>> mailbox_;
+  // 分离运行的协程，以及等待在本轮事件循环结束时恢复的协程
+  TaskGroup tasks_;
+  std::vector<std::coroutine_handle<>> ready_;
+
+  // 以worker编号为下标，本轮事件循环中发往各个worker线程的消息批次
+  std::vector<CTBatch *> ct_batches_;
+  // 本轮事件循环中存在待发送批次的worker编号
+  std::vector<uint32_t> ct_pending_workers_;
+  // 目标邮箱已满时设置的重试超时
+  bool ct_retry_armed_{false};
+  struct __kernel_timespec ct_retry_ts_;
+
+  // 当前提交accept请求的监听套接字
+  int listen_fd_{-1};
+  // 直接文件描述符表接近占满时暂停接受新连接，定时检查是否可以恢复
+  bool accept_paused_{false};
+  TimeWheel::timer_node accept_timer_ =
+      TimeWheel::timer_node::Bind<&EventLoop::resume_accept>(this);
+  // master线程定时检查所使用的超时时间
+  struct __kernel_timespec accept_ts_;
+
+  // 平滑退出状态
+  bool draining_{false};
+  // 超过该时间后强制关闭剩余连接，单位毫秒
+  uint64_t drain_start_{0};
+  uint64_t drain_deadline_{0};
+  // 开始退出时的连接数量，以及已通知关闭的连接数量
+  uint32_t drain_total_{0};
+  uint32_t drain_notified_{0};
+  // 下一个待通知的连接表下标
+  uint32_t drain_cursor_{0};
+  TimeWheel::timer_node drain_timer_ =
+      TimeWheel::timer_node::Bind<&EventLoop::drain_step>(this);
+  // 已交给计算线程池但done尚未在本线程执行的任务数量
+  uint32_t offloads_inflight_{0};
+  // 超过最终期限后退出，仍被占用的连接与缓冲池有意不释放
+  bool drain_leaked_{false};
+  // master线程读取退出信号
+  int signal_fd_{-1};
+  struct signalfd_siginfo siginfo_;
+  // master线程已完成退出的worker线程数量
+  uint32_t drained_workers_{0};
+  // master线程接受热升级连接的unix套接字
+  int upgrade_fd_{-1};
+  // worker线程尚未完成移交的连接数量
+  uint32_t handoff_pending_{0};
+  // master线程已完成移交的worker线程数量
+  uint32_t handoff_workers_{0};
 
   // true则代表属于worker线程的事件循环，否则为master线程的事件循环
   bool flag_;
 };
 
+class EventLoop::SleepAwaiter {
+public:
+  SleepAwaiter(EventLoop *loop, uint32_t millis)
+      : loop_(loop), millis_(millis) {}
+
+  SleepAwaiter(const SleepAwaiter &) = delete;
+  SleepAwaiter &operator=(const SleepAwaiter &) = delete;
+
+  bool await_ready() const noexcept { return false; }
+  void await_suspend(std::coroutine_handle<> waiter) {
+    waiter_ = waiter;
+    loop_->AddTimer(&timer_, millis_);
+  }
+  void await_resume() noexcept {}
+
+private:
+  EventLoop *loop_;
+  uint32_t millis_;
+  std::coroutine_handle<> waiter_;
+  inline void wake() { loop_->Post(waiter_); }
+
+  // 协程帧销毁时定时器随之从时间轮中移除
+  TimeWheel::timer_node timer_ =
+      TimeWheel::timer_node::Bind<&SleepAwaiter::wake>(this);
+};
+
+class EventLoop::CallAwaiter {
+public:
+  CallAwaiter(EventLoop *loop, uint32_t worker,
+              std::function<std::string()> fn)
+      : loop_(loop), worker_(worker), fn_(std::move(fn)),
+        state_(std::make_shared<state>()) {}
+  // 协程帧在结果返回之前被销毁时，结果到达后不再恢复
+  ~CallAwaiter() { state_->waiter = {}; }
+
+  CallAwaiter(const CallAwaiter &) = delete;
+  CallAwaiter &operator=(const CallAwaiter &) = delete;
+
+  bool await_ready() const noexcept { return false; }
+  void await_suspend(std::coroutine_handle<> waiter);
+  // fn抛出的异常或目标线程已退出时在等待方中重新抛出
+  std::string await_resume() {
+    if (state_->error)
+      std::rethrow_exception(state_->error);
+    return std::move(state_->result);
+  }
+
+private:
+  // 由发起线程与执行线程共享，执行线程只写入结果，等待方只在发起线程中访问
+  struct state {
+    std::string result;
+    std::exception_ptr error;
+    std::coroutine_handle<> waiter;
+  };
+
+  EventLoop *loop_;
+  uint32_t worker_;
+  std::function<std::string()> fn_;
+  std::shared_ptr<state> state_;
+};
+
+inline EventLoop::SleepAwaiter EventLoop::Sleep(uint32_t millis) {
+  return SleepAwaiter(this, millis);
+}
+
+inline EventLoop::CallAwaiter
+EventLoop::Call(uint32_t worker, std::function<std::string()> fn) {
+  return CallAwaiter(this, worker, std::move(fn));
+}
+
 } // namespace jdocs
 
 #endif
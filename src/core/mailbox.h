@@ -0,0 +1,113 @@
+// Copyright (c) 2025-2026 Juantgd. All Rights Reserved.
+
+#ifndef JDOCS_CORE_MAILBOX_H_
+#define JDOCS_CORE_MAILBOX_H_
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <thread>
+
+namespace jdocs {
+
+// 有界无锁多生产者单消费者队列，用于向worker线程投递跨线程消息
+// 除队列本身外还维护一个有符号的待处理计数，只有当邮箱由空变为非空时，
+// 生产者才需要通过MSG_RING向消费者发送一次门铃，消费者收到门铃后批量取出所有消息
+template <typename T> class Mailbox {
+public:
+  // 容量必须为2的幂
+  explicit Mailbox(uint32_t capacity)
+      : cells_(new cell[capacity]), mask_(capacity - 1) {
+    for (uint32_t i = 0; i != capacity; ++i)
+      cells_[i].seq.store(i, std::memory_order_relaxed);
+  }
+  ~Mailbox() = default;
+
+  Mailbox(const Mailbox &) = delete;
+  Mailbox &operator=(const Mailbox &) = delete;
+
+  // 可由任意线程调用，邮箱已满时返回-1
+  // 邮箱由空变为非空时返回1，调用方需要向消费者发送门铃，否则返回0
+  int Push(T value) {
+    uint64_t pos = tail_.load(std::memory_order_relaxed);
+    cell *c;
+    for (;;) {
+      c = &cells_[pos & mask_];
+      uint64_t seq = c->seq.load(std::memory_order_acquire);
+      int64_t diff = static_cast<int64_t>(seq - pos);
+      if (diff == 0) {
+        if (tail_.compare_exchange_weak(pos, pos + 1,
+                                        std::memory_order_relaxed))
+          break;
+      } else if (diff < 0) {
+        return -1;
+      } else {
+        pos = tail_.load(std::memory_order_relaxed);
+      }
+    }
+    c->value = std::move(value);
+    c->seq.store(pos + 1, std::memory_order_release);
+    // 先写入消息再计数，计数大于0时对应的消息一定对消费者可见
+    return pending_.fetch_add(1, std::memory_order_acq_rel) == 0 ? 1 : 0;
+  }
+
+  // 只能由消费者线程调用，收到门铃后取出所有消息并逐个交给fn处理，返回处理的消息数量
+  // 消费者可能先于生产者计数取出消息，此时待处理计数暂时为负，
+  // 对应的生产者计数后不会为0，因此不会发送多余的门铃
+  template <typename F> size_t Drain(F &&fn) {
+    size_t total = 0;
+    for (;;) {
+      int64_t count = 0;
+      T value;
+      while (Pop(&value)) {
+        fn(std::move(value));
+        ++count;
+      }
+      total += static_cast<size_t>(count);
+      // 仍有已计数的消息，其生产者不会再发送门铃，需要继续取出
+      if (pending_.fetch_sub(count, std::memory_order_acq_rel) - count <= 0)
+        break;
+      // 已计数的消息前存在尚未写入完毕的槽位，等待其生产者写入
+      if (count == 0)
+        std::this_thread::yield();
+    }
+    return total;
+  }
+
+  inline uint32_t capacity() const { return static_cast<uint32_t>(mask_ + 1); }
+
+  // 消费者退出前关闭邮箱，生产者在写入前检查，不再向已关闭的邮箱投递消息
+  // 关闭前已开始写入的消息仍需由消费者取出释放
+  inline void Close() { closed_.store(true, std::memory_order_release); }
+  inline bool closed() const { return closed_.load(std::memory_order_acquire); }
+
+private:
+  struct cell {
+    std::atomic<uint64_t> seq;
+    T value;
+  };
+
+  bool Pop(T *value) {
+    cell *c = &cells_[head_ & mask_];
+    if (c->seq.load(std::memory_order_acquire) != head_ + 1)
+      return false;
+    *value = std::move(c->value);
+    c->seq.store(head_ + mask_ + 1, std::memory_order_release);
+    ++head_;
+    return true;
+  }
+
+  std::unique_ptr<cell[]> cells_;
+  uint64_t mask_;
+  // 生产者位置
+  alignas(64) std::atomic<uint64_t> tail_{0};
+  // 消费者位置，只由消费者线程访问
+  alignas(64) uint64_t head_{0};
+  // 已写入但尚未被消费者处理的消息数量
+  alignas(64) std::atomic<int64_t> pending_{0};
+  std::atomic<bool> closed_{false};
+};
+
+} // namespace jdocs
+
+#endif
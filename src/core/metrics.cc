@@ -0,0 +1,68 @@
+// Copyright (c) 2025-2026 Juantgd. All Rights Reserved.
+
+#include "metrics.h"
+
+#include <cstring>
+
+#include <spdlog/spdlog.h>
+
+namespace jdocs {
+
+namespace {
+
+Metrics metrics_slots[kMaxMetricsSlots];
+std::atomic<uint32_t> metrics_slot_count{0};
+
+struct metric_desc {
+  const char *type;
+  const char *name;
+  const char *help;
+};
+
+constexpr metric_desc metrics_desc_table[] = {
+#define X(id, type, name, help) {#type, name, help},
+    METRICS_MAP(X)
+#undef X
+};
+
+} // namespace
+
+Metrics *Metrics::Register(const std::string &label) {
+  uint32_t index = metrics_slot_count.fetch_add(1, std::memory_order_relaxed);
+  if (index >= kMaxMetricsSlots) {
+    spdlog::error("metrics slots exhausted, thread {} will not be exported.",
+                  label);
+    return nullptr;
+  }
+  Metrics *slot = &metrics_slots[index];
+  strncpy(slot->label_, label.c_str(), kMetricsLabelSize - 1);
+  slot->ready_.store(true, std::memory_order_release);
+  local_metrics = slot;
+  return slot;
+}
+
+std::string Metrics::Export() {
+  uint32_t count = metrics_slot_count.load(std::memory_order_relaxed);
+  if (count > kMaxMetricsSlots)
+    count = kMaxMetricsSlots;
+  std::string result;
+  result.reserve(METRIC_MAX * (count + 2) * 64);
+  for (uint32_t id = 0; id != METRIC_MAX; ++id) {
+    const metric_desc &desc = metrics_desc_table[id];
+    result.append("# HELP ").append(desc.name).append(" ").append(desc.help);
+    result.append("\n# TYPE ").append(desc.name).append(" ").append(desc.type);
+    result.push_back('\n');
+    for (uint32_t i = 0; i != count; ++i) {
+      const Metrics &slot = metrics_slots[i];
+      if (!slot.ready_.load(std::memory_order_acquire))
+        continue;
+      result.append(desc.name).append("{thread=\"").append(slot.label_);
+      result.append("\"} ");
+      result.append(std::to_string(slot.Get(static_cast<metric_id_t>(id))));
+      result.push_back('\n');
+    }
+  }
+  return result;
+}
+
+} // namespace jdocs
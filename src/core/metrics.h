@@ -0,0 +1,162 @@
+// Copyright (c) 2025-2026 Juantgd. All Rights Reserved.
+
+#ifndef JDOCS_CORE_METRICS_H_
+#define JDOCS_CORE_METRICS_H_
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+namespace jdocs {
+
+namespace {
+
+// 最多可注册的指标槽数量，每个线程占用一个
+constexpr uint32_t kMaxMetricsSlots = 256;
+// 指标槽标签的最大长度
+constexpr uint32_t kMetricsLabelSize = 32;
+
+} // namespace
+
+// 指标项定义：标识、类型、导出名称、说明
+#define METRICS_MAP(X)                                                         \
+  X(CQE_BATCHES, counter, "jdocs_cqe_batches_total",                           \
+    "Completion batches reaped by the event loop")                             \
+  X(CQES, counter, "jdocs_cqes_total", "Completion queue entries handled")     \
+  X(CQE_BATCHES_1, counter, "jdocs_cqe_batches_size_1_total",                  \
+    "Completion batches holding a single entry")                               \
+  X(CQE_BATCHES_2_7, counter, "jdocs_cqe_batches_size_2_7_total",              \
+    "Completion batches holding 2 to 7 entries")                               \
+  X(CQE_BATCHES_8_31, counter, "jdocs_cqe_batches_size_8_31_total",            \
+    "Completion batches holding 8 to 31 entries")                              \
+  X(CQE_BATCHES_32, counter, "jdocs_cqe_batches_size_32_plus_total",           \
+    "Completion batches holding 32 or more entries")                           \
+  X(WAIT_TARGET, gauge, "jdocs_wait_batch_target",                             \
+    "Completions the event loop currently waits for per wakeup")               \
+  X(WAIT_TIMEOUTS, counter, "jdocs_wait_timeouts_total",                       \
+    "Batched waits that timed out before the target was reached")              \
+  X(BUSY_POLL_HITS, counter, "jdocs_busy_poll_hits_total",                     \
+    "Wakeups served by busy polling without sleeping")                         \
+  X(TIMER_WAKEUPS, counter, "jdocs_timer_wakeups_total",                       \
+    "Timeouts handled by the worker event loops")                              \
+  X(IDLE_REARMS, counter, "jdocs_idle_rearms_total",                           \
+    "Idle timers re-armed on expiry for connections active since arming")      \
+  X(LOOP_BUSY, gauge, "jdocs_loop_busy_permille",                              \
+    "Recent share of time the event loop spent handling completions")          \
+  X(ACCEPTS, counter, "jdocs_accepts_total", "Connections accepted")           \
+  X(CONNECTIONS, gauge, "jdocs_open_connections",                              \
+    "Currently open connections")                                              \
+  X(FD_TABLE_SLOTS, gauge, "jdocs_fd_table_slots",                             \
+    "Direct descriptor table slots available for connections")                \
+  X(ACCEPT_PAUSES, counter, "jdocs_accept_pauses_total",                       \
+    "Times accepting was paused because the fd tables were nearly full")       \
+  X(ACCEPT_DROPS, counter, "jdocs_accept_drops_total",                         \
+    "Accepted connections closed because no worker had a free slot")           \
+  X(RECV_BYTES, counter, "jdocs_recv_bytes_total", "Bytes received")           \
+  X(SEND_BYTES, counter, "jdocs_send_bytes_total", "Bytes sent")               \
+  X(RECV_ENOBUFS, counter, "jdocs_recv_enobufs_total",                         \
+    "Multishot recv terminations caused by an empty buffer ring")              \
+  X(RECV_COMPLETIONS, counter, "jdocs_recv_completions_total",                 \
+    "Recv completions carrying data")                                          \
+  X(RECV_BUFFERS, gauge, "jdocs_recv_buffers", "Provided recv buffers")        \
+  X(RECV_GROUP_SWITCHES, counter, "jdocs_recv_group_switches_total",           \
+    "Connections moved to a recv buffer group of another size")               \
+  X(SEND_BUFFERS, gauge, "jdocs_send_buffers", "Registered send buffers")      \
+  X(SEND_QUEUE_BYTES, gauge, "jdocs_send_queue_bytes",                         \
+    "Bytes waiting in connection send queues")                                 \
+  X(SEND_QUEUE_DROPS, counter, "jdocs_send_queue_drops_total",                 \
+    "Droppable messages discarded because a send queue was over budget")       \
+  X(SLOW_CONSUMER_CLOSES, counter, "jdocs_slow_consumer_closes_total",         \
+    "Connections closed because their send queue was over budget")            \
+  X(RECV_PAUSES, counter, "jdocs_recv_pauses_total",                           \
+    "Times receiving was paused because a send queue was over budget")        \
+  X(SENDS_COPY, counter, "jdocs_sends_copy_total",                             \
+    "Queued sends submitted as plain send")                                    \
+  X(SENDS_ZC, counter, "jdocs_sends_zc_total",                                 \
+    "Queued sends submitted as send_zc")                                       \
+  X(SEND_SHORT_WRITES, counter, "jdocs_send_short_writes_total",               \
+    "Queued sends that completed short and were continued")                    \
+  X(SEND_BUFFER_EXHAUSTED, counter, "jdocs_send_buffer_exhausted_total",       \
+    "Send buffer requests that found the pool exhausted")                      \
+  X(CT_MSGS_SENT, counter, "jdocs_cross_thread_msgs_sent_total",               \
+    "Cross thread messages sent")                                              \
+  X(CT_BATCHES_SENT, counter, "jdocs_cross_thread_batches_sent_total",        \
+    "Cross thread message batches posted to worker mailboxes")                 \
+  X(CT_DOORBELLS, counter, "jdocs_cross_thread_doorbells_total",               \
+    "Mailbox doorbells sent through msg_ring")                                 \
+  X(MAILBOX_FULL, counter, "jdocs_mailbox_full_total",                         \
+    "Batches deferred because the target mailbox was full")                    \
+  X(CT_MSGS_RECEIVED, counter, "jdocs_cross_thread_msgs_received_total",       \
+    "Cross thread messages received")                                          \
+  X(HANDOFFS, counter, "jdocs_handoffs_total",                                 \
+    "Connections handed off to a new process during upgrade")                  \
+  X(OFFLOADED, counter, "jdocs_offloaded_jobs_total",                          \
+    "Document jobs handed to the compute pool")                                \
+  X(OFFLOAD_REJECTS, counter, "jdocs_offload_rejects_total",                   \
+    "Document jobs run inline because the compute pool queue was full")        \
+  X(DOC_EDITS, counter, "jdocs_document_edits_total",                          \
+    "Document edits applied")                                                  \
+  X(CHAT_MESSAGES, counter, "jdocs_chat_messages_total",                       \
+    "Chat messages handled")
+
+enum metric_id_t : uint32_t {
+#define X(id, type, name, help) METRIC_##id,
+  METRICS_MAP(X)
+#undef X
+      METRIC_MAX
+};
+
+// 线程级指标槽，每个槽只由所属线程写入，因此更新时无需原子读改写操作
+// 导出时其他线程以relaxed方式读取，不会阻塞热路径
+class alignas(64) Metrics {
+public:
+  Metrics() = default;
+  ~Metrics() = default;
+
+  Metrics(const Metrics &) = delete;
+  Metrics &operator=(const Metrics &) = delete;
+
+  inline void Add(metric_id_t id, int64_t n = 1) {
+    values_[id].store(values_[id].load(std::memory_order_relaxed) + n,
+                      std::memory_order_relaxed);
+  }
+
+  inline void Set(metric_id_t id, int64_t value) {
+    values_[id].store(value, std::memory_order_relaxed);
+  }
+
+  inline int64_t Get(metric_id_t id) const {
+    return values_[id].load(std::memory_order_relaxed);
+  }
+
+  inline const char *label() const { return label_; }
+
+  // 为当前线程注册一个指标槽，label用于区分导出时的不同线程
+  // 槽位耗尽时返回nullptr，该线程的指标将不会被导出
+  static Metrics *Register(const std::string &label);
+
+  // 将所有已注册线程的指标导出为Prometheus文本格式
+  static std::string Export();
+
+private:
+  std::atomic<int64_t> values_[METRIC_MAX]{};
+  char label_[kMetricsLabelSize]{};
+  // 槽位是否已初始化完毕，可被导出
+  std::atomic<bool> ready_{false};
+};
+
+// 未注册线程使用的占位指标槽，不会被导出
+inline Metrics unregistered_metrics;
+inline thread_local Metrics *local_metrics = &unregistered_metrics;
+
+static inline void metrics_add(metric_id_t id, int64_t n = 1) {
+  local_metrics->Add(id, n);
+}
+
+static inline void metrics_set(metric_id_t id, int64_t value) {
+  local_metrics->Set(id, value);
+}
+
+} // namespace jdocs
+
+#endif
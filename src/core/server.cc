@@ -5,41 +5,325 @@
 #include <thread>
 
 #include <liburing.h>
+#include <nlohmann/json.hpp>
 
 #include "context.h"
+#include "metrics.h"
+#include "services/document/document_service.h"
 #include "utils/helpers.h"
+#include "utils/numa.h"
 
 namespace jdocs {
 
-JdocsServer::JdocsServer(int port) : event_loop_(this, nullptr, false) {
-  serv_fd_ = create_listening_socket(port);
-  if (serv_fd_ < 0) {
-    exit(EXIT_FAILURE);
-  }
-  unsigned int nr_threads = std::thread::hardware_concurrency();
+JdocsServer::JdocsServer(const ServerConfig &config)
+    : config_(config), event_loop_(this, nullptr, false) {
+  // worker线程按顺序绑定到列表中的CPU上，worker数量多于CPU数量时循环绑定
+  std::vector<int> cpus;
+  if (!config_.worker_cpus.empty())
+    parse_cpu_list(config_.worker_cpus, &cpus);
+  unsigned int nr_threads = config_.worker_threads;
+  if (nr_threads == 0)
+    nr_threads = cpus.empty() ? std::thread::hardware_concurrency()
+                              : static_cast<unsigned int>(cpus.size());
   nr_threads_ = nr_threads ? nr_threads : 1;
   // nr_threads_ = 1;
+  // 连接id中只预留了有限的位数用于表示worker线程编号
+  if (nr_threads_ > kMaxWorkers) {
+    spdlog::warn("worker threads limited to {}", kMaxWorkers);
+    nr_threads_ = kMaxWorkers;
+  }
+  // 热升级时由旧进程交出监听套接字，移交的连接需在worker线程启动前接收完毕
+  std::vector<std::shared_ptr<Document>> docs;
+  restored_conns_.resize(nr_threads_);
+  if (config_.upgrade) {
+    if (ReceiveUpgrade(&docs))
+      exit(EXIT_FAILURE);
+  } else if (config_.accept_mode == kAcceptModeReuseport) {
+    if (SetUpReuseport(cpus))
+      exit(EXIT_FAILURE);
+  } else {
+    serv_fd_ = create_listening_socket(static_cast<int>(config_.port));
+    if (serv_fd_ < 0) {
+      exit(EXIT_FAILURE);
+    }
+  }
+  if (!config_.upgrade_socket.empty()) {
+    upgrade_listen_fd_ = create_upgrade_socket(config_.upgrade_socket);
+    if (upgrade_listen_fd_ < 0)
+      exit(EXIT_FAILURE);
+  }
+  // 退出信号已在main中屏蔽，只通过signalfd由master线程处理
+  signal_fd_ = create_exit_signalfd();
+  if (signal_fd_ < 0)
+    exit(EXIT_FAILURE);
+  if (config_.compute_threads)
+    compute_pool_ = std::make_unique<ComputePool>(
+        config_.compute_threads, config_.compute_queue_capacity);
   worker_threads_.reserve(nr_threads_);
-  char buf[16] = {};
   for (unsigned int i = 0; i < nr_threads_; ++i) {
-    int bytes = snprintf(buf, 16, "worker-%u", i);
-    assert(bytes > 0);
-    worker_threads_.emplace_back(this,
-                                 std::string(buf, static_cast<size_t>(bytes)));
+    worker_threads_.emplace_back(this, i,
+                                 cpus.empty() ? -1 : cpus[i % cpus.size()]);
   }
+  // worker线程构造完成时已恢复全部连接，文档由恢复的用户会话持有
+  restored_conns_.clear();
+}
+
+JdocsServer::~JdocsServer() {
+  if (signal_fd_ >= 0)
+    close(signal_fd_);
+  if (upgrade_listen_fd_ >= 0)
+    close(upgrade_listen_fd_);
+  if (upgrade_fd_ >= 0)
+    close(upgrade_fd_);
+  if (serv_fd_ >= 0)
+    close(serv_fd_);
+  for (int fd : listen_fds_)
+    close(fd);
 }
 
-JdocsServer::~JdocsServer() { close(serv_fd_); }
+int JdocsServer::SetUpReuseport(const std::vector<int> &cpus) {
+  // 套接字按顺序开始监听，其在reuseport组内的下标即为worker线程编号
+  for (unsigned int i = 0; i < nr_threads_; ++i) {
+    int fd = create_listening_socket(static_cast<int>(config_.port), true);
+    if (fd < 0)
+      return -1;
+    listen_fds_.push_back(fd);
+    if (config_.reuseport_steering != kSteeringIncomingCpu)
+      continue;
+    // 内核选择监听套接字时，优先选择incoming cpu与接收连接的CPU相同的套接字
+    int cpu = cpus[i % cpus.size()];
+    if (setsockopt(fd, SOL_SOCKET, SO_INCOMING_CPU, &cpu, sizeof(cpu)) < 0) {
+      spdlog::error("setsockopt SO_INCOMING_CPU failed. error: {}",
+                    strerror(errno));
+      return -1;
+    }
+  }
+  if (config_.reuseport_steering == kSteeringBpf)
+    return attach_reuseport_cpu_program(listen_fds_[0], nr_threads_);
+  return 0;
+}
 
 int JdocsServer::Run() {
-  // 准备提交一个accept请求
-  struct io_uring_sqe *sqe = event_loop_.GetSqe();
-  io_uring_prep_multishot_accept_direct(sqe, serv_fd_, NULL, NULL, 0);
-  user_data_encode(sqe, __ACCEPT, 0, serv_fd_, 0);
+  Metrics::Register("master");
+  // 在worker线程创建之后才绑定，避免worker线程继承master线程的CPU亲和性
+  if (config_.master_cpu >= 0 &&
+      bind_thread(config_.master_cpu, config_.numa_local))
+    spdlog::warn("master runs unpinned.");
+  // 准备提交一个accept请求，reuseport模式下由worker线程各自接受连接
+  if (config_.accept_mode == kAcceptModeMaster)
+    event_loop_.prep_accept(serv_fd_);
+  // 收到SIGINT或SIGTERM后平滑退出，所有worker线程退出后事件循环返回
+  event_loop_.prep_signal(signal_fd_);
+  if (upgrade_listen_fd_ >= 0)
+    event_loop_.prep_upgrade_accept(upgrade_listen_fd_);
   // 开始事件循环
   return event_loop_.Run();
 }
 
+int JdocsServer::ReceiveUpgrade(std::vector<std::shared_ptr<Document>> *docs) {
+  int sock = connect_upgrade_socket(config_.upgrade_socket);
+  if (sock < 0)
+    return -1;
+  nlohmann::json hello;
+  hello["connections"] = config_.upgrade_connections;
+  hello["accept_mode"] = config_.accept_mode;
+  hello["workers"] = nr_threads_;
+  if (upgrade_send(sock, kUpgradeHello, hello.dump())) {
+    close(sock);
+    return -1;
+  }
+  uint32_t type;
+  std::string payload;
+  std::vector<int> fds;
+  bool listening = false;
+  size_t conns = 0;
+  while (!upgrade_recv(sock, &type, &payload, &fds) && type != kUpgradeEnd) {
+    switch (type) {
+    case kUpgradeListen:
+      if (config_.accept_mode == kAcceptModeReuseport)
+        listen_fds_ = fds;
+      else if (!fds.empty())
+        serv_fd_ = fds[0];
+      listening = !fds.empty();
+      break;
+    case kUpgradeConn:
+      // 移交的连接按轮询方式分配给各个worker线程
+      if (!fds.empty())
+        restored_conns_[conns++ % nr_threads_].push_back(
+            {fds[0], std::move(payload)});
+      break;
+    case kUpgradeDoc: {
+      std::shared_ptr<Document> doc = DocumentService::RestoreDocument(
+          payload, config_.doc_history_capacity);
+      if (doc)
+        docs->push_back(std::move(doc));
+      break;
+    }
+    default:
+      for (int fd : fds)
+        close(fd);
+      break;
+    }
+  }
+  close(sock);
+  if (type != kUpgradeEnd || !listening) {
+    spdlog::error("upgrade from {} failed, the running process refused or "
+                  "quit",
+                  config_.upgrade_socket);
+    return -1;
+  }
+  spdlog::info("took over {} connections and {} documents", conns,
+               docs->size());
+  return 0;
+}
+
+int JdocsServer::StartUpgrade(int fd) {
+  // 新进程连接后应立即发送请求，避免阻塞master线程
+  struct timeval tv = {1, 0};
+  setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+  uint32_t type;
+  std::string payload;
+  std::vector<int> fds;
+  bool connections = false;
+  int ret = upgrade_recv(fd, &type, &payload, &fds);
+  for (int passed : fds)
+    close(passed);
+  if (!ret && type == kUpgradeHello) {
+    try {
+      nlohmann::json hello = nlohmann::json::parse(payload);
+      connections = hello.at("connections").get<bool>();
+      // 监听套接字的接受方式需要一致，reuseport组中的套接字与worker线程一一对应
+      if (hello.at("accept_mode").get<uint32_t>() != config_.accept_mode ||
+          (config_.accept_mode == kAcceptModeReuseport &&
+           hello.at("workers").get<uint32_t>() != nr_threads_))
+        ret = -1;
+    } catch (const nlohmann::json::exception &) {
+      ret = -1;
+    }
+  } else {
+    ret = -1;
+  }
+  if (!ret) {
+    const int *listen_fds = &serv_fd_;
+    size_t nfds = 1;
+    if (config_.accept_mode == kAcceptModeReuseport) {
+      listen_fds = listen_fds_.data();
+      nfds = listen_fds_.size();
+    }
+    ret = upgrade_send(fd, kUpgradeListen, std::string(), listen_fds, nfds);
+  }
+  if (ret) {
+    spdlog::error("rejected an incompatible upgrade request");
+    upgrade_send(fd, kUpgradeEnd, std::string());
+    close(fd);
+    return -1;
+  }
+  // 新进程收到kUpgradeEnd后会在同一路径上重新创建unix套接字，这里只关闭不删除
+  close(upgrade_listen_fd_);
+  upgrade_listen_fd_ = -1;
+  upgrade_fd_ = fd;
+  if (!connections) {
+    FinishUpgrade();
+    return 0;
+  }
+  upgrade_docs_ = DocumentService::SnapshotDocuments();
+  return 1;
+}
+
+void JdocsServer::FinishUpgrade() {
+  // 新进程收到kUpgradeEnd后才开始恢复连接，此时用户会话引用的文档均已到达
+  for (auto &doc : upgrade_docs_)
+    upgrade_send(upgrade_fd_, kUpgradeDoc, DocumentService::SaveDocument(*doc));
+  spdlog::info("upgrade finished, sent {} documents", upgrade_docs_.size());
+  upgrade_docs_.clear();
+  upgrade_send(upgrade_fd_, kUpgradeEnd, std::string());
+  close(upgrade_fd_);
+  upgrade_fd_ = -1;
+}
+
+namespace {
+
+// 比较两个线程的负载，by_cpu为true时优先比较繁忙程度，否则优先比较连接数量
+inline bool less_loaded(worker_load *a, worker_load *b, bool by_cpu) {
+  int32_t conns_a = a->connections.load(std::memory_order_relaxed);
+  int32_t conns_b = b->connections.load(std::memory_order_relaxed);
+  uint32_t busy_a = a->busy.load(std::memory_order_relaxed);
+  uint32_t busy_b = b->busy.load(std::memory_order_relaxed);
+  if (by_cpu)
+    return busy_a < busy_b || (busy_a == busy_b && conns_a < conns_b);
+  return conns_a < conns_b || (conns_a == conns_b && busy_a < busy_b);
+}
+
+} // namespace
+
+uint32_t JdocsServer::DispatchConnection() {
+  uint32_t index = dispatch_count_++ % nr_threads_;
+  switch (config_.dispatch_policy) {
+  case kDispatchRoundRobin:
+    break;
+  case kDispatchLeastConn:
+  case kDispatchLeastCpu: {
+    // 从轮询位置开始查找，负载相同时不会总是选择编号较小的线程
+    bool by_cpu = config_.dispatch_policy == kDispatchLeastCpu;
+    uint32_t start = index;
+    for (uint32_t i = 1; i < nr_threads_; ++i) {
+      uint32_t other = (start + i) % nr_threads_;
+      if (less_loaded(worker_threads_[other].GetLoad(),
+                      worker_threads_[index].GetLoad(), by_cpu))
+        index = other;
+    }
+    break;
+  }
+  case kDispatchPowerOfTwo: {
+    if (nr_threads_ == 1)
+      break;
+    // xorshift32
+    dispatch_seed_ ^= dispatch_seed_ << 13;
+    dispatch_seed_ ^= dispatch_seed_ >> 17;
+    dispatch_seed_ ^= dispatch_seed_ << 5;
+    uint32_t first = dispatch_seed_ % nr_threads_;
+    uint32_t second = (dispatch_seed_ >> 16) % (nr_threads_ - 1);
+    if (second >= first)
+      ++second;
+    index = less_loaded(worker_threads_[second].GetLoad(),
+                        worker_threads_[first].GetLoad(), false)
+                ? second
+                : first;
+    break;
+  }
+  }
+  // 负载相同的情况下所选线程仍可能已满，此时按连接数量改选剩余槽位最多的线程
+  int32_t capacity = static_cast<int32_t>(config_.fd_table_size);
+  if (worker_threads_[index].GetLoad()->connections.load(
+          std::memory_order_relaxed) >= capacity) {
+    index = kNoWorker;
+    int32_t fewest = capacity;
+    for (uint32_t i = 0; i < nr_threads_; ++i) {
+      int32_t conns = worker_threads_[i].GetLoad()->connections.load(
+          std::memory_order_relaxed);
+      if (conns < fewest) {
+        fewest = conns;
+        index = i;
+      }
+    }
+    if (index == kNoWorker)
+      return kNoWorker;
+  }
+  worker_threads_[index].ReserveConnection();
+  return index;
+}
+
+bool JdocsServer::WorkersAbove(uint32_t percent) {
+  uint64_t threshold = uint64_t(config_.fd_table_size) * percent / 100;
+  for (uint32_t i = 0; i < nr_threads_; ++i) {
+    int32_t conns = worker_threads_[i].GetLoad()->connections.load(
+        std::memory_order_relaxed);
+    if (static_cast<uint64_t>(conns) < threshold)
+      return false;
+  }
+  return true;
+}
+
 std::unordered_map<uint32_t, uint32_t> JdocsServer::user_map_;
 std::shared_mutex JdocsServer::mutex_;
 
@@ -3,17 +3,24 @@
 #ifndef JDOCS_CORE_SERVER_H_
 #define JDOCS_CORE_SERVER_H_
 
+#include <memory>
 #include <shared_mutex>
 #include <unordered_map>
+#include <vector>
 
+#include "compute_pool.h"
+#include "config.h"
 #include "event_loop.h"
+#include "upgrade.h"
 #include "worker.h"
 
 namespace jdocs {
 
+class Document;
+
 class JdocsServer {
 public:
-  JdocsServer(int port);
+  explicit JdocsServer(const ServerConfig &config);
   ~JdocsServer();
 
   JdocsServer(const JdocsServer &) = delete;
@@ -21,19 +28,63 @@ public:
 
   int Run();
 
+  inline const ServerConfig &GetConfig() const { return config_; }
+
+  // 连接id中携带着所属worker线程的编号
   inline int ConnectionIdToRingFd(uint32_t conn_id) {
-    return worker_threads_[(conn_id - 1) % nr_threads_]
-        .GetRingInstance()
-        ->ring_fd;
+    return GetWorkerRingFd(conn_id_to_worker(conn_id));
+  }
+
+  inline int GetWorkerRingFd(uint32_t index) {
+    return worker_threads_[index].GetRingInstance()->ring_fd;
   }
 
-  inline uint32_t GetNextConnectionId() const { return conn_count_; }
+  inline EventLoop *GetWorkerEventLoop(uint32_t index) {
+    return worker_threads_[index].GetEventLoop();
+  }
 
-  inline struct io_uring *GetNextRingInstance() {
-    return worker_threads_[(conn_count_++ % nr_threads_)].GetRingInstance();
+  // 按分配策略为新连接选择worker线程，计入其负载并返回其编号
+  // 连接id由worker线程收到连接后在其连接表中分配
+  // 所选线程的直接文件描述符表已满时改选其他线程，全部已满时返回kNoWorker
+  uint32_t DispatchConnection();
+  // 连接未能传递给编号为index的worker线程，撤销分配时计入的负载
+  inline void CancelDispatch(uint32_t index) {
+    worker_threads_[index].GetLoad()->connections.fetch_sub(
+        1, std::memory_order_relaxed);
   }
+  // 所有worker线程的直接文件描述符表占用率均不低于percent时返回true
+  bool WorkersAbove(uint32_t percent);
   inline int GetListeningFd() const { return serv_fd_; }
 
+  // reuseport模式下编号为index的worker线程的监听套接字
+  inline int GetListeningFd(uint32_t index) const {
+    return listen_fds_[index];
+  }
+
+  inline unsigned int GetWorkerCount() const { return nr_threads_; }
+
+  // master线程io_uring实例的文件描述符，用于共享内核轮询线程
+  inline int GetMasterRingFd() {
+    return event_loop_.GetRingInstance()->ring_fd;
+  }
+
+  // 新进程的热升级连接，worker线程通过它向新进程发送移交的连接
+  inline int GetUpgradeFd() const { return upgrade_fd_; }
+
+  // 由master线程调用，接受新进程的热升级请求
+  // 拒绝时返回-1，新进程不接管连接时返回0，需要移交连接时返回1
+  int StartUpgrade(int fd);
+  // 所有worker线程移交完毕后发送打开的文档，结束热升级
+  void FinishUpgrade();
+
+  // 由编号为index的worker线程在事件循环开始前取走分配给它的移交连接
+  inline std::vector<upgrade_conn> TakeRestoredConnections(uint32_t index) {
+    return std::move(restored_conns_[index]);
+  }
+
+  // 执行耗时文档计算的线程池，compute_threads为0时返回nullptr
+  inline ComputePool *GetComputePool() { return compute_pool_.get(); }
+
   // 通过用户id获取对应的连接id，不存在则返回0
   static uint32_t GetConnectionId(uint32_t user_id);
   // 添加连接id到连接对象的映射
@@ -42,18 +93,38 @@ public:
   static void DelUserSession(uint32_t user_id);
 
 private:
+  // reuseport模式下为每个worker线程创建监听套接字，并设置连接引导方式
+  int SetUpReuseport(const std::vector<int> &cpus);
+  // 新进程从旧进程接收监听套接字、连接与文档，docs在worker线程恢复连接前持有文档
+  int ReceiveUpgrade(std::vector<std::shared_ptr<Document>> *docs);
+
+  // 需在事件循环之前初始化，事件循环构造时会读取配置
+  ServerConfig config_;
   EventLoop event_loop_;
-  int serv_fd_;
+  int serv_fd_{-1};
+  // 接收退出信号的signalfd
+  int signal_fd_{-1};
+  // reuseport模式下每个worker线程各自的监听套接字
+  std::vector<int> listen_fds_;
+  // 接受热升级请求的unix套接字，以及正在进行的热升级连接
+  int upgrade_listen_fd_{-1};
+  int upgrade_fd_{-1};
+  // 新进程中按worker线程编号分配的移交连接
+  std::vector<std::vector<upgrade_conn>> restored_conns_;
+  // 旧进程中等待发送给新进程的文档
+  std::vector<std::shared_ptr<Document>> upgrade_docs_;
   // 每个worker线程保存connection_id到TcpConnection实例的映射
   // 而server主线程保存user_id到connection_id的映射
   static std::unordered_map<uint32_t, uint32_t> user_map_;
 
   std::vector<Worker> worker_threads_;
+  // 需在worker线程之后声明，先于worker线程销毁
+  std::unique_ptr<ComputePool> compute_pool_;
   unsigned int nr_threads_;
-  // 为每个新连接设置一个唯一的连接id，
-  // 通过使用连接id %
-  // nr_threads_获取该连接所处于的工作线程，方便向工作线程的io_uring实例发送请求
-  uint32_t conn_count_{0};
+  // 轮询分配的计数，同时作为其他策略在负载相同时的起始位置
+  uint32_t dispatch_count_{0};
+  // p2c策略所使用的随机数状态
+  uint32_t dispatch_seed_{0x9E3779B9};
 
   static std::shared_mutex mutex_;
 };
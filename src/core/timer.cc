@@ -2,19 +2,17 @@
 
 #include "timer.h"
 
+#include <algorithm>
+
 #include "utils/helpers.h"
 
 namespace jdocs {
 
-TimeWheel::TimeWheel(uint32_t tick) : tick_(tick) {
-  clock_gettime(CLOCK_MONOTONIC, &next_timeout_);
-  start_millis_ = uint64_t(next_timeout_.tv_sec) * 1000 +
-                  uint64_t(next_timeout_.tv_nsec) / 1000000;
-  // 缓存下一次超时的绝对时间
-  for (uint32_t i = 0; i != TIME_CACHE_SIZE; ++i) {
-    timespec_add_millis(&next_timeout_, tick_);
-    timeout_cache_[i] = next_timeout_;
-  }
+TimeWheel::TimeWheel(uint32_t tick, bool tickless)
+    : tick_(tick), tickless_(tickless) {
+  clock_gettime(CLOCK_MONOTONIC, &start_ts_);
+  start_millis_ = uint64_t(start_ts_.tv_sec) * 1000 +
+                  uint64_t(start_ts_.tv_nsec) / 1000000;
 }
 
 void TimeWheel::timer_cancel(TimeWheel::timer_node *timer) {
@@ -35,7 +33,11 @@ void TimeWheel::AddTimer(TimeWheel::timer_node *timer, uint32_t millis) {
   uint32_t ticks = millis / tick_;
   if (ticks == 0)
     ticks = 1;
-  timer->expires_ = current_tick_ + ticks;
+  // tickless模式下当前刻度只在处理超时时推进，可能远落后于当前时间
+  uint64_t base = current_tick_;
+  if (tickless_)
+    base = std::max(base, (get_current_millis() - start_millis_) / tick_);
+  timer->expires_ = base + ticks;
   timer->flag = false;
   __timer_add(timer);
 }
@@ -72,15 +74,15 @@ void TimeWheel::__timer_cascade(TimeWheel::timer_head *tv, size_t index) {
   tv[index].first = nullptr;
   while (timer) {
     timer_node *next_timer = timer->next;
+    timer->next = nullptr;
+    timer->pprev = nullptr;
     __timer_add(timer);
     timer = next_timer;
   }
 }
 
 void TimeWheel::Tick() {
-  // 补充下一次超时的时间缓存
-  timespec_add_millis(&next_timeout_, tick_);
-  timeout_cache_[current_tick_++ & TIME_CACHE_MASK] = next_timeout_;
+  ++current_tick_;
 
   size_t index = current_tick_ & TIME_WHEEL_TVR_MASK;
   if (index == 0) {
@@ -105,9 +107,12 @@ void TimeWheel::Tick() {
   while (timer) {
     // 避免回调函数中修改了timer的next指针导致无法遍历链表
     timer_node *next_timer = timer->next;
+    // 已触发的节点不再属于任何槽位，槽位与相邻节点之后可能被复用，
+    // 清空链接后节点销毁时不会修改它们
+    timer->next = nullptr;
+    timer->pprev = nullptr;
     // 触发超时回调
-    timer->flag = true;
-    timer->callback_();
+    timer->Fire();
     timer = next_timer;
   }
 }
@@ -115,8 +120,114 @@ void TimeWheel::Tick() {
 void TimeWheel::Update() {
   uint64_t now = get_current_millis();
   uint64_t target_ticks = (now - start_millis_) / tick_;
-  while (current_tick_ < target_ticks)
+  while (current_tick_ < target_ticks) {
+    // 落后多个刻度时，直接跳到下一个需要处理的刻度之前
+    if (target_ticks - current_tick_ > 1)
+      current_tick_ = std::min(NextExpiry(), target_ticks) - 1;
     Tick();
+  }
+}
+
+uint64_t TimeWheel::NextExpiry() const {
+  uint64_t next = UINT64_MAX;
+  // 第一层中的计时器均在之后的TVR_SIZE个刻度内到期，槽位与到期刻度一一对应
+  for (uint64_t t = current_tick_ + 1; t != current_tick_ + TIME_WHEEL_TVR_SIZE;
+       ++t) {
+    if (tv1[t & TIME_WHEEL_TVR_MASK].first) {
+      next = t;
+      break;
+    }
+  }
+  // 较高层级的槽位在其起始刻度迁移到较低层级，只需找到每层中最近的非空槽位
+  const timer_head *levels[] = {tv2, tv3, tv4, tv5};
+  for (uint32_t i = 0; i != 4; ++i) {
+    uint32_t shift = TIME_WHEEL_TVR_BITS + TIME_WHEEL_TVN_BITS * i;
+    uint64_t base = current_tick_ >> shift;
+    for (uint64_t k = 1; k <= TIME_WHEEL_TVN_SIZE; ++k) {
+      if (((base + k) << shift) >= next)
+        break;
+      if (levels[i][(base + k) & TIME_WHEEL_TVN_MASK].first) {
+        next = (base + k) << shift;
+        break;
+      }
+    }
+  }
+  return next;
+}
+
+void TimeWheel::TickToTimespec(uint64_t tick, timespec *ts) const {
+  *ts = start_ts_;
+  timespec_add_millis(ts, tick * tick_);
+}
+
+void TimerHeap::Add(timer_node *timer, uint64_t deadline_nanos) {
+  timer->deadline_ = deadline_nanos;
+  if (timer->heap_) {
+    sift_up(timer->index_);
+    sift_down(timer->index_);
+    return;
+  }
+  timer->heap_ = this;
+  nodes_.push_back(timer);
+  timer->index_ = static_cast<uint32_t>(nodes_.size() - 1);
+  sift_up(timer->index_);
+}
+
+void TimerHeap::Cancel(timer_node *timer) {
+  if (timer->heap_ != this)
+    return;
+  uint32_t index = timer->index_;
+  timer_node *last = nodes_.back();
+  nodes_.pop_back();
+  timer->heap_ = nullptr;
+  if (last == timer)
+    return;
+  // 以最后一个节点填补空位，再按其到期时间调整位置
+  place(last, index);
+  sift_up(index);
+  sift_down(last->index_);
+}
+
+size_t TimerHeap::Run(uint64_t now_nanos) {
+  size_t count = 0;
+  // 回调中可能添加新的计时器，每次都重新检查堆顶
+  while (!nodes_.empty() && nodes_[0]->deadline_ <= now_nanos) {
+    timer_node *timer = nodes_[0];
+    Cancel(timer);
+    timer->func_(timer->owner_);
+    ++count;
+  }
+  return count;
+}
+
+void TimerHeap::sift_up(uint32_t index) {
+  timer_node *timer = nodes_[index];
+  while (index) {
+    uint32_t parent = (index - 1) / 2;
+    if (nodes_[parent]->deadline_ <= timer->deadline_)
+      break;
+    place(nodes_[parent], index);
+    index = parent;
+  }
+  place(timer, index);
+}
+
+void TimerHeap::sift_down(uint32_t index) {
+  timer_node *timer = nodes_[index];
+  uint32_t size = static_cast<uint32_t>(nodes_.size());
+  for (;;) {
+    uint32_t child = index * 2 + 1;
+    if (child >= size)
+      break;
+    if (child + 1 < size &&
+        nodes_[child + 1]->deadline_ < nodes_[child]->deadline_)
+      ++child;
+    if (timer->deadline_ <= nodes_[child]->deadline_)
+      break;
+    place(nodes_[child], index);
+    index = child;
+  }
+  place(timer, index);
 }
 
 } // namespace jdocs
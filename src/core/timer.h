@@ -5,6 +5,8 @@
 
 #include <cstdint>
 #include <functional>
+#include <utility>
+#include <vector>
 
 #include <time.h>
 
@@ -19,16 +21,14 @@ namespace {
 #define TIME_WHEEL_TVN_SIZE (1 << TIME_WHEEL_TVN_BITS)
 #define TIME_WHEEL_TVN_MASK (TIME_WHEEL_TVN_SIZE - 1)
 
-#define TIME_CACHE_SIZE (1 << 2)
-#define TIME_CACHE_MASK (TIME_CACHE_SIZE - 1)
-
 } // namespace
 
 class TimeWheel {
 public:
   using TimerCallBack = std::function<void()>;
   // 时间轮间隔，单位毫秒
-  TimeWheel(uint32_t tick = 100);
+  // tickless模式下不再周期性调用Tick，添加计时器时以当前时间而非当前刻度为起点
+  TimeWheel(uint32_t tick = 100, bool tickless = false);
   ~TimeWheel() = default;
 
   TimeWheel(const TimeWheel &) = delete;
@@ -36,27 +36,55 @@ public:
   TimeWheel(TimeWheel &&) = default;
   TimeWheel &operator=(TimeWheel &&) = default;
 
+  // 侵入式的计时器节点，嵌入在所属对象中，回调为函数指针及其参数，不产生内存分配
   struct timer_node {
-    uint64_t expires_;
-    TimerCallBack callback_;
-    timer_node *next, **pprev;
-    bool flag;
+    using func_t = void (*)(void *);
+
+    uint64_t expires_{0};
+    timer_node *next{nullptr}, **pprev{nullptr};
+    func_t func_;
+    void *owner_;
+    bool flag{false};
+
+    timer_node(func_t func, void *owner) : func_(func), owner_(owner) {}
+    // 兼容std::function形式的回调，回调对象在堆上分配
     timer_node(TimerCallBack callback)
-        : expires_(0), callback_(std::move(callback)), next(nullptr),
-          pprev(nullptr), flag(false) {}
+        : func_(&call_function),
+          owner_(new TimerCallBack(std::move(callback))) {}
     // 防止对象销毁后破坏链表结构
     ~timer_node() {
       if (pprev)
         *pprev = next;
       if (next)
         next->pprev = pprev;
+      if (func_ == &call_function)
+        delete static_cast<TimerCallBack *>(owner_);
     }
     timer_node(const timer_node &) = delete;
     timer_node &operator=(const timer_node &) = delete;
-    timer_node(timer_node &&) = default;
-    timer_node &operator=(timer_node &&) = default;
+    // 只转移回调，新节点不在时间轮中
+    timer_node(timer_node &&other) noexcept
+        : expires_(other.expires_), func_(std::exchange(other.func_, nullptr)),
+          owner_(std::exchange(other.owner_, nullptr)), flag(other.flag) {}
+    timer_node &operator=(timer_node &&) = delete;
+
+    // 以所属对象的成员函数作为回调，如timer_node::Bind<&T::OnTimeout>(this)
+    template <auto Method, typename T> static timer_node Bind(T *owner) {
+      return timer_node([](void *p) { (static_cast<T *>(p)->*Method)(); },
+                        owner);
+    }
 
     inline bool IsFired() const { return flag; }
+
+    inline void Fire() {
+      flag = true;
+      func_(owner_);
+    }
+
+  private:
+    static void call_function(void *callback) {
+      (*static_cast<TimerCallBack *>(callback))();
+    }
   };
 
   static void timer_cancel(timer_node *timer);
@@ -64,17 +92,20 @@ public:
   // 添加一个n毫秒的计时器
   void AddTimer(timer_node *timer, uint32_t millis);
 
-  inline timespec *GetNextTimeout() { return &next_timeout_; }
-
-  inline timespec *GetTimeoutCache(uint32_t *size) {
-    *size = TIME_CACHE_SIZE;
-    return timeout_cache_;
-  }
-
   void Tick();
 
+  // 推进到当前时间对应的刻度，中间没有计时器到期或迁移的刻度被整体跳过
   void Update();
 
+  // 下一个需要处理的刻度，即最早到期的计时器，或较高层级中有计时器的槽位迁移的刻度
+  // 后者不晚于其中计时器的到期刻度，没有计时器时返回UINT64_MAX
+  uint64_t NextExpiry() const;
+
+  // 刻度tick开始时的绝对时间
+  void TickToTimespec(uint64_t tick, timespec *ts) const;
+
+  inline uint64_t GetCurrentTick() const { return current_tick_; }
+
 private:
   struct timer_head {
     timer_node *first{nullptr};
@@ -99,12 +130,78 @@ private:
   timer_head tv4[TIME_WHEEL_TVN_SIZE];
   timer_head tv5[TIME_WHEEL_TVN_SIZE];
 
-  timespec timeout_cache_[TIME_CACHE_SIZE];
-  timespec next_timeout_;
+  timespec start_ts_;
 
   uint64_t current_tick_{0};
   uint64_t start_millis_;
   uint32_t tick_;
+  bool tickless_;
+};
+
+// 高精度计时器，按单调时钟的纳秒到期时间保存在最小堆中，只能由单个线程使用
+// 用于远小于时间轮刻度的短延迟，例如合并消息的时间窗口与发送截止时间
+class TimerHeap {
+public:
+  struct timer_node {
+    using func_t = void (*)(void *);
+
+    uint64_t deadline_{0};
+    func_t func_;
+    void *owner_;
+    // 所在的堆及其在堆中的下标，不在堆中时为nullptr
+    TimerHeap *heap_{nullptr};
+    uint32_t index_{0};
+
+    timer_node(func_t func, void *owner) : func_(func), owner_(owner) {}
+    ~timer_node() {
+      if (heap_)
+        heap_->Cancel(this);
+    }
+    timer_node(const timer_node &) = delete;
+    timer_node &operator=(const timer_node &) = delete;
+
+    // 以所属对象的成员函数作为回调，如timer_node::Bind<&T::OnTimeout>(this)
+    template <auto Method, typename T> static timer_node Bind(T *owner) {
+      return timer_node([](void *p) { (static_cast<T *>(p)->*Method)(); },
+                        owner);
+    }
+
+    inline bool IsPending() const { return heap_ != nullptr; }
+  };
+
+  TimerHeap() = default;
+  ~TimerHeap() {
+    for (timer_node *timer : nodes_)
+      timer->heap_ = nullptr;
+  }
+
+  TimerHeap(const TimerHeap &) = delete;
+  TimerHeap &operator=(const TimerHeap &) = delete;
+
+  // 添加计时器，已在堆中时修改其到期时间
+  void Add(timer_node *timer, uint64_t deadline_nanos);
+
+  void Cancel(timer_node *timer);
+
+  // 最早的到期时间，没有计时器时返回UINT64_MAX
+  inline uint64_t NextDeadline() const {
+    return nodes_.empty() ? UINT64_MAX : nodes_[0]->deadline_;
+  }
+
+  // 按到期时间顺序触发所有不晚于now_nanos的计时器，返回触发的数量
+  size_t Run(uint64_t now_nanos);
+
+  inline size_t size() const { return nodes_.size(); }
+
+private:
+  void sift_up(uint32_t index);
+  void sift_down(uint32_t index);
+  inline void place(timer_node *timer, uint32_t index) {
+    nodes_[index] = timer;
+    timer->index_ = index;
+  }
+
+  std::vector<timer_node *> nodes_;
 };
 
 } // namespace jdocs
@@ -0,0 +1,162 @@
+// Copyright (c) 2025-2026 Juantgd. All Rights Reserved.
+
+#include "upgrade.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <mutex>
+
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <spdlog/spdlog.h>
+
+namespace jdocs {
+
+namespace {
+// 单个数据包的最大载荷，需小于unix套接字的默认发送缓冲区大小
+constexpr size_t kUpgradeChunkSize = 32 * 1024;
+// 单个数据包最多附带的文件描述符数量，与内核的SCM_MAX_FD一致
+constexpr size_t kUpgradeMaxFds = 253;
+
+struct upgrade_packet_header {
+  uint32_t type;
+  // 非0表示该消息还有后续数据包
+  uint32_t more;
+};
+
+// 保证同一条消息的数据包连续发送
+std::mutex send_mutex;
+
+int make_address(const std::string &path, struct sockaddr_un *addr) {
+  if (path.size() >= sizeof(addr->sun_path)) {
+    spdlog::error("upgrade socket path too long: {}", path);
+    return -1;
+  }
+  memset(addr, 0, sizeof(struct sockaddr_un));
+  addr->sun_family = AF_UNIX;
+  memcpy(addr->sun_path, path.data(), path.size());
+  return 0;
+}
+} // namespace
+
+int create_upgrade_socket(const std::string &path) {
+  struct sockaddr_un addr;
+  if (make_address(path, &addr))
+    return -1;
+  int fd = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+  if (fd < 0) {
+    spdlog::error("create upgrade socket failed. error: {}", strerror(errno));
+    return -1;
+  }
+  unlink(path.c_str());
+  if (bind(fd, reinterpret_cast<struct sockaddr *>(&addr), sizeof(addr)) < 0 ||
+      listen(fd, 1) < 0) {
+    spdlog::error("listen on {} failed. error: {}", path, strerror(errno));
+    close(fd);
+    return -1;
+  }
+  return fd;
+}
+
+int connect_upgrade_socket(const std::string &path) {
+  struct sockaddr_un addr;
+  if (make_address(path, &addr))
+    return -1;
+  int fd = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+  if (fd < 0) {
+    spdlog::error("create upgrade socket failed. error: {}", strerror(errno));
+    return -1;
+  }
+  if (connect(fd, reinterpret_cast<struct sockaddr *>(&addr), sizeof(addr)) <
+      0) {
+    spdlog::error("connect to {} failed. error: {}", path, strerror(errno));
+    close(fd);
+    return -1;
+  }
+  return fd;
+}
+
+int upgrade_send(int sock, uint32_t type, const std::string &payload,
+                 const int *fds, size_t nfds) {
+  if (nfds > kUpgradeMaxFds) {
+    spdlog::error("too many fds in one upgrade message: {}", nfds);
+    return -1;
+  }
+  std::lock_guard<std::mutex> lock(send_mutex);
+  size_t offset = 0;
+  do {
+    size_t length = std::min(payload.size() - offset, kUpgradeChunkSize);
+    upgrade_packet_header header{type, offset + length < payload.size()};
+    struct iovec iov[2] = {
+        {&header, sizeof(header)},
+        {const_cast<char *>(payload.data()) + offset, length}};
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = iov;
+    msg.msg_iovlen = 2;
+    // 文件描述符只随第一个数据包发送
+    std::vector<char> control;
+    if (offset == 0 && nfds) {
+      control.resize(CMSG_SPACE(sizeof(int) * nfds));
+      msg.msg_control = control.data();
+      msg.msg_controllen = control.size();
+      struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+      cmsg->cmsg_level = SOL_SOCKET;
+      cmsg->cmsg_type = SCM_RIGHTS;
+      cmsg->cmsg_len = CMSG_LEN(sizeof(int) * nfds);
+      memcpy(CMSG_DATA(cmsg), fds, sizeof(int) * nfds);
+    }
+    if (sendmsg(sock, &msg, MSG_NOSIGNAL) < 0) {
+      spdlog::error("send upgrade message failed. error: {}", strerror(errno));
+      return -1;
+    }
+    offset += length;
+  } while (offset < payload.size());
+  return 0;
+}
+
+int upgrade_recv(int sock, uint32_t *type, std::string *payload,
+                 std::vector<int> *fds) {
+  payload->clear();
+  fds->clear();
+  std::vector<char> buffer(sizeof(upgrade_packet_header) + kUpgradeChunkSize);
+  std::vector<char> control(CMSG_SPACE(sizeof(int) * kUpgradeMaxFds));
+  upgrade_packet_header header;
+  do {
+    struct iovec iov = {buffer.data(), buffer.size()};
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control.data();
+    msg.msg_controllen = control.size();
+    ssize_t n = recvmsg(sock, &msg, MSG_CMSG_CLOEXEC);
+    if (n < 0) {
+      spdlog::error("receive upgrade message failed. error: {}",
+                    strerror(errno));
+      return -1;
+    }
+    // 对端关闭或数据包不完整
+    if (static_cast<size_t>(n) < sizeof(header)) {
+      spdlog::error("upgrade peer closed unexpectedly");
+      return -1;
+    }
+    for (struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg); cmsg;
+         cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+      if (cmsg->cmsg_level != SOL_SOCKET || cmsg->cmsg_type != SCM_RIGHTS)
+        continue;
+      size_t count = (cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+      const int *data = reinterpret_cast<const int *>(CMSG_DATA(cmsg));
+      fds->insert(fds->end(), data, data + count);
+    }
+    memcpy(&header, buffer.data(), sizeof(header));
+    payload->append(buffer.data() + sizeof(header), n - sizeof(header));
+  } while (header.more);
+  *type = header.type;
+  return 0;
+}
+
+} // namespace jdocs
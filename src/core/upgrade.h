@@ -0,0 +1,51 @@
+// Copyright (c) 2025-2026 Juantgd. All Rights Reserved.
+
+#ifndef JDOCS_CORE_UPGRADE_H_
+#define JDOCS_CORE_UPGRADE_H_
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace jdocs {
+
+// 热升级时新旧进程之间通过SOCK_SEQPACKET类型的unix套接字交换的消息类型
+// 新进程连接后发送kUpgradeHello，旧进程依次回复监听套接字、移交的连接、
+// 打开的文档，最后以kUpgradeEnd结束
+enum upgrade_msg_t : uint32_t {
+  // 载荷为json，包含是否接管现有连接、连接接受方式以及worker线程数量
+  kUpgradeHello = 1,
+  // 附带全部监听套接字，reuseport模式下按worker线程编号排列
+  kUpgradeListen,
+  // 载荷为连接状态，附带该连接的文件描述符
+  kUpgradeConn,
+  // 载荷为文档内容
+  kUpgradeDoc,
+  kUpgradeEnd
+};
+
+// 新进程收到的移交连接，fd为普通文件描述符
+struct upgrade_conn {
+  int fd;
+  std::string state;
+};
+
+// 在path上创建接收热升级请求的unix套接字，已存在的同名文件会被删除
+// 失败时返回-1
+int create_upgrade_socket(const std::string &path);
+
+// 连接正在运行的旧进程，失败时返回-1
+int connect_upgrade_socket(const std::string &path);
+
+// 发送一条消息，较大的载荷会被拆分为多个数据包，文件描述符随第一个数据包发送
+// 可由多个线程同时调用，同一条消息的数据包不会交错，失败时返回-1
+int upgrade_send(int sock, uint32_t type, const std::string &payload,
+                 const int *fds = nullptr, size_t nfds = 0);
+
+// 接收一条完整的消息，失败或对端关闭时返回-1
+int upgrade_recv(int sock, uint32_t *type, std::string *payload,
+                 std::vector<int> *fds);
+
+} // namespace jdocs
+
+#endif
@@ -4,17 +4,29 @@
 
 #include <spdlog/spdlog.h>
 
+#include "metrics.h"
+#include "server.h"
+#include "utils/numa.h"
+
 namespace jdocs {
 
-Worker::Worker(JdocsServer *server, std::string name)
-    : name_(std::move(name)), parent_(server) {
+Worker::Worker(JdocsServer *server, uint32_t index, int cpu)
+    : name_("worker-" + std::to_string(index)), index_(index), cpu_(cpu),
+      load_(std::make_unique<worker_load>()), parent_(server) {
   pthread_barrier_init(&barrier_, NULL, 2);
   pthread_create(&thread_, NULL, worker_main, this);
   pthread_barrier_wait(&barrier_);
 }
+// worker线程在平滑退出完成后结束事件循环
 Worker::~Worker() {
   pthread_join(thread_, NULL);
   pthread_barrier_destroy(&barrier_);
+  // 连接对象持有事件循环中的定时器，需先于事件循环销毁
+  // 平滑退出超时时连接中的发送数据可能仍被内核使用，不再释放
+  if (event_loop_ && event_loop_->drain_leaked())
+    (void)conn_table_.release();
+  else
+    conn_table_.reset();
   if (event_loop_)
     delete event_loop_;
 }
@@ -22,33 +34,41 @@ Worker::~Worker() {
 void *Worker::worker_main(void *arg) {
   pthread_setname_np(pthread_self(), "worker");
   Worker *worker = static_cast<Worker *>(arg);
+  Metrics::Register(worker->name_);
   JdocsServer *server = static_cast<JdocsServer *>(worker->parent_);
+  const ServerConfig &config = server->GetConfig();
+  // 需在分配任何线程数据之前完成绑定，
+  // 使缓冲池、时间轮以及连接表均分配在worker所在的NUMA节点上
+  if (worker->cpu_ >= 0 && bind_thread(worker->cpu_, config.numa_local))
+    spdlog::warn("{} runs unpinned.", worker->name_);
+  worker->conn_table_ = std::make_unique<Slab<TcpConnection>>(
+      config.fd_table_size, CONN_ID_HANDLE_BITS);
+  metrics_add(METRIC_FD_TABLE_SLOTS, config.fd_table_size);
   worker->event_loop_ = new EventLoop(server, worker, true);
+  worker->event_loop_->restore_connections(
+      server->TakeRestoredConnections(worker->index_));
   pthread_barrier_wait(&worker->barrier_);
   worker->event_loop_->Run();
   return NULL;
 }
 
-std::shared_ptr<TcpConnection> Worker::GetConnection(uint32_t conn_id) {
-  auto it = conn_map_.find(conn_id);
-  if (it != conn_map_.end()) {
-    return it->second;
-  }
-  return nullptr;
-}
-
-void Worker::AddConnection(uint32_t conn_id,
-                           std::shared_ptr<TcpConnection> connection) {
-  bool ret = conn_map_.insert({conn_id, std::move(connection)}).second;
-  if (!ret) {
-    spdlog::error("unordered_map insert failed.");
+TcpConnection *Worker::AddConnection(EventLoop *event_loop, int fd) {
+  uint32_t handle = conn_table_->Allocate();
+  if (!handle) {
+    spdlog::error("[{}] connection table is full.", name_);
+    load_->connections.fetch_sub(1, std::memory_order_relaxed);
+    return nullptr;
   }
+  TcpConnection *connection = conn_table_->Emplace(
+      handle, event_loop, fd, conn_id_encode(index_, handle));
+  metrics_add(METRIC_CONNECTIONS);
+  return connection;
 }
 
 void Worker::DelConnection(uint32_t conn_id) {
-  auto it = conn_map_.find(conn_id);
-  if (it != conn_map_.end()) {
-    conn_map_.erase(it);
+  if (conn_table_->Free(conn_id_to_handle(conn_id))) {
+    load_->connections.fetch_sub(1, std::memory_order_relaxed);
+    metrics_add(METRIC_CONNECTIONS, -1);
   }
 }
 
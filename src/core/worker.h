@@ -3,19 +3,31 @@
 #ifndef JDOCS_CORE_WORKER_H_
 #define JDOCS_CORE_WORKER_H_
 
+#include <atomic>
 #include <memory>
-#include <unordered_map>
-
 #include <pthread.h>
 
 #include "event_loop.h"
 #include "net/tcp_connection.h"
+#include "utils/slab.h"
 
 namespace jdocs {
 
+// worker线程的负载，由master线程读取用于分配新连接
+// DispatchConnection没有可用worker线程时的返回值
+constexpr uint32_t kNoWorker = UINT32_MAX;
+
+struct alignas(64) worker_load {
+  // 已分配给该线程且尚未关闭的连接数量
+  std::atomic<int32_t> connections{0};
+  // 事件循环最近处理完成事件的时间占比，单位千分之一
+  std::atomic<uint32_t> busy{0};
+};
+
 class Worker {
 public:
-  Worker(JdocsServer *server, std::string name);
+  // index为worker线程的编号，cpu为worker线程绑定的CPU，-1则不进行绑定
+  Worker(JdocsServer *server, uint32_t index, int cpu = -1);
   ~Worker();
 
   Worker(const Worker &) = delete;
@@ -24,28 +36,50 @@ public:
   Worker &operator=(Worker &&) = default;
 
   static void *worker_main(void *arg);
+  inline EventLoop *GetEventLoop() { return event_loop_; }
   inline struct io_uring *GetRingInstance() {
     return event_loop_->GetRingInstance();
   }
 
-  std::shared_ptr<TcpConnection> GetConnection(uint32_t conn_id);
+  // 连接不存在或连接id已过期时返回nullptr
+  inline TcpConnection *GetConnection(uint32_t conn_id) {
+    return conn_table_->Get(conn_id_to_handle(conn_id));
+  }
 
-  void AddConnection(uint32_t conn_id,
-                     std::shared_ptr<TcpConnection> connection);
+  // 为直接文件描述符fd建立连接对象并分配连接id，连接表已满时返回nullptr
+  TcpConnection *AddConnection(EventLoop *event_loop, int fd);
 
   void DelConnection(uint32_t conn_id);
 
   const std::string &GetName() const { return name_; }
 
+  inline uint32_t GetIndex() const { return index_; }
+
+  inline int GetCpu() const { return cpu_; }
+
+  // 将一个分配给本线程的新连接计入负载，连接建立失败时由AddConnection撤销
+  // master模式下由master线程在分发连接时调用，reuseport模式下由本线程调用
+  inline void ReserveConnection() {
+    load_->connections.fetch_add(1, std::memory_order_relaxed);
+  }
+
+  inline worker_load *GetLoad() { return load_.get(); }
+
+  inline Slab<TcpConnection> *GetConnectionTable() { return conn_table_.get(); }
+
 private:
   pthread_t thread_;
   pthread_barrier_t barrier_;
   std::string name_;
+  uint32_t index_;
+  int cpu_;
+  std::unique_ptr<worker_load> load_;
   EventLoop *event_loop_;
   JdocsServer *parent_;
 
-  // 保存着connection_id到TcpConnection类实例的映射
-  std::unordered_map<uint32_t, std::shared_ptr<TcpConnection>> conn_map_;
+  // 本线程的连接表，连接id的低位即为连接在表中的句柄
+  // 容量与直接文件描述符表相同，由worker线程绑定CPU后分配
+  std::unique_ptr<Slab<TcpConnection>> conn_table_;
 };
 
 } // namespace jdocs
@@ -1,9 +1,27 @@
 // Copyright (c) 2025-2026 Juantgd. All Rights Reserved.
 
+#include <cstdio>
+#include <cstring>
+
+#include "core/config.h"
 #include "core/server.h"
+#include "utils/helpers.h"
+#include "utils/logger.h"
 
-int main() {
-  jdocs::JdocsServer server(7788);
+int main(int argc, char *argv[]) {
+  if (argc > 1 && strcmp(argv[1], "--help") == 0) {
+    printf("%s", jdocs::ServerConfig::Usage().c_str());
+    return 0;
+  }
+  jdocs::ServerConfig config;
+  if (!config.ParseArgs(argc, argv))
+    return EXIT_FAILURE;
+  // 在启动任何线程之前屏蔽退出信号，由master线程统一处理以平滑退出
+  jdocs::block_exit_signals();
+  // 启动异步日志，热路径上的日志调用不再同步输出
+  jdocs::AsyncLogger::Start();
+  jdocs::JdocsServer server(config);
   server.Run();
+  jdocs::AsyncLogger::Stop();
   return 0;
 }
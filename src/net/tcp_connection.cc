@@ -2,27 +2,108 @@
 
 #include "tcp_connection.h"
 
+#include <cerrno>
+#include <cstring>
+
+#include <nlohmann/json.hpp>
 #include <spdlog/spdlog.h>
 
+#include "core/metrics.h"
 #include "core/server.h"
 #include "protocol/http/http_handler.h"
 #include "protocol/websocket/websocket_handler.h"
 #include "services/chat/chat_service.h"
 #include "services/document/document_service.h"
+#include "utils/logger.h"
 
 namespace jdocs {
 
+namespace {
+// 任何策略下发送队列超出预算的倍数后关闭连接，限制无法丢弃的消息占用的内存
+constexpr uint64_t kSendQueueHardCap = 4;
+} // namespace
+
 TcpConnection::TcpConnection(EventLoop *event_loop, int fd, uint32_t conn_id)
     : fd_(fd), conn_id_(conn_id),
       protocol_handler_(std::make_unique<HttpHandler>(this)),
       event_loop_(event_loop) {}
 
+TcpConnection::~TcpConnection() {
+  wake_send_waiters(true);
+  metrics_add(METRIC_SEND_QUEUE_BYTES,
+              -static_cast<int64_t>(send_queue_bytes()));
+}
+
 void TcpConnection::close() {
   if (closed_)
     return;
   if (user_id_)
     JdocsServer::DelUserSession(user_id_);
   closed_ = !event_loop_->submit_cancel(fd_, conn_id_);
+  wake_send_waiters(true);
+}
+
+void TcpConnection::CloseAfterFlush() {
+  if (closed_)
+    return;
+  if (!send_queue_bytes() && !send_inflight_) {
+    close();
+    return;
+  }
+  close_after_flush_ = true;
+}
+
+void TcpConnection::shutdown() {
+  if (closed_ || handing_off_)
+    return;
+  protocol_handler_->ShutdownHandle();
+}
+
+bool TcpConnection::handoff_ready() const {
+  return !closed_ && stage_ == kConnStageWebsocket && !send_queue_bytes() &&
+         !send_pending() && service_handler_ && service_handler_->Idle() &&
+         protocol_handler_->Idle();
+}
+
+std::string TcpConnection::save_state() {
+  nlohmann::json j;
+  j["path"] = service_path_;
+  j["args"] = service_args_;
+  j["state"] = service_handler_->SaveState();
+  return j.dump();
+}
+
+bool TcpConnection::restore_state(const std::string &data) {
+  try {
+    nlohmann::json j = nlohmann::json::parse(data);
+    transition_stage(kConnStageWebsocket);
+    auto args = j.at("args").get<decltype(service_args_)>();
+    return switch_service(j.at("path").get<std::string>(), std::move(args)) &&
+           service_handler_->RestoreState(j.at("state").get<std::string>());
+  } catch (const nlohmann::json::exception &e) {
+    spdlog::error("restore connection failed. error: {}", e.what());
+    return false;
+  }
+}
+
+void TcpConnection::detach() {
+  if (user_id_)
+    JdocsServer::DelUserSession(user_id_);
+  closed_ = true;
+}
+
+// 延迟模式下定时器添加后仍有数据到达时，只按剩余的时间重新添加
+// 时间轮的触发时间可能提前不到一个刻度，剩余时间不足一个刻度时视为已超时
+void TcpConnection::idle_timeout() {
+  const ServerConfig &config = event_loop_->GetConfig();
+  uint32_t timeout = config.conn_idle_timeout;
+  uint64_t idle = event_loop_->NowMillis() - last_active_;
+  if (config.idle_lazy && idle + config.timer_tick < timeout) {
+    metrics_add(METRIC_IDLE_REARMS);
+    event_loop_->AddTimer(&idle_timer_, static_cast<uint32_t>(timeout - idle));
+    return;
+  }
+  protocol_handler_->TimeoutHandle();
 }
 
 void TcpConnection::SendHandle(size_t length) {
@@ -30,6 +111,122 @@ void TcpConnection::SendHandle(size_t length) {
     return;
   // 检查所有数据是否已经发送完毕，否则继续提交发送请求
   send_bytes_ += length;
+  metrics_add(METRIC_SEND_BYTES, static_cast<int64_t>(length));
+  ++sends_done_;
+  if (send_waiters_)
+    wake_send_waiters(false);
+}
+
+char *TcpConnection::ReserveSend(size_t length, bool droppable) {
+  if (closed_)
+    return nullptr;
+  const ServerConfig &config = event_loop_->GetConfig();
+  uint64_t queued = send_queue_bytes() + length;
+  if (queued > config.send_queue_budget) {
+    if (config.slow_consumer == kSlowConsumerDrop && droppable) {
+      metrics_add(METRIC_SEND_QUEUE_DROPS);
+      return nullptr;
+    }
+    if (config.slow_consumer == kSlowConsumerDisconnect ||
+        queued > kSendQueueHardCap * config.send_queue_budget) {
+      spdlog::warn("conn_id: {} send queue over budget, closing", conn_id_);
+      metrics_add(METRIC_SLOW_CONSUMER_CLOSES);
+      close();
+      return nullptr;
+    }
+    // 对端读取过慢，暂停接收其请求，避免其请求产生的回复继续堆积
+    if (config.slow_consumer == kSlowConsumerWait && !recv_paused_) {
+      recv_paused_ = true;
+      metrics_add(METRIC_RECV_PAUSES);
+      event_loop_->cancel_recv(fd_, conn_id_, recv_group_);
+    }
+  }
+  size_t size = pending_.size();
+  pending_.resize(size + length);
+  queue_bytes_in_ += length;
+  metrics_add(METRIC_SEND_QUEUE_BYTES, static_cast<int64_t>(length));
+  return pending_.data() + size;
+}
+
+void TcpConnection::FlushSend(bool link) {
+  if (closed_ || send_inflight_)
+    return;
+  if (sending_offset_ == sending_.size()) {
+    // 零拷贝发送的通知到达前内核仍在引用正在发送的数据，不能交换
+    if (pending_.empty() || zc_notifs_)
+      return;
+    // 交换后复用已发送完的内存，突发流量留下的大块内存不再保留
+    sending_.swap(pending_);
+    sending_offset_ = 0;
+    pending_.clear();
+    if (pending_.capacity() > event_loop_->GetConfig().send_queue_budget)
+      pending_.shrink_to_fit();
+  }
+  send_inflight_ = true;
+  event_loop_->prep_send_queued(fd_, conn_id_,
+                                sending_.data() + sending_offset_,
+                                sending_.size() - sending_offset_, link);
+}
+
+void TcpConnection::SendQueueHandle(int res, bool notify) {
+  send_inflight_ = false;
+  if (notify)
+    ++zc_notifs_;
+  if (closed_)
+    return;
+  if (res < 0) {
+    // 对端已关闭或重置连接
+    if (res != -ECANCELED)
+      JDOCS_LOG_DEBUG("conn_id: {} send failed. error: {}", conn_id_,
+                      strerror(-res));
+    close();
+    return;
+  }
+  size_t length = static_cast<size_t>(res);
+  if (length < sending_.size() - sending_offset_)
+    metrics_add(METRIC_SEND_SHORT_WRITES);
+  sending_offset_ += length;
+  send_bytes_ += length;
+  queue_bytes_out_ += length;
+  metrics_add(METRIC_SEND_BYTES, static_cast<int64_t>(length));
+  metrics_add(METRIC_SEND_QUEUE_BYTES, -static_cast<int64_t>(length));
+  if (send_waiters_)
+    wake_send_waiters(false);
+  // 队列回落到预算的一半以下后恢复接收，留出余量避免频繁暂停与恢复
+  if (recv_paused_ &&
+      send_queue_bytes() <= event_loop_->GetConfig().send_queue_budget / 2) {
+    recv_paused_ = false;
+    event_loop_->prep_recv(fd_, conn_id_, recv_group_);
+  }
+  if (close_after_flush_ && !send_queue_bytes()) {
+    close();
+    return;
+  }
+  FlushSend();
+}
+
+void TcpConnection::SendQueueNotify() {
+  if (zc_notifs_)
+    --zc_notifs_;
+  if (!zc_notifs_ && !send_inflight_)
+    FlushSend();
+}
+
+// 等待方按目标从小到大排列，遇到尚未到达目标的等待方即可停止
+void TcpConnection::wake_send_waiters(bool all) {
+  while (send_waiters_ && (all || send_waiters_->reached())) {
+    SendAwaiter *waiter = send_waiters_;
+    waiter->unlink();
+    waiter->ok_ = !all;
+    event_loop_->Post(waiter->waiter_);
+  }
+}
+
+void TcpConnection::SendMessage(const std::string &message) {
+  if (closed_ || stage_ != kConnStageWebsocket)
+    return;
+  WebSocketHandler::send_data_frame(
+      this, const_cast<char *>(message.data()), message.size());
 }
 
 // 读操作完成处理函数，传入已读取的缓冲区地址和读取的字节数
@@ -37,15 +234,17 @@ void TcpConnection::RecvHandle(void *buffer, size_t length) {
   if (closed_)
     return;
   recv_bytes_ += length;
+  metrics_add(METRIC_RECV_BYTES, static_cast<int64_t>(length));
   protocol_handler_->RecvDataHandle(buffer, length);
 }
 
 // 跨线程消息处函数
-void TcpConnection::CrossThreadMsgHandle(void *data, size_t length) {
+void TcpConnection::CrossThreadMsgHandle(void *data, size_t length,
+                                         bool droppable) {
   if (closed_)
     return;
   if (stage_ == kConnStageWebsocket) {
-    WebSocketHandler::send_data_frame(this, data, length);
+    WebSocketHandler::send_data_frame(this, data, length, droppable);
   }
 }
 
@@ -72,6 +271,8 @@ bool TcpConnection::switch_service(
     spdlog::error("user_id out of range, error: {}", e.what());
     return false;
   }
+  service_path_ = it1->first;
+  service_args_ = query_args;
   service_id_ = it1->second;
   switch (service_id_) {
   case kServiceNone:
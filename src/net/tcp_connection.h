@@ -3,6 +3,7 @@
 #ifndef JDOCS_NET_TCP_CONNECTION_H_
 #define JDOCS_NET_TCP_CONNECTION_H_
 
+#include <coroutine>
 #include <cstdint>
 #include <memory>
 #include <string>
@@ -16,7 +17,7 @@ namespace jdocs {
 class TcpConnection {
 public:
   explicit TcpConnection(EventLoop *event_loop, int fd, uint32_t conn_id);
-  virtual ~TcpConnection() = default;
+  virtual ~TcpConnection();
 
   // 不可拷贝，可移动
   TcpConnection(const TcpConnection &) = delete;
@@ -34,6 +35,7 @@ public:
   inline uint32_t user_id() const { return user_id_; }
 
   inline service_t GetServiceId() const { return service_id_; }
+  inline ServiceHandler *GetServiceHandler() { return service_handler_.get(); }
 
   // 获取已经读取的字节数
   inline uint64_t recv_bytes() const { return recv_bytes_; }
@@ -43,11 +45,45 @@ public:
   // 写操作完成处理函数，传入已写入的缓冲区地址和字节数
   void SendHandle(size_t length);
 
+  // 事件循环为该连接准备了一个发送请求
+  inline void SendQueued() { ++sends_queued_; }
+
+  // 在websocket阶段向对端发送一条文本消息
+  void SendMessage(const std::string &message);
+
+  // 发送队列：websocket阶段的数据按放入顺序发送，同一时刻只有一个发送请求，
+  // 数据保存在连接自身的内存中，不占用worker线程共享的发送缓冲池
+  // 为一条消息在队列尾部预留length字节，返回的地址在下一次预留前有效
+  // 队列超出预算时按slow_consumer策略处理，消息被丢弃或连接被关闭时返回nullptr
+  char *ReserveSend(size_t length, bool droppable = false);
+  // 没有正在进行的发送请求时提交队列中的数据，link为true时与下一个请求链接
+  void FlushSend(bool link = false);
+  // 发送队列的完成处理函数，短写时继续发送剩余的数据
+  // notify为true表示零拷贝发送之后还会有一个通知事件
+  void SendQueueHandle(int res, bool notify);
+  // 零拷贝发送的通知事件，内核不再引用正在发送的数据
+  void SendQueueNotify();
+  // 发送队列中尚未发送完成的字节数
+  inline uint64_t send_queue_bytes() const {
+    return queue_bytes_in_ - queue_bytes_out_;
+  }
+  // 发送请求尚未完成或零拷贝发送尚未收到通知，内核可能还在引用正在发送的数据
+  inline bool send_pending() const { return send_inflight_ || zc_notifs_; }
+  // 连接已关闭但需等待发送队列的请求结束后才能销毁，由最后一个完成事件销毁
+  inline bool release_deferred() const { return release_deferred_; }
+  inline void set_release_deferred() { release_deferred_ = true; }
+
+  class SendAwaiter;
+  // 等待此前已准备的发送请求与放入发送队列的数据全部发送完成，
+  // 连接在此之前关闭时返回false
+  // 恢复后连接可能已被销毁，需重新通过连接id获取连接
+  SendAwaiter WaitSent();
+
   // 读操作完成处理函数，传入已读取的缓冲区地址和读取的字节数
   void RecvHandle(void *buffer, size_t length);
 
   // 跨线程消息处函数
-  void CrossThreadMsgHandle(void *data, size_t length);
+  void CrossThreadMsgHandle(void *data, size_t length, bool droppable);
 
   // 业务处理函数
   std::string ServiceHandle(std::string data);
@@ -55,6 +91,23 @@ public:
   // 关闭操作
   void close();
 
+  // 发送队列中已有的数据全部发送完成后再关闭，例如回复对端的关闭帧
+  void CloseAfterFlush();
+
+  // 服务器平滑退出时通知对端并关闭连接
+  void shutdown();
+
+  // 已完成websocket握手并处于空闲状态，可以在热升级时移交给新进程
+  bool handoff_ready() const;
+  inline bool handing_off() const { return handing_off_; }
+  inline void set_handing_off(bool flag) { handing_off_ = flag; }
+  // 序列化新进程恢复连接所需的状态：请求路径、请求参数以及服务的会话状态
+  std::string save_state();
+  // 在新进程中恢复连接状态，失败时返回false
+  bool restore_state(const std::string &data);
+  // 连接已移交给新进程，不再进行任何处理，也不通知对端
+  void detach();
+
   inline EventLoop *GetEventLoop() { return event_loop_; }
 
   void transition_stage(conn_stage_t stage);
@@ -65,14 +118,63 @@ public:
 
   inline TimeWheel::timer_node *GetTimer() { return &idle_timer_; }
 
+  // 记录最近一次收到数据的时间，延迟检查闲置超时时使用
+  inline void Touch(uint64_t now_millis) { last_active_ = now_millis; }
+
+  // 接收数据使用的缓冲组
+  inline uint8_t recv_group() const { return recv_group_; }
+  inline void set_recv_group(uint8_t group) {
+    recv_group_ = group;
+    recv_samples_ = 0;
+  }
+  // 记录一次接收的数据量，返回近期每次接收数据量的估计（指数加权平均）
+  inline uint32_t RecordRecvSize(uint32_t len) {
+    if (recv_samples_ < UINT32_MAX)
+      ++recv_samples_;
+    recv_avg_ = recv_avg_ - recv_avg_ / 4 + len / 4;
+    return recv_avg_;
+  }
+  // 切换缓冲组后的接收次数
+  inline uint32_t recv_samples() const { return recv_samples_; }
+  // wait策略下发送队列超出预算，暂停接收数据，期间不再重新提交接收请求
+  inline bool recv_paused() const { return recv_paused_; }
+
 private:
   conn_stage_t stage_{kConnStageHttp};
   service_t service_id_{kServiceNone};
   // 直接文件描述符
   int fd_;
   bool closed_{false};
+  // 热升级时正在移交给新进程
+  bool handing_off_{false};
   uint64_t recv_bytes_{0};
   uint64_t send_bytes_{0};
+  // 最近一次收到数据的时间，单位毫秒
+  uint64_t last_active_{0};
+  // 接收缓冲组以及近期每次接收的数据量
+  uint8_t recv_group_{0};
+  uint32_t recv_samples_{0};
+  uint32_t recv_avg_{0};
+  bool recv_paused_{false};
+  // 已准备与已完成的发送请求数量
+  uint64_t sends_queued_{0};
+  uint64_t sends_done_{0};
+  // 等待发送完成的协程，按等待顺序排列
+  SendAwaiter *send_waiters_{nullptr};
+  // 正在发送的数据及其中已发送的长度，发送请求完成前不能修改
+  std::string sending_;
+  size_t sending_offset_{0};
+  // 等待发送的数据
+  std::string pending_;
+  bool send_inflight_{false};
+  // 尚未收到通知的零拷贝发送数量，不为0时正在发送的数据不能被修改或释放
+  uint32_t zc_notifs_{0};
+  bool release_deferred_{false};
+  // 发送队列清空后关闭连接
+  bool close_after_flush_{false};
+  // 放入发送队列与已发送完成的字节数
+  uint64_t queue_bytes_in_{0};
+  uint64_t queue_bytes_out_{0};
 
   // 连接id
   uint32_t conn_id_;
@@ -80,21 +182,87 @@ private:
   uint32_t user_id_{0};
 
   // 管理闲置连接的定时器
-  TimeWheel::timer_node idle_timer_{
-      [this]() { this->protocol_handler_->TimeoutHandle(); }};
+  TimeWheel::timer_node idle_timer_ =
+      TimeWheel::timer_node::Bind<&TcpConnection::idle_timeout>(this);
 
   // 应用层协议处理类
   std::unique_ptr<ProtocolHandler> protocol_handler_;
 
   // 服务处理类
   std::unique_ptr<ServiceHandler> service_handler_;
+  // 建立服务时的请求路径与参数，热升级时用于在新进程中重建服务
+  std::string service_path_;
+  std::unordered_map<std::string, std::vector<std::string>> service_args_;
 
   // 指向该文件描述符所属的事件循环
   EventLoop *event_loop_;
 
   static const std::unordered_map<std::string, service_t> router_;
+
+  void idle_timeout();
+
+  // 恢复已到达目标的等待方，all为true时以失败结果恢复所有等待方
+  void wake_send_waiters(bool all);
 };
 
+class TcpConnection::SendAwaiter {
+public:
+  SendAwaiter(TcpConnection *connection)
+      : connection_(connection), target_(connection->sends_queued_),
+        queue_target_(connection->queue_bytes_in_) {}
+  // 协程帧销毁时从连接的等待链表中移除
+  ~SendAwaiter() { unlink(); }
+
+  SendAwaiter(const SendAwaiter &) = delete;
+  SendAwaiter &operator=(const SendAwaiter &) = delete;
+
+  bool await_ready() noexcept {
+    if (connection_->closed())
+      return true;
+    ok_ = reached();
+    return ok_;
+  }
+  void await_suspend(std::coroutine_handle<> waiter) noexcept {
+    waiter_ = waiter;
+    // 加入链表尾部
+    pprev_ = &connection_->send_waiters_;
+    while (*pprev_)
+      pprev_ = &(*pprev_)->next_;
+    *pprev_ = this;
+  }
+  bool await_resume() const noexcept { return ok_; }
+
+private:
+  friend class TcpConnection;
+
+  inline bool reached() const {
+    return connection_->sends_done_ >= target_ &&
+           connection_->queue_bytes_out_ >= queue_target_;
+  }
+
+  inline void unlink() {
+    if (!pprev_)
+      return;
+    *pprev_ = next_;
+    if (next_)
+      next_->pprev_ = pprev_;
+    pprev_ = nullptr;
+    next_ = nullptr;
+  }
+
+  TcpConnection *connection_;
+  uint64_t target_;
+  uint64_t queue_target_;
+  bool ok_{false};
+  std::coroutine_handle<> waiter_;
+  SendAwaiter *next_{nullptr};
+  SendAwaiter **pprev_{nullptr};
+};
+
+inline TcpConnection::SendAwaiter TcpConnection::WaitSent() {
+  return SendAwaiter(this);
+}
+
 } // namespace jdocs
 
 #endif
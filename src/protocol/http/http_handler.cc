@@ -8,6 +8,7 @@
 #include <openssl/sha.h>
 #include <spdlog/spdlog.h>
 
+#include "core/metrics.h"
 #include "net/tcp_connection.h"
 
 namespace jdocs {
@@ -19,6 +20,9 @@ HttpHandler::HttpHandler(TcpConnection *connection)
 
 void HttpHandler::TimeoutHandle() { connection_->close(); }
 
+// 尚未升级为websocket的连接直接关闭
+void HttpHandler::ShutdownHandle() { connection_->close(); }
+
 // 用于生成sec-websocket-accept的值
 int HttpHandler::generate_accept_key(const char *key, char *buffer) {
   u_char tmp[20];
@@ -26,24 +30,18 @@ int HttpHandler::generate_accept_key(const char *key, char *buffer) {
   return EVP_EncodeBlock((u_char *)buffer, tmp, 20);
 }
 
+// 握手响应很小，放入连接的发送队列，由发送策略选择普通发送，不占用发送缓冲区
 void HttpHandler::send_response_101(const char *key) {
-  void *send_buf;
-  int bidx = connection_->GetEventLoop()->get_send_buffer(&send_buf);
-  if (bidx == -1) {
-    // 没有可用的发送缓冲区，说明目前服务器负载有点大，所以直接关闭该连接
-    spdlog::error("not avaliable buffer to send. closing client.");
-    connection_->close();
+  char *send_buf = connection_->ReserveSend(sizeof(kHttpResponse101) + 31);
+  if (!send_buf)
     return;
-  }
   memcpy(send_buf, kHttpResponse101, sizeof(kHttpResponse101) - 1);
-  generate_accept_key(key, (char *)send_buf + sizeof(kHttpResponse101) - 1);
-  ((char *)send_buf)[sizeof(kHttpResponse101) + 27] = '\r';
-  ((char *)send_buf)[sizeof(kHttpResponse101) + 28] = '\n';
-  ((char *)send_buf)[sizeof(kHttpResponse101) + 29] = '\r';
-  ((char *)send_buf)[sizeof(kHttpResponse101) + 30] = '\n';
-  connection_->GetEventLoop()->prep_send_zc(
-      connection_->fd(), connection_->conn_id(), send_buf, bidx,
-      sizeof(kHttpResponse101) + 31);
+  generate_accept_key(key, send_buf + sizeof(kHttpResponse101) - 1);
+  send_buf[sizeof(kHttpResponse101) + 27] = '\r';
+  send_buf[sizeof(kHttpResponse101) + 28] = '\n';
+  send_buf[sizeof(kHttpResponse101) + 29] = '\r';
+  send_buf[sizeof(kHttpResponse101) + 30] = '\n';
+  connection_->FlushSend();
 }
 
 // 生成400错误请求报文
@@ -60,10 +58,36 @@ void HttpHandler::send_response_404() {
       sizeof(kHttpResponse404) - 1, true);
 }
 
+// 发送指标数据，发送完成后连接保持打开，以便采集端复用连接
+// 报文写入连接的发送队列，由队列保证数据在内核发送完成前有效
+void HttpHandler::send_metrics() {
+  std::string body = Metrics::Export();
+  std::string length = std::to_string(body.size());
+  size_t header = sizeof(kHttpResponse200Metrics) - 1;
+  char *send_buf =
+      connection_->ReserveSend(header + length.size() + 4 + body.size());
+  if (!send_buf)
+    return;
+  memcpy(send_buf, kHttpResponse200Metrics, header);
+  send_buf += header;
+  memcpy(send_buf, length.data(), length.size());
+  send_buf += length.size();
+  memcpy(send_buf, "\r\n\r\n", 4);
+  memcpy(send_buf + 4, body.data(), body.size());
+  connection_->FlushSend();
+}
+
 void HttpHandler::RecvDataHandle(void *buffer, size_t length) {
   parser.ParserExecute(buffer, length);
   if (parser.IsDone()) {
-    if (request_uri_parse()) {
+    if (parser.location_ == kMetricsPath) {
+      // 指标请求为普通的GET请求，无需websocket握手字段
+      send_metrics();
+      parser.Reset();
+    } else if (!parser.IsWebsocketHandshake()) {
+      parser.error_code_ = error_code_t::PARSER_ERROR_NOT_FOUND_REQUIRED_FIELD;
+      parsing_fail_handle();
+    } else if (request_uri_parse()) {
       // 升级为websocket协议
       send_response_101(parser.websocket_key_);
       connection_->transition_stage(TcpConnection::kConnStageWebsocket);
@@ -75,9 +99,8 @@ void HttpHandler::RecvDataHandle(void *buffer, size_t length) {
     }
   } else {
     // 解析失败可能是因为需要更多数据进行解析，或是遇到了解析错误
-    if (parser.GetErrorCode()) {
+    if (parser.GetErrorCode())
       parsing_fail_handle();
-    }
     // 需要更多数据进行解析，什么都不做
   }
 }
@@ -22,6 +22,12 @@ namespace {
   "HTTP/1.1 404 Not Found\r\nServer: jdocs_server\r\nContent-Type: "           \
   "text/plain; charset-utf8\r\nContent-Length: 38\r\nConnection: "             \
   "Close\r\n\r\nThe requested resource does not exist."
+#define kHttpResponse200Metrics                                                \
+  "HTTP/1.1 200 OK\r\nServer: jdocs_server\r\nContent-Type: "                 \
+  "text/plain; version=0.0.4; charset=utf-8\r\nContent-Length: "
+
+// 指标导出路径，普通的GET请求即可访问，无需websocket握手
+constexpr const char *kMetricsPath = "/metrics";
 
 } // namespace
 
@@ -34,6 +40,8 @@ public:
 
   void TimeoutHandle() override;
 
+  void ShutdownHandle() override;
+
 private:
   // 用于生成sec-websocket-accept的值
   static int generate_accept_key(const char *key, char *buffer);
@@ -47,6 +55,9 @@ private:
   // 发送404请求资源不存在报文
   void send_response_404();
 
+  // 发送Prometheus文本格式的指标数据
+  void send_metrics();
+
   bool request_uri_parse();
 
   void parsing_fail_handle();
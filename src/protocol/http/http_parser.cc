@@ -250,10 +250,7 @@ size_t HttpParser::ParserExecute(void *buffer, size_t length) {
         error_code_ = error_code_t::PARSER_ERROR_PROTOCOL_ERROR;
         return 0;
       }
-      if (flags_ != websocket_handshake_flag::WS_HANDSHAKE_FLAG_COMPLETE) {
-        error_code_ = error_code_t::PARSER_ERROR_NOT_FOUND_REQUIRED_FIELD;
-        return 0;
-      }
+      // 握手字段是否齐全由调用方根据请求路径判断，普通的GET请求同样解析完成
       state_ = parser_state_t::kHttpParserDone;
       return i + 1;
       break;
@@ -152,6 +152,10 @@ struct HttpParser {
   inline bool IsDone() const {
     return state_ == parser_state_t::kHttpParserDone;
   }
+  // 请求头部是否包含websocket握手所需的全部字段
+  inline bool IsWebsocketHandshake() const {
+    return flags_ == websocket_handshake_flag::WS_HANDSHAKE_FLAG_COMPLETE;
+  }
   void Reset();
   inline int GetErrorCode() const { return error_code_; }
   const char *GetError() const { return errors_desc_table[error_code_]; }
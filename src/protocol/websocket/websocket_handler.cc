@@ -6,6 +6,8 @@
 
 #include <spdlog/spdlog.h>
 
+#include "utils/logger.h"
+
 namespace jdocs {
 
 WebSocketHandler::WebSocketHandler(TcpConnection *connection)
@@ -20,9 +22,22 @@ void WebSocketHandler::TimeoutHandle() {
                                         kTimeToCloseAfterPing);
 }
 
+void WebSocketHandler::ShutdownHandle() {
+  if (handle_state_ == ws_handle_state_t::kWsHandleStateClosing)
+    return;
+  send_close_frame(WebSocketParser::WS_CLOSE_GOING_AWAY);
+}
+
+bool WebSocketHandler::Idle() const {
+  return handle_state_ == ws_handle_state_t::kWsHandleStateNormal &&
+         parser.state_ ==
+             WebSocketParser::parser_state_t::kWsParserFinAndOpcode &&
+         !wait_pong_flag;
+}
+
 void WebSocketHandler::RecvDataHandle(void *buffer, size_t length) {
 next_loop:
-  spdlog::info("websocket: parsing ...");
+  JDOCS_LOG_TRACE("websocket: parsing ...");
   if (connection_->closed())
     return;
   size_t parsed_bytes = parser.ParserExecute(buffer, length);
@@ -35,7 +50,7 @@ next_loop:
       frame_handle();
       // 此处进行业务处理，所有数据已解析完毕
       if (handle_state_ == ws_handle_state_t::kWsHandleStateNormal) {
-        spdlog::info("service handle working...");
+        JDOCS_LOG_DEBUG("service handle working...");
         std::string result =
             connection_->ServiceHandle(std::move(payload_cache));
         send_data_frame(connection_, result.data(), result.size());
@@ -84,17 +99,13 @@ size_t WebSocketHandler::encapsulation_package(
   return frame_size;
 }
 
-size_t WebSocketHandler::get_affordable_payload_size(size_t payload_length,
-                                                     size_t buffer_size) {
-  if (buffer_size <= 2)
-    return 0;
-  if (payload_length < 126)
-    buffer_size -= 2;
-  else if (payload_length < 0xFFFF)
-    buffer_size = buffer_size > 4 ? buffer_size - 4 : 0;
-  else
-    buffer_size = buffer_size > 10 ? buffer_size - 10 : 0;
-  return buffer_size > payload_length ? payload_length : buffer_size;
+// 与encapsulation_package中的载荷长度编码方式保持一致
+size_t WebSocketHandler::get_frame_size(size_t length) {
+  if (length < 126)
+    return length + 2;
+  if (length < 0xFFFF)
+    return length + 4;
+  return length + 10;
 }
 
 void WebSocketHandler::frame_handle() {
@@ -133,21 +144,21 @@ void WebSocketHandler::frame_handle() {
 void WebSocketHandler::control_frame_handle() {
   switch (parser.opcode_) {
   case WebSocketParser::WS_OPCODE_CLOSE: {
-    // 客户端发起了close请求
-    if (handle_state_ != ws_handle_state_t::kWsHandleStateClosing) {
+    // 客户端发起了close请求，回复关闭帧后关闭连接
+    if (handle_state_ != ws_handle_state_t::kWsHandleStateClosing)
       send_close_frame(WebSocketParser::WS_CLOSE_NORMAL, true);
-    }
-    connection_->close();
+    else
+      connection_->CloseAfterFlush();
     break;
   }
   case WebSocketParser::WS_OPCODE_PING: {
-    spdlog::info("websocket: got a PING frame.");
+    JDOCS_LOG_DEBUG("websocket: got a PING frame.");
     send_pong_frame(parser.data_.data(), parser.data_.size());
     break;
   }
   case WebSocketParser::WS_OPCODE_PONG: {
     // 如果先前发送了ping包，则处理，比如取消超时关闭连接事件，否则忽略
-    spdlog::info("websocket: got a PONG frame.");
+    JDOCS_LOG_DEBUG("websocket: got a PONG frame.");
     if (wait_pong_flag) {
       // 客户端发送的pong帧载荷与预期载荷不一致，关闭连接
       if (std::strcmp(parser.data_.c_str(), WS_PING_PAYLOAD) != 0) {
@@ -166,81 +177,52 @@ void WebSocketHandler::control_frame_handle() {
 }
 
 void WebSocketHandler::send_close_frame(uint16_t code, bool flag) {
-  void *send_buf;
-  int bidx = connection_->GetEventLoop()->get_send_buffer(&send_buf);
-  if (bidx == -1) {
-    // 没有可用的发送缓冲区，说明服务器目前负载压力过大，直接关闭该连接
+  JDOCS_LOG_DEBUG("websocket: send close frame. message: {}",
+                  WebSocketParser::close_message(code));
+  handle_state_ = ws_handle_state_t::kWsHandleStateClosing;
+  char *frame = connection_->ReserveSend(
+      strlen(WebSocketParser::close_message(code)) + 4);
+  if (!frame) {
     connection_->close();
     return;
   }
-  spdlog::info("websocket: send close frame. message: {}",
-               WebSocketParser::close_message(code));
-  size_t prep_send_bytes =
-      WebSocketParser::generate_close_frame(code, send_buf);
-  connection_->GetEventLoop()->prep_send_zc(
-      connection_->fd(), connection_->conn_id(), send_buf,
-      static_cast<uint16_t>(bidx), prep_send_bytes, flag);
-  handle_state_ = ws_handle_state_t::kWsHandleStateClosing;
+  WebSocketParser::generate_close_frame(code, frame);
+  connection_->FlushSend();
+  if (flag)
+    connection_->CloseAfterFlush();
 }
 
 void WebSocketHandler::send_ping_frame() {
-  spdlog::info("websocket: send PING frame.");
-  connection_->GetEventLoop()->prep_send(
-      connection_->fd(), connection_->conn_id(), (void *)raw_ping_frame,
-      raw_ping_frame_size);
+  JDOCS_LOG_DEBUG("websocket: send PING frame.");
+  char *frame = connection_->ReserveSend(raw_ping_frame_size);
+  if (!frame)
+    return;
+  memcpy(frame, raw_ping_frame, raw_ping_frame_size);
+  connection_->FlushSend();
   wait_pong_flag = true;
 }
 
 void WebSocketHandler::send_pong_frame(void *payload, size_t length) {
-  void *send_buf;
-  int bidx = connection_->GetEventLoop()->get_send_buffer(&send_buf);
-  if (bidx == -1) {
-    connection_->close();
+  JDOCS_LOG_DEBUG("websocket: send PONG frame.");
+  char *frame = connection_->ReserveSend(get_frame_size(length));
+  if (!frame)
     return;
-  }
-  spdlog::info("websocket: send PING frame.");
-  size_t prep_send_bytes = encapsulation_package(
-      true, WebSocketParser::WS_OPCODE_PONG, send_buf, payload, length);
-  connection_->GetEventLoop()->prep_send_zc(connection_->fd(),
-                                            connection_->conn_id(), send_buf,
-                                            (uint16_t)bidx, prep_send_bytes);
+  encapsulation_package(true, WebSocketParser::WS_OPCODE_PONG, frame, payload,
+                        length);
+  connection_->FlushSend();
 }
 
+// 消息不再按发送缓冲区的大小拆分为多个帧，整条消息作为一个帧放入发送队列
 void WebSocketHandler::send_data_frame(TcpConnection *connection, void *data,
-                                       size_t length) {
+                                       size_t length, bool droppable) {
   if (length == 0)
     return;
-  void *send_buf;
-  int bidx;
-  bool fin_flag = true, once_flag = true;
-  size_t payload_length, prep_send_bytes;
-  WebSocketParser::ws_opcode_t opcode;
-  do {
-    bidx = connection->GetEventLoop()->get_send_buffer(&send_buf);
-    if (bidx == -1) {
-      spdlog::error("send_data_frame failed. not avaliable buffer to send.");
-      connection->close();
-      return;
-    }
-    payload_length = get_affordable_payload_size(length, kBufferSize);
-    fin_flag = true;
-    opcode = WebSocketParser::WS_OPCODE_CONTINUED;
-    // 不能一次发送完成
-    if (payload_length < length) {
-      fin_flag = false;
-    }
-    if (once_flag) {
-      opcode = WebSocketParser::WS_OPCODE_TEXT;
-      once_flag = false;
-    }
-    prep_send_bytes =
-        encapsulation_package(fin_flag, opcode, send_buf, data, payload_length);
-    connection->GetEventLoop()->prep_send_zc(
-        connection->fd(), connection->conn_id(), send_buf, (uint16_t)bidx,
-        prep_send_bytes, !fin_flag);
-    data = (char *)data + payload_length;
-    length -= payload_length;
-  } while (length);
+  char *frame = connection->ReserveSend(get_frame_size(length), droppable);
+  if (!frame)
+    return;
+  encapsulation_package(true, WebSocketParser::WS_OPCODE_TEXT, frame, data,
+                        length);
+  connection->FlushSend();
 }
 
 } // namespace jdocs
@@ -31,8 +31,15 @@ public:
 
   void TimeoutHandle() override;
 
+  // 发送GOING_AWAY关闭帧，由客户端回复关闭帧后关闭连接
+  void ShutdownHandle() override;
+
+  bool Idle() const override;
+
+  // 将消息封装为一个文本帧放入连接的发送队列
+  // droppable为true的消息在发送队列超出预算时可能被丢弃
   static void send_data_frame(TcpConnection *connection, void *data,
-                              size_t length);
+                              size_t length, bool droppable = false);
 
 private:
   // websocket协议处理状态机
@@ -47,9 +54,8 @@ private:
 
   void control_frame_handle();
 
-  // 获取缓冲区实际能够存放的数据载荷大小
-  static size_t get_affordable_payload_size(size_t payload_length,
-                                            size_t buffer_size);
+  // 载荷长度为length的帧的总长度
+  static size_t get_frame_size(size_t length);
 
   // 封装websocket数据帧
   static size_t encapsulation_package(bool fin_flag,
@@ -59,15 +65,19 @@ private:
 
   void send_ping_frame();
 
+  // flag为true时在关闭帧及其之前排队的数据发送完成后关闭连接
+  // 关闭帧无法放入发送队列时直接关闭连接
   void send_close_frame(uint16_t code, bool flag = false);
 
   void send_pong_frame(void *payload, size_t length);
 
   // 发送ping帧之后，等待pong帧的计时器
-  TimeWheel::timer_node wait_pong_timer_{[this]() {
-    if (this->wait_pong_flag)
-      this->connection_->close();
-  }};
+  inline void pong_timeout() {
+    if (wait_pong_flag)
+      connection_->close();
+  }
+  TimeWheel::timer_node wait_pong_timer_ =
+      TimeWheel::timer_node::Bind<&WebSocketHandler::pong_timeout>(this);
   bool wait_pong_flag{false};
 
   ws_handle_state_t handle_state_{0};
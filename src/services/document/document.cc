@@ -5,10 +5,20 @@
 #include <spdlog/spdlog.h>
 
 #include "services/document/document_service.h"
+#include "utils/logger.h"
 
 namespace jdocs {
 
-Document::Document(const std::string &name) : name_(name) {}
+Document::Document(const std::string &name, uint32_t capacity)
+    : name_(name), capacity_(capacity) {}
+
+void Document::Restore(uint64_t revision, Operation content) {
+  std::lock_guard<std::shared_mutex> lock(doc_mutex_);
+  revision_ = revision;
+  min_revision_ = revision;
+  content_ = std::move(content);
+  history_.clear();
+}
 
 Operation Document::ApplyOp(uint64_t &version, Operation client) {
   std::lock_guard<std::shared_mutex> lock(doc_mutex_);
@@ -17,23 +27,23 @@ Operation Document::ApplyOp(uint64_t &version, Operation client) {
     spdlog::error("invalid version");
     return {};
   }
-  spdlog::warn("apply op function step 1");
+  JDOCS_LOG_TRACE("apply op function step 1");
   while (version < revision_) {
     client = transform(client, history_[version - min_revision_]);
     ++version;
   }
 
-  spdlog::warn("apply op function step 2");
+  JDOCS_LOG_TRACE("apply op function step 2");
 
   ++revision_;
   version = revision_;
 
   content_ = compose(content_, client);
 
-  spdlog::warn("apply op function step 3");
+  JDOCS_LOG_TRACE("apply op function step 3");
   PushToHistory(client);
 
-  spdlog::warn("apply op function step 4");
+  JDOCS_LOG_TRACE("apply op function step 4");
   // 返回转换操作后的操作用于广播
   return client;
 }
@@ -48,13 +58,13 @@ void Document::PushToHistory(Operation op) {
 
 std::list<uint32_t>::iterator Document::JoinUser(uint32_t conn_id) {
   std::lock_guard<std::shared_mutex> lock(users_mutex_);
-  spdlog::warn("join user function called.");
+  JDOCS_LOG_DEBUG("join user function called.");
   return users_.insert(users_.begin(), conn_id);
 }
 
 void Document::ExitUser(const std::list<uint32_t>::iterator &node) {
   std::lock_guard<std::shared_mutex> lock(users_mutex_);
-  spdlog::warn("exit user function called.");
+  JDOCS_LOG_DEBUG("exit user function called.");
   users_.erase(node);
   if (users_.size() == 0) {
     if (!DocumentService::CloseDocument(name_)) {
@@ -14,7 +14,8 @@ namespace jdocs {
 
 class Document {
 public:
-  Document(const std::string &name);
+  // capacity为保留的历史版本数量，客户端版本落后超过该数量时无法进行转换
+  Document(const std::string &name, uint32_t capacity);
   ~Document() = default;
 
   Operation ApplyOp(uint64_t &version, Operation client);
@@ -25,8 +26,18 @@ public:
     return content_;
   }
 
+  inline uint64_t revision() {
+    std::shared_lock<std::shared_mutex> lock(doc_mutex_);
+    return revision_;
+  }
+
   void PushToHistory(Operation op);
 
+  inline const std::string &name() const { return name_; }
+
+  // 热升级时由新进程恢复文档内容，历史版本不会被传递
+  void Restore(uint64_t revision, Operation content);
+
   std::list<uint32_t>::iterator JoinUser(uint32_t conn_id);
 
   void ExitUser(const std::list<uint32_t>::iterator &node);
@@ -39,7 +50,7 @@ private:
   Operation content_;
   uint64_t revision_{0};
   uint64_t min_revision_{0};
-  uint32_t capacity_{50};
+  uint32_t capacity_;
   std::deque<Operation> history_;
   std::shared_mutex doc_mutex_;
   std::shared_mutex users_mutex_;
@@ -4,7 +4,9 @@
 
 #include <spdlog/spdlog.h>
 
+#include "core/metrics.h"
 #include "net/tcp_connection.h"
+#include "utils/logger.h"
 
 namespace jdocs {
 
@@ -64,6 +66,86 @@ void to_json(nlohmann::json &j, const docmsg_desc &msg) {
   }
 }
 
+namespace {
+
+constexpr const char *kBadRequest =
+    R"({"success":false,"message":"bad request!"})";
+constexpr const char *kNoDocument =
+    R"({"success":false,"message":"no document are currently open."})";
+
+// 在文档上执行编辑操作，op为转换后需广播给其他用户的操作，返回给发送方的确认
+std::string apply_edit(Document &doc, docmsg_desc msg, uint32_t user_id,
+                       docmsg_desc *op) {
+  msg.ops = doc.ApplyOp(msg.version, std::move(msg.ops));
+  msg.user_id = user_id;
+  msg.type = DocOpType::OP;
+  *op = std::move(msg);
+  docmsg_desc ack{.type = DocOpType::ACK, .user_id = user_id};
+  return nlohmann::json(ack).dump();
+}
+
+// 将消息发送给除发送方以外的所有用户
+void send_to_users(EventLoop *loop, const std::list<uint32_t> &users,
+                   uint32_t sender, std::string message) {
+  size_t count = 0;
+  for (const auto conn_id : users)
+    if (conn_id != sender)
+      ++count;
+  if (count == 0)
+    return;
+  CTContext *ctx = new CTContext(count, sender, std::move(message));
+  for (const auto conn_id : users)
+    if (conn_id != sender)
+      loop->prep_cross_thread_msg(conn_id, ctx);
+}
+
+// 编辑的开销估计，转换的开销随客户端落后的版本数增长
+inline uint64_t edit_cost(Document &doc, uint64_t version, size_t length) {
+  uint64_t revision = doc.revision();
+  uint64_t lag = version < revision ? revision - version : 0;
+  return static_cast<uint64_t>(length) * (lag + 1);
+}
+
+} // namespace
+
+// 交给计算线程池处理的消息，由提交方与计算线程共同持有
+struct DocumentService::offload_job {
+  // 尚未解析的消息
+  std::string data;
+  docmsg_desc msg{};
+  bool parsed{false};
+  std::shared_ptr<Document> document;
+  uint32_t user_id{0};
+  // 编辑操作的确认，或解析失败时的错误回复，为空时由worker线程处理该消息
+  std::string reply;
+  // 需要广播给其他用户的编辑操作
+  std::string broadcast;
+
+  // 在计算线程中执行，只进行解析与编辑操作，其余消息需要访问连接状态
+  void run() {
+    if (!parsed) {
+      try {
+        msg = nlohmann::json::parse(data).get<docmsg_desc>();
+        parsed = true;
+      } catch (const nlohmann::json::exception &e) {
+        spdlog::error("json parser failed. error: {}", e.what());
+        reply = kBadRequest;
+        return;
+      }
+      std::string().swap(data);
+    }
+    if (msg.type != DocOpType::EDIT)
+      return;
+    if (!document) {
+      reply = kNoDocument;
+      return;
+    }
+    docmsg_desc op;
+    reply = apply_edit(*document, std::move(msg), user_id, &op);
+    broadcast = nlohmann::json(op).dump();
+  }
+};
+
 DocumentService::~DocumentService() {
   if (document_) {
     close_handle({});
@@ -87,11 +169,13 @@ DocumentService::GetDocument(const std::string &doc_name) {
   return nullptr;
 }
 
-std::shared_ptr<Document> DocumentService::OpenDocument(std::string doc_name) {
+std::shared_ptr<Document> DocumentService::OpenDocument(std::string doc_name,
+                                                        uint32_t capacity) {
   std::lock_guard<std::shared_mutex> lock(mutex_);
   auto it = documents_.find(doc_name);
   if (it == documents_.end()) {
-    std::shared_ptr<Document> doc = std::make_shared<Document>(doc_name);
+    std::shared_ptr<Document> doc =
+        std::make_shared<Document>(doc_name, capacity);
     documents_.emplace(std::move(doc_name), doc);
     return doc;
   }
@@ -115,60 +199,194 @@ bool DocumentService::parse_parameters(
   return true;
 }
 
+std::vector<std::shared_ptr<Document>> DocumentService::SnapshotDocuments() {
+  std::shared_lock<std::shared_mutex> lock(mutex_);
+  std::vector<std::shared_ptr<Document>> docs;
+  docs.reserve(documents_.size());
+  for (auto &item : documents_) {
+    std::shared_ptr<Document> doc = item.second.lock();
+    if (doc)
+      docs.push_back(std::move(doc));
+  }
+  return docs;
+}
+
+std::string DocumentService::SaveDocument(Document &doc) {
+  uint64_t version;
+  Operation content = doc.GetContent(version);
+  nlohmann::json j;
+  j["name"] = doc.name();
+  j["v"] = version;
+  j["ops"] = content;
+  return j.dump();
+}
+
+std::shared_ptr<Document>
+DocumentService::RestoreDocument(const std::string &data, uint32_t capacity) {
+  try {
+    nlohmann::json j = nlohmann::json::parse(data);
+    std::shared_ptr<Document> doc =
+        OpenDocument(j.at("name").get<std::string>(), capacity);
+    doc->Restore(j.at("v").get<uint64_t>(), j.at("ops").get<Operation>());
+    return doc;
+  } catch (const nlohmann::json::exception &e) {
+    spdlog::error("restore document failed. error: {}", e.what());
+    return nullptr;
+  }
+}
+
+std::string DocumentService::SaveState() {
+  return document_ ? document_->name() : std::string();
+}
+
+bool DocumentService::RestoreState(const std::string &state) {
+  if (state.empty())
+    return true;
+  document_ = GetDocument(state);
+  if (!document_)
+    return false;
+  node_ = document_->JoinUser(connection_->conn_id());
+  return true;
+}
+
 std::string DocumentService::handle(std::string data) {
-  spdlog::warn("handle function");
+  JDOCS_LOG_TRACE("handle function");
+  // 之前的消息仍在计算线程池中处理，暂存以保证处理顺序
+  if (offloading_) {
+    backlog_.push_back(std::move(data));
+    return {};
+  }
+  uint32_t threshold =
+      connection_->GetEventLoop()->GetConfig().offload_threshold;
+  // 较大的消息连同解析一起交给计算线程池
+  if (data.size() >= threshold) {
+    auto job = std::make_shared<offload_job>();
+    job->data = std::move(data);
+    if (offload(job))
+      return {};
+    data = std::move(job->data);
+  }
   try {
-    json_ = nlohmann::json::parse(std::move(data));
+    json_ = nlohmann::json::parse(data);
     docmsg_desc msg = json_.get<docmsg_desc>();
-    std::string send_msg;
-    switch (msg.type) {
-    case DocOpType::OPEN: {
-      send_msg = open_handle(std::move(msg));
-      break;
-    }
-    case DocOpType::EDIT: {
-      send_msg = edit_handle(std::move(msg));
-      break;
-    }
-    case DocOpType::CLOSE: {
-      send_msg = close_handle(std::move(msg));
-      break;
-    }
-    default: {
-      send_msg = R"({"success":false,"message":"bad request!"})";
-    }
+    if (msg.type == DocOpType::EDIT && document_ &&
+        edit_cost(*document_, msg.version, data.size()) >= threshold) {
+      auto job = std::make_shared<offload_job>();
+      job->msg = std::move(msg);
+      job->parsed = true;
+      if (offload(job)) {
+        json_.clear();
+        return {};
+      }
+      msg = std::move(job->msg);
     }
+    std::string send_msg = dispatch(std::move(msg));
     json_.clear();
     return send_msg;
   } catch (const nlohmann::json::exception &e) {
     spdlog::error("json parser failed. error: {}", e.what());
-    return R"({"success":false,"message":"bad request!"})";
+    return kBadRequest;
+  }
+}
+
+std::string DocumentService::dispatch(docmsg_desc msg) {
+  switch (msg.type) {
+  case DocOpType::OPEN:
+    return open_handle(std::move(msg));
+  case DocOpType::EDIT:
+    return edit_handle(std::move(msg));
+  case DocOpType::CLOSE:
+    return close_handle(std::move(msg));
+  default:
+    return kBadRequest;
+  }
+}
+
+bool DocumentService::offload(std::shared_ptr<offload_job> job) {
+  EventLoop *loop = connection_->GetEventLoop();
+  uint32_t conn_id = connection_->conn_id();
+  job->document = document_;
+  job->user_id = connection_->user_id();
+  // 编辑已作用于文档，即使发送方已断开也需要广播给其他用户
+  // 连接已关闭或槽位已被复用时不再回复
+  auto done = [job, loop, conn_id] {
+    if (!job->broadcast.empty()) {
+      metrics_add(METRIC_DOC_EDITS);
+      send_to_users(loop, job->document->GetUserList(), conn_id,
+                    std::move(job->broadcast));
+    }
+    TcpConnection *connection = loop->GetConnection(conn_id);
+    if (!connection || connection->closed() ||
+        connection->GetServiceId() != TcpConnection::kServiceDocument)
+      return;
+    static_cast<DocumentService *>(connection->GetServiceHandler())
+        ->finish_offload(*job);
+  };
+  auto work = [job] {
+    try {
+      job->run();
+    } catch (const std::exception &e) {
+      spdlog::error("offloaded document job failed. error: {}", e.what());
+      job->reply = kBadRequest;
+      job->broadcast.clear();
+    }
+  };
+  if (!loop->Offload(std::move(work), std::move(done)))
+    return false;
+  offloading_ = true;
+  return true;
+}
+
+void DocumentService::finish_offload(offload_job &job) {
+  offloading_ = false;
+  std::string reply = std::move(job.reply);
+  if (reply.empty()) {
+    try {
+      reply = dispatch(std::move(job.msg));
+      json_.clear();
+    } catch (const nlohmann::json::exception &e) {
+      spdlog::error("json parser failed. error: {}", e.what());
+      reply = kBadRequest;
+    }
+  }
+  connection_->SendMessage(reply);
+  // 依次处理暂存的消息，其中的消息可能再次被交给计算线程池
+  while (!offloading_ && !backlog_.empty()) {
+    std::string data = std::move(backlog_.front());
+    backlog_.pop_front();
+    reply = handle(std::move(data));
+    if (!reply.empty())
+      connection_->SendMessage(reply);
   }
 }
 
 std::string DocumentService::open_handle(docmsg_desc msg) {
-  spdlog::warn("open handle function step 1");
+  JDOCS_LOG_TRACE("open handle function step 1");
   if (document_) {
-    spdlog::warn("has document are open");
+    JDOCS_LOG_DEBUG("has document are open");
     document_->ExitUser(node_);
   }
   document_ = DocumentService::GetDocument(msg.doc_name);
-  spdlog::warn("open handle function step 2");
+  JDOCS_LOG_TRACE("open handle function step 2");
   if (document_ == nullptr) {
-    document_ = DocumentService::OpenDocument(std::move(msg.doc_name));
-    spdlog::warn("open handle function step 3");
+    document_ = DocumentService::OpenDocument(
+        std::move(msg.doc_name),
+        connection_->GetEventLoop()->GetConfig().doc_history_capacity);
+    JDOCS_LOG_TRACE("open handle function step 3");
   }
   node_ = document_->JoinUser(connection_->conn_id());
-  spdlog::warn("open handle function step 4");
+  JDOCS_LOG_TRACE("open handle function step 4");
   auto users = document_->GetUserList();
   if (users.size() > 1) {
-    spdlog::warn("open handle function step 5");
+    JDOCS_LOG_TRACE("open handle function step 5");
     docmsg_desc notify_msg{.type = DocOpType::NOTIFY,
                            .user_id = connection_->user_id(),
                            .doc_name = "new user join."};
     json_ = notify_msg;
     CTContext *ctx =
         new CTContext(users.size() - 1, connection_->conn_id(), json_.dump());
+    // 在线状态通知，接收方发送队列积压时可以丢弃
+    ctx->droppable = true;
     for (const auto conn_id : users) {
       if (conn_id != connection_->conn_id())
         connection_->GetEventLoop()->prep_cross_thread_msg(conn_id, ctx);
@@ -180,45 +398,36 @@ std::string DocumentService::open_handle(docmsg_desc msg) {
 }
 
 std::string DocumentService::edit_handle(docmsg_desc msg) {
-  spdlog::warn("edit handle function");
+  JDOCS_LOG_TRACE("edit handle function");
   if (!document_) {
-    return R"({"success":false,"message":"no document are currently open."})";
+    return kNoDocument;
   }
-  msg.ops = document_->ApplyOp(msg.version, std::move(msg.ops));
-  spdlog::warn("edit handle function step 1");
-  msg.user_id = connection_->user_id();
+  docmsg_desc op;
+  std::string ack =
+      apply_edit(*document_, std::move(msg), connection_->user_id(), &op);
+  metrics_add(METRIC_DOC_EDITS);
+  JDOCS_LOG_TRACE("edit handle function step 1");
   auto users = document_->GetUserList();
-  spdlog::warn("edit handle function step 2");
   if (users.size() > 1) {
-    msg.type = DocOpType::OP;
-    json_ = std::move(msg);
-    spdlog::warn("edit handle function step 3");
-    CTContext *ctx =
-        new CTContext(users.size() - 1, connection_->conn_id(), json_.dump());
-    for (const auto conn_id : users) {
-      if (conn_id != connection_->conn_id())
-        connection_->GetEventLoop()->prep_cross_thread_msg(conn_id, ctx);
-    }
+    json_ = std::move(op);
+    send_to_users(connection_->GetEventLoop(), users, connection_->conn_id(),
+                  json_.dump());
   }
-  spdlog::warn("edit handle function step 4");
-  msg.type = DocOpType::ACK;
-  msg.user_id = connection_->user_id();
-  json_ = msg;
-  spdlog::warn("edit handle function step 5");
-  return json_.dump();
+  JDOCS_LOG_TRACE("edit handle function step 2");
+  return ack;
 }
 
 std::string DocumentService::close_handle(docmsg_desc msg) {
-  spdlog::warn("close handle function");
+  JDOCS_LOG_TRACE("close handle function");
   if (!document_) {
-    return R"({"success":false,"message":"no document are currently open."})";
+    return kNoDocument;
   }
-  spdlog::warn("close handle function step 1");
+  JDOCS_LOG_TRACE("close handle function step 1");
   document_->ExitUser(node_);
-  spdlog::warn("close handle function step 2");
+  JDOCS_LOG_TRACE("close handle function step 2");
   auto users = document_->GetUserList();
   document_.reset();
-  spdlog::warn("close handle function step 3");
+  JDOCS_LOG_TRACE("close handle function step 3");
   if (users.size() > 0) {
     msg.type = DocOpType::NOTIFY;
     msg.user_id = connection_->user_id();
@@ -226,6 +435,7 @@ std::string DocumentService::close_handle(docmsg_desc msg) {
     json_ = std::move(msg);
     CTContext *ctx =
         new CTContext(users.size(), connection_->conn_id(), json_.dump());
+    ctx->droppable = true;
     for (const auto conn_id : users) {
       if (conn_id != connection_->conn_id())
         connection_->GetEventLoop()->prep_cross_thread_msg(conn_id, ctx);
@@ -3,6 +3,7 @@
 #ifndef JDOCS_SERVICES_DOCUMENT_SERVICE_H_
 #define JDOCS_SERVICES_DOCUMENT_SERVICE_H_
 
+#include <deque>
 #include <memory>
 #include <shared_mutex>
 
@@ -37,12 +38,30 @@ public:
 
   static std::shared_ptr<Document> GetDocument(const std::string &doc_name);
 
-  static std::shared_ptr<Document> OpenDocument(std::string doc_name);
+  static std::shared_ptr<Document> OpenDocument(std::string doc_name,
+                                                uint32_t capacity);
 
   static bool CloseDocument(const std::string &doc_name);
 
+  // 获取所有打开文档的引用，热升级期间保证文档不会因用户全部移交而被释放
+  static std::vector<std::shared_ptr<Document>> SnapshotDocuments();
+
+  // 序列化文档内容，由新进程通过RestoreDocument恢复
+  static std::string SaveDocument(Document &doc);
+
+  // 恢复失败时返回nullptr，调用方需持有返回的文档直到用户会话恢复完毕
+  static std::shared_ptr<Document> RestoreDocument(const std::string &data,
+                                                   uint32_t capacity);
+
+  // 会话状态为当前打开的文档名
+  std::string SaveState() override;
+
+  bool RestoreState(const std::string &state) override;
+
   std::string handle(std::string data) override;
 
+  bool Idle() const override { return !offloading_ && backlog_.empty(); }
+
   std::string open_handle(docmsg_desc msg);
 
   std::string edit_handle(docmsg_desc msg);
@@ -50,12 +69,24 @@ public:
   std::string close_handle(docmsg_desc msg);
 
 private:
+  struct offload_job;
+
+  // 按消息类型分发给对应的处理函数
+  std::string dispatch(docmsg_desc msg);
+  // 将消息交给计算线程池处理，线程池不可用时返回false
+  bool offload(std::shared_ptr<offload_job> job);
+  // 在本线程中完成卸载的消息，发送回复并继续处理暂存的消息
+  void finish_offload(offload_job &job);
+
   static std::shared_mutex mutex_;
   static std::unordered_map<std::string, std::weak_ptr<Document>> documents_;
 
   std::shared_ptr<Document> document_{nullptr};
   std::list<uint32_t>::iterator node_;
   nlohmann::json json_;
+  // 有消息正在计算线程池中处理，之后到达的消息按顺序暂存，完成后再依次处理
+  bool offloading_{false};
+  std::deque<std::string> backlog_;
 };
 
 } // namespace jdocs
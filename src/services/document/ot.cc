@@ -2,7 +2,7 @@
 
 #include "ot.h"
 
-#include <spdlog/spdlog.h>
+#include "utils/logger.h"
 
 namespace jdocs {
 
@@ -82,19 +82,19 @@ Operation compose(const Operation &op_old, const Operation &op_new) {
   Operation result;
   OpIterator iterA(op_old);
   OpIterator iterB(op_new);
-  spdlog::warn("compose function.");
+  JDOCS_LOG_TRACE("compose function.");
   while (iterA.HasNext() || iterB.HasNext()) {
     auto comp_a = iterA.peek();
     auto comp_b = iterB.peek();
     if (comp_b.type == OpType::INSERT) {
-      spdlog::warn("compose function comp_b insert.");
+      JDOCS_LOG_TRACE("compose function comp_b insert.");
       result.OpInsert(std::move(comp_b.text), std::move(comp_b.attributes));
-      spdlog::warn("compose function comp_b insert finish.");
+      JDOCS_LOG_TRACE("compose function comp_b insert finish.");
       iterB.next(comp_b.length);
       continue;
     }
     if (comp_a.type == OpType::DELETE) {
-      spdlog::warn("compose function comp_a delete.");
+      JDOCS_LOG_TRACE("compose function comp_a delete.");
       result.OpDelete(comp_a.length);
       iterA.next(comp_a.length);
       continue;
@@ -102,7 +102,7 @@ Operation compose(const Operation &op_old, const Operation &op_new) {
     uint32_t min_len = std::min(comp_a.length, comp_b.length);
     if (comp_a.type == OpType::INSERT) {
       if (comp_b.type == OpType::RETAIN) {
-        spdlog::warn("compose function comp_a insert comp_b retain.");
+        JDOCS_LOG_TRACE("compose function comp_a insert comp_b retain.");
         // 可能携带属性
         result.OpInsert(comp_a.text.substr(0, min_len),
                         compose_attributes(std::move(comp_b.attributes),
@@ -112,10 +112,10 @@ Operation compose(const Operation &op_old, const Operation &op_new) {
       }
     } else if (comp_a.type == OpType::RETAIN) {
       if (comp_b.type == OpType::DELETE) {
-        spdlog::warn("compose function comp_a retain comp_b delete.");
+        JDOCS_LOG_TRACE("compose function comp_a retain comp_b delete.");
         result.OpDelete(min_len);
       } else if (comp_b.type == OpType::RETAIN) {
-        spdlog::warn("compose function comp_a retain comp_b retain.");
+        JDOCS_LOG_TRACE("compose function comp_a retain comp_b retain.");
         // 可能修改了原先的属性
         result.OpRetain(min_len,
                         compose_attributes(std::move(comp_b.attributes),
@@ -125,7 +125,7 @@ Operation compose(const Operation &op_old, const Operation &op_new) {
     iterA.next(min_len);
     iterB.next(min_len);
   }
-  spdlog::warn("compose function finish.");
+  JDOCS_LOG_TRACE("compose function finish.");
   return result;
 }
 
@@ -3,13 +3,23 @@
 #include "helpers.h"
 
 #include <cerrno>
+#include <csignal>
 #include <ctime>
 
+#include <linux/filter.h>
+#include <sys/signalfd.h>
+
 namespace jdocs {
 
 namespace {
 thread_local char local_date[20]{};
 thread_local time_t last_time = 0;
+
+void exit_signal_set(sigset_t *mask) {
+  sigemptyset(mask);
+  sigaddset(mask, SIGINT);
+  sigaddset(mask, SIGTERM);
+}
 } // namespace
 
 std::string get_datetime() {
@@ -23,7 +33,7 @@ std::string get_datetime() {
   return local_date;
 }
 
-int create_listening_socket(int port) {
+int create_listening_socket(int port, bool reuseport) {
   int listen_fd = socket(AF_INET, SOCK_STREAM, 0);
   if (listen_fd < 0) {
     spdlog::error("create listening socket failed. error: {}", strerror(errno));
@@ -37,6 +47,14 @@ int create_listening_socket(int port) {
     spdlog::error("setsockopt failed. error: {}", strerror(errno));
     return -1;
   }
+  if (reuseport) {
+    ret = setsockopt(listen_fd, SOL_SOCKET, SO_REUSEPORT, &enable, sizeof(int));
+    if (ret < 0) {
+      spdlog::error("setsockopt SO_REUSEPORT failed. error: {}",
+                    strerror(errno));
+      return -1;
+    }
+  }
 
   struct sockaddr_in addr{};
   addr.sin_addr.s_addr = htonl(INADDR_ANY);
@@ -58,6 +76,27 @@ int create_listening_socket(int port) {
   return listen_fd;
 }
 
+int attach_reuseport_cpu_program(int listen_fd, uint32_t group_size) {
+  struct sock_filter code[] = {
+      // A = 当前CPU编号
+      {BPF_LD | BPF_W | BPF_ABS, 0, 0,
+       static_cast<uint32_t>(SKF_AD_OFF + SKF_AD_CPU)},
+      // A = A % group_size
+      {BPF_ALU | BPF_MOD | BPF_K, 0, 0, group_size},
+      // 返回A作为组内套接字下标
+      {BPF_RET | BPF_A, 0, 0, 0},
+  };
+  struct sock_fprog prog = {.len = sizeof(code) / sizeof(code[0]),
+                            .filter = code};
+  if (setsockopt(listen_fd, SOL_SOCKET, SO_ATTACH_REUSEPORT_CBPF, &prog,
+                 sizeof(prog)) < 0) {
+    spdlog::error("setsockopt SO_ATTACH_REUSEPORT_CBPF failed. error: {}",
+                  strerror(errno));
+    return -1;
+  }
+  return 0;
+}
+
 void timespec_add_millis(timespec *ts, uint64_t millis) {
   ts->tv_sec += millis / 1000;
   ts->tv_nsec += (millis % 1000) * 1000000;
@@ -67,4 +106,19 @@ void timespec_add_millis(timespec *ts, uint64_t millis) {
   }
 }
 
+void block_exit_signals() {
+  sigset_t mask;
+  exit_signal_set(&mask);
+  pthread_sigmask(SIG_BLOCK, &mask, NULL);
+}
+
+int create_exit_signalfd() {
+  sigset_t mask;
+  exit_signal_set(&mask);
+  int fd = signalfd(-1, &mask, SFD_NONBLOCK | SFD_CLOEXEC);
+  if (fd < 0)
+    spdlog::error("signalfd failed. error: {}", strerror(errno));
+  return fd;
+}
+
 } // namespace jdocs
@@ -10,7 +10,12 @@
 
 namespace jdocs {
 
-int create_listening_socket(int port);
+// 创建监听套接字，reuseport为true时允许多个套接字监听同一端口
+int create_listening_socket(int port, bool reuseport = false);
+
+// 为reuseport组挂载cBPF程序，按接收连接的CPU编号对组大小取模选择监听套接字
+// 组内套接字的下标即为其开始监听的顺序
+int attach_reuseport_cpu_program(int listen_fd, uint32_t group_size);
 
 static inline uint64_t get_current_millis() {
   struct timespec ts;
@@ -18,8 +23,20 @@ static inline uint64_t get_current_millis() {
   return uint64_t(ts.tv_sec) * 1000 + uint64_t(ts.tv_nsec) / 1000000;
 }
 
+static inline uint64_t get_current_nanos() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return uint64_t(ts.tv_sec) * 1000000000 + uint64_t(ts.tv_nsec);
+}
+
 void timespec_add_millis(timespec *ts, uint64_t millis);
 
+// 屏蔽SIGINT与SIGTERM，需在创建任何线程之前调用，使所有线程都继承该屏蔽字
+void block_exit_signals();
+
+// 创建接收SIGINT与SIGTERM的signalfd，失败时返回-1
+int create_exit_signalfd();
+
 std::string get_datetime();
 
 } // namespace jdocs
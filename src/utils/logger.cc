@@ -0,0 +1,89 @@
+// Copyright (c) 2025-2026 Juantgd. All Rights Reserved.
+
+#include "logger.h"
+
+#include <chrono>
+#include <thread>
+
+namespace jdocs {
+
+namespace {
+
+// 后台线程在没有日志可输出时的休眠间隔
+constexpr auto kLogDrainInterval = std::chrono::milliseconds(1);
+
+std::atomic<AsyncLogger::log_ring *> log_rings[kMaxLogRings];
+std::atomic<uint32_t> log_ring_count{0};
+
+thread_local AsyncLogger::log_ring *local_ring = nullptr;
+thread_local bool local_ring_registered = false;
+
+std::thread drain_thread;
+
+} // namespace
+
+std::atomic<bool> AsyncLogger::running_{false};
+
+void AsyncLogger::Start() {
+  if (running_.exchange(true))
+    return;
+  drain_thread = std::thread(drain_main);
+}
+
+void AsyncLogger::Stop() {
+  if (!running_.exchange(false))
+    return;
+  drain_thread.join();
+  drain();
+  spdlog::default_logger_raw()->flush();
+}
+
+AsyncLogger::log_ring *AsyncLogger::LocalRing() {
+  if (local_ring_registered)
+    return local_ring;
+  local_ring_registered = true;
+  uint32_t index = log_ring_count.fetch_add(1, std::memory_order_relaxed);
+  if (index >= kMaxLogRings) {
+    spdlog::warn("log rings exhausted, falling back to synchronous logging.");
+    return nullptr;
+  }
+  local_ring = new log_ring;
+  log_rings[index].store(local_ring, std::memory_order_release);
+  return local_ring;
+}
+
+size_t AsyncLogger::drain() {
+  uint32_t count = log_ring_count.load(std::memory_order_relaxed);
+  if (count > kMaxLogRings)
+    count = kMaxLogRings;
+  spdlog::logger *logger = spdlog::default_logger_raw();
+  size_t drained = 0;
+  for (uint32_t i = 0; i != count; ++i) {
+    log_ring *ring = log_rings[i].load(std::memory_order_acquire);
+    if (!ring)
+      continue;
+    uint64_t head = ring->head.load(std::memory_order_relaxed);
+    uint64_t tail = ring->tail.load(std::memory_order_acquire);
+    for (; head != tail; ++head) {
+      const log_record &record = ring->records[head & kLogRingMask];
+      logger->log(record.time, spdlog::source_loc{}, record.level,
+                  spdlog::string_view_t(record.text, record.length));
+    }
+    drained += tail - ring->head.load(std::memory_order_relaxed);
+    ring->head.store(tail, std::memory_order_release);
+    uint64_t dropped = ring->dropped.exchange(0, std::memory_order_relaxed);
+    if (dropped)
+      logger->warn("{} log records dropped, log ring is full.", dropped);
+  }
+  return drained;
+}
+
+void AsyncLogger::drain_main() {
+  pthread_setname_np(pthread_self(), "logger");
+  while (running_.load(std::memory_order_relaxed)) {
+    if (drain() == 0)
+      std::this_thread::sleep_for(kLogDrainInterval);
+  }
+}
+
+} // namespace jdocs
@@ -0,0 +1,145 @@
+// Copyright (c) 2025-2026 Juantgd. All Rights Reserved.
+
+#ifndef JDOCS_UTILS_LOGGER_H_
+#define JDOCS_UTILS_LOGGER_H_
+
+#include <atomic>
+#include <cstdint>
+
+#include <spdlog/spdlog.h>
+
+// 编译期日志级别，低于该级别的日志调用会在编译期被完全消除
+#define JDOCS_LOG_LEVEL_TRACE 0
+#define JDOCS_LOG_LEVEL_DEBUG 1
+#define JDOCS_LOG_LEVEL_INFO 2
+#define JDOCS_LOG_LEVEL_WARN 3
+#define JDOCS_LOG_LEVEL_ERROR 4
+#define JDOCS_LOG_LEVEL_OFF 6
+
+#ifndef JDOCS_LOG_LEVEL
+#define JDOCS_LOG_LEVEL JDOCS_LOG_LEVEL_INFO
+#endif
+
+namespace jdocs {
+
+namespace {
+// 单条日志记录的最大文本长度，超出部分会被截断
+constexpr uint32_t kLogTextSize = 232;
+// 每个线程日志环形缓冲区的记录数量，必须为2的幂
+constexpr uint32_t kLogRingSize = 1 << 10;
+constexpr uint32_t kLogRingMask = kLogRingSize - 1;
+// 每个线程日志环形缓冲区的最大数量
+constexpr uint32_t kMaxLogRings = 256;
+} // namespace
+
+// 异步日志，每个线程拥有一个单生产者单消费者的无锁环形缓冲区
+// 日志调用只在本地完成格式化并写入环形缓冲区，由后台线程统一取出后交给spdlog输出
+// 未启动时退化为直接调用spdlog同步输出
+class AsyncLogger {
+public:
+  struct log_record {
+    spdlog::log_clock::time_point time;
+    spdlog::level::level_enum level;
+    uint32_t length;
+    char text[kLogTextSize];
+  };
+
+  struct alignas(64) log_ring {
+    // 消费者位置，只由后台线程写入
+    alignas(64) std::atomic<uint64_t> head{0};
+    // 生产者位置，只由所属线程写入
+    alignas(64) std::atomic<uint64_t> tail{0};
+    // 因缓冲区满而丢弃的日志数量
+    std::atomic<uint64_t> dropped{0};
+    log_record records[kLogRingSize];
+  };
+
+  // 启动后台输出线程
+  static void Start();
+  // 停止后台输出线程，并输出所有剩余日志
+  static void Stop();
+
+  static inline bool running() {
+    return running_.load(std::memory_order_relaxed);
+  }
+
+  template <typename... Args>
+  static void Log(spdlog::level::level_enum level,
+                  spdlog::format_string_t<Args...> fmt, Args &&...args) {
+    // 运行期级别过滤，避免格式化最终不会输出的日志
+    if (!spdlog::default_logger_raw()->should_log(level))
+      return;
+    if (!running()) {
+      spdlog::log(level, fmt, std::forward<Args>(args)...);
+      return;
+    }
+    log_ring *ring = LocalRing();
+    if (!ring) {
+      spdlog::log(level, fmt, std::forward<Args>(args)...);
+      return;
+    }
+    uint64_t tail = ring->tail.load(std::memory_order_relaxed);
+    if (tail - ring->head.load(std::memory_order_acquire) == kLogRingSize) {
+      ring->dropped.fetch_add(1, std::memory_order_relaxed);
+      return;
+    }
+    log_record &record = ring->records[tail & kLogRingMask];
+    record.time = spdlog::log_clock::now();
+    record.level = level;
+    auto result = fmt::format_to_n(record.text, kLogTextSize, fmt,
+                                   std::forward<Args>(args)...);
+    record.length = static_cast<uint32_t>(
+        result.size < kLogTextSize ? result.size : kLogTextSize);
+    ring->tail.store(tail + 1, std::memory_order_release);
+  }
+
+private:
+  // 获取当前线程的环形缓冲区，首次调用时进行注册
+  static log_ring *LocalRing();
+
+  static void drain_main();
+
+  // 取出所有线程缓冲区中的日志，返回取出的日志数量
+  static size_t drain();
+
+  static std::atomic<bool> running_;
+};
+
+} // namespace jdocs
+
+#if JDOCS_LOG_LEVEL <= JDOCS_LOG_LEVEL_TRACE
+#define JDOCS_LOG_TRACE(...)                                                   \
+  ::jdocs::AsyncLogger::Log(spdlog::level::trace, __VA_ARGS__)
+#else
+#define JDOCS_LOG_TRACE(...) (void)0
+#endif
+
+#if JDOCS_LOG_LEVEL <= JDOCS_LOG_LEVEL_DEBUG
+#define JDOCS_LOG_DEBUG(...)                                                   \
+  ::jdocs::AsyncLogger::Log(spdlog::level::debug, __VA_ARGS__)
+#else
+#define JDOCS_LOG_DEBUG(...) (void)0
+#endif
+
+#if JDOCS_LOG_LEVEL <= JDOCS_LOG_LEVEL_INFO
+#define JDOCS_LOG_INFO(...)                                                    \
+  ::jdocs::AsyncLogger::Log(spdlog::level::info, __VA_ARGS__)
+#else
+#define JDOCS_LOG_INFO(...) (void)0
+#endif
+
+#if JDOCS_LOG_LEVEL <= JDOCS_LOG_LEVEL_WARN
+#define JDOCS_LOG_WARN(...)                                                    \
+  ::jdocs::AsyncLogger::Log(spdlog::level::warn, __VA_ARGS__)
+#else
+#define JDOCS_LOG_WARN(...) (void)0
+#endif
+
+#if JDOCS_LOG_LEVEL <= JDOCS_LOG_LEVEL_ERROR
+#define JDOCS_LOG_ERROR(...)                                                   \
+  ::jdocs::AsyncLogger::Log(spdlog::level::err, __VA_ARGS__)
+#else
+#define JDOCS_LOG_ERROR(...) (void)0
+#endif
+
+#endif
@@ -0,0 +1,193 @@
+// Copyright (c) 2025-2026 Juantgd. All Rights Reserved.
+
+#include "numa.h"
+
+#include <cerrno>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+
+#include <dirent.h>
+#include <linux/mempolicy.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <spdlog/spdlog.h>
+
+// MADV_POPULATE_WRITE自5.14起可用，旧的头文件中没有定义
+#ifndef MADV_POPULATE_WRITE
+#define MADV_POPULATE_WRITE 23
+#endif
+
+#ifndef MAP_HUGE_2MB
+#define MAP_HUGE_2MB (21 << MAP_HUGE_SHIFT)
+#endif
+
+namespace jdocs {
+
+namespace {
+
+bool parse_cpu(const std::string &str, int *cpu) {
+  if (str.empty() || str[0] < '0' || str[0] > '9')
+    return false;
+  char *end = nullptr;
+  errno = 0;
+  long result = strtol(str.c_str(), &end, 10);
+  if (errno || *end != '\0' || result >= CPU_SETSIZE)
+    return false;
+  *cpu = static_cast<int>(result);
+  return true;
+}
+
+} // namespace
+
+bool parse_cpu_list(const std::string &str, std::vector<int> *cpus) {
+  cpus->clear();
+  if (str == "auto") {
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    if (sched_getaffinity(0, sizeof(set), &set))
+      return false;
+    for (int i = 0; i < CPU_SETSIZE; ++i) {
+      if (CPU_ISSET(i, &set))
+        cpus->push_back(i);
+    }
+    return !cpus->empty();
+  }
+  size_t begin = 0;
+  while (begin <= str.size()) {
+    size_t end = str.find(',', begin);
+    if (end == std::string::npos)
+      end = str.size();
+    std::string item = str.substr(begin, end - begin);
+    size_t dash = item.find('-');
+    int first, last;
+    if (dash == std::string::npos) {
+      if (!parse_cpu(item, &first))
+        return false;
+      last = first;
+    } else if (!parse_cpu(item.substr(0, dash), &first) ||
+               !parse_cpu(item.substr(dash + 1), &last) || first > last) {
+      return false;
+    }
+    for (int cpu = first; cpu <= last; ++cpu)
+      cpus->push_back(cpu);
+    begin = end + 1;
+  }
+  return !cpus->empty();
+}
+
+int pin_thread_to_cpu(int cpu) {
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  CPU_SET(cpu, &set);
+  int ret = pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+  if (ret) {
+    spdlog::error("pthread_setaffinity_np to cpu {} failed. error: {}", cpu,
+                  strerror(ret));
+    return -1;
+  }
+  return 0;
+}
+
+int cpu_to_node(int cpu) {
+  std::string path("/sys/devices/system/cpu/cpu");
+  path.append(std::to_string(cpu));
+  DIR *dir = opendir(path.c_str());
+  if (!dir)
+    return -1;
+  int node = -1;
+  struct dirent *entry;
+  // CPU目录下存在指向其所在节点的nodeN链接
+  while ((entry = readdir(dir)) != nullptr) {
+    if (strncmp(entry->d_name, "node", 4) == 0 && entry->d_name[4] >= '0' &&
+        entry->d_name[4] <= '9') {
+      node = atoi(entry->d_name + 4);
+      break;
+    }
+  }
+  closedir(dir);
+  return node;
+}
+
+int set_preferred_node(int node) {
+  constexpr int kMaxNodes = sizeof(unsigned long) * 8;
+  if (node < 0 || node >= kMaxNodes)
+    return -1;
+  unsigned long mask = 1UL << node;
+  // 内核会忽略最高位，因此节点数量需要加一
+  if (syscall(SYS_set_mempolicy, MPOL_PREFERRED, &mask, kMaxNodes + 1)) {
+    spdlog::error("set_mempolicy to node {} failed. error: {}", node,
+                  strerror(errno));
+    return -1;
+  }
+  return 0;
+}
+
+int bind_thread(int cpu, bool local) {
+  if (pin_thread_to_cpu(cpu))
+    return -1;
+  if (!local)
+    return 0;
+  int node = cpu_to_node(cpu);
+  // 非NUMA系统上不存在节点信息，无需设置内存策略
+  if (node < 0)
+    return 0;
+  return set_preferred_node(node);
+}
+
+void *alloc_block(size_t size) {
+  // MAP_POPULATE使物理页在当前线程中立即分配，从而遵循当前线程的内存策略
+  void *addr = mmap(nullptr, size, PROT_READ | PROT_WRITE,
+                    MAP_PRIVATE | MAP_ANONYMOUS | MAP_POPULATE, -1, 0);
+  if (addr == MAP_FAILED) {
+    spdlog::error("mmap block of {} bytes failed. error: {}", size,
+                  strerror(errno));
+    return nullptr;
+  }
+  return addr;
+}
+
+void *alloc_huge_block(size_t size, bool *hugetlb) {
+  if (*hugetlb) {
+    void *addr = mmap(nullptr, size, PROT_READ | PROT_WRITE,
+                      MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB | MAP_HUGE_2MB |
+                          MAP_POPULATE,
+                      -1, 0);
+    if (addr != MAP_FAILED)
+      return addr;
+    *hugetlb = false;
+  }
+  // 多映射一个大页用于对齐，透明大页只会出现在按2MB对齐的区域中
+  size_t length = size + kHugePageSize;
+  char *base = static_cast<char *>(mmap(nullptr, length, PROT_READ | PROT_WRITE,
+                                        MAP_PRIVATE | MAP_ANONYMOUS, -1, 0));
+  if (base == MAP_FAILED) {
+    spdlog::error("mmap block of {} bytes failed. error: {}", length,
+                  strerror(errno));
+    return nullptr;
+  }
+  char *addr = reinterpret_cast<char *>(
+      (reinterpret_cast<uintptr_t>(base) + kHugePageSize - 1) &
+      ~(kHugePageSize - 1));
+  if (addr != base)
+    munmap(base, addr - base);
+  if (base + length != addr + size)
+    munmap(addr + size, base + length - (addr + size));
+  // 透明大页关闭（never）时仍可使用普通页
+  if (madvise(addr, size, MADV_HUGEPAGE))
+    spdlog::debug("madvise(MADV_HUGEPAGE) failed. error: {}", strerror(errno));
+  // 与MAP_POPULATE相同，在当前线程中立即分配物理页，旧内核上逐页写入
+  if (madvise(addr, size, MADV_POPULATE_WRITE)) {
+    for (size_t i = 0; i < size; i += 4096)
+      addr[i] = 0;
+  }
+  return addr;
+}
+
+void free_block(void *addr, size_t size) { munmap(addr, size); }
+
+} // namespace jdocs
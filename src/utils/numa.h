@@ -0,0 +1,48 @@
+// Copyright (c) 2025-2026 Juantgd. All Rights Reserved.
+
+#ifndef JDOCS_UTILS_NUMA_H_
+#define JDOCS_UTILS_NUMA_H_
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+namespace jdocs {
+
+// 解析CPU列表，格式为逗号分隔的CPU编号或范围，如"0-3,8,10-11"
+// "auto"表示进程当前允许运行的全部CPU，解析失败时返回false
+bool parse_cpu_list(const std::string &str, std::vector<int> *cpus);
+
+// 将当前线程绑定到指定CPU上，失败时返回-1
+int pin_thread_to_cpu(int cpu);
+
+// 获取CPU所在的NUMA节点，无法获取时返回-1
+int cpu_to_node(int cpu);
+
+// 设置当前线程的内存分配策略为优先从指定NUMA节点分配
+// 之后由该线程首次访问的内存页都会优先分配在该节点上，失败时返回-1
+int set_preferred_node(int node);
+
+// 将当前线程绑定到指定CPU上，local为true时同时设置内存优先从该CPU所在节点分配
+// 失败时返回-1
+int bind_thread(int cpu, bool local);
+
+// 分配一块页对齐的内存块，并立即按当前线程的内存策略分配物理页
+// 失败时返回nullptr
+void *alloc_block(size_t size);
+
+// 2MB大页的大小
+constexpr size_t kHugePageSize = 2 << 20;
+
+// 分配一块由2MB大页支撑的内存块，size需为kHugePageSize的整数倍
+// *hugetlb为true时先尝试预留的大页（MAP_HUGETLB），没有可用的大页时
+// 退回透明大页（按大页对齐后madvise(MADV_HUGEPAGE)），返回时*hugetlb表示实际使用的方式
+// 与alloc_block相同，物理页会立即按当前线程的内存策略分配，失败时返回nullptr
+void *alloc_huge_block(size_t size, bool *hugetlb);
+
+// 释放alloc_block或alloc_huge_block分配的内存块
+void free_block(void *addr, size_t size);
+
+} // namespace jdocs
+
+#endif
@@ -0,0 +1,124 @@
+// Copyright (c) 2025-2026 Juantgd. All Rights Reserved.
+
+#ifndef JDOCS_UTILS_SLAB_H_
+#define JDOCS_UTILS_SLAB_H_
+
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <utility>
+#include <vector>
+
+namespace jdocs {
+
+// 固定容量的对象槽位表，通过句柄访问，只能由单个线程使用
+// 句柄低位为槽位下标，其余高位为槽位的代数，槽位每次释放后代数加一，
+// 因此持有已释放槽位旧句柄的访问只需比较代数即可发现，代数从1开始，句柄不会为0
+template <typename T> class Slab {
+public:
+  // handle_bits为句柄的总位数，需大于容量所需的下标位数
+  Slab(uint32_t capacity, unsigned handle_bits)
+      : slots_(new slot[capacity]), capacity_(capacity) {
+    while ((1U << index_bits_) < capacity)
+      ++index_bits_;
+    max_gen_ = (1U << (handle_bits - index_bits_)) - 1;
+    free_.reserve(capacity);
+    // 优先分配下标较小的槽位
+    for (uint32_t i = capacity; i != 0; --i)
+      free_.push_back(i - 1);
+  }
+  ~Slab() {
+    for (uint32_t i = 0; i != capacity_; ++i)
+      if (slots_[i].live)
+        slots_[i].get()->~T();
+  }
+
+  Slab(const Slab &) = delete;
+  Slab &operator=(const Slab &) = delete;
+
+  // 分配一个槽位，返回其句柄，槽位已满时返回0
+  // 句柄分配后即可通过Emplace在槽位中构造对象
+  uint32_t Allocate() {
+    if (free_.empty())
+      return 0;
+    uint32_t index = free_.back();
+    free_.pop_back();
+    slots_[index].used = true;
+    return (slots_[index].gen << index_bits_) | index;
+  }
+
+  // 在已分配的槽位中构造对象，句柄无效时返回nullptr
+  template <typename... Args> T *Emplace(uint32_t handle, Args &&...args) {
+    slot *s = lookup(handle);
+    if (!s || s->live)
+      return nullptr;
+    T *object = new (s->storage) T(std::forward<Args>(args)...);
+    s->live = true;
+    ++size_;
+    return object;
+  }
+
+  // 句柄无效或已过期时返回nullptr
+  inline T *Get(uint32_t handle) {
+    slot *s = lookup(handle);
+    return s && s->live ? s->get() : nullptr;
+  }
+
+  // 析构槽位中的对象并回收槽位，该槽位之前的句柄全部失效
+  // 句柄无效时返回false
+  bool Free(uint32_t handle) {
+    slot *s = lookup(handle);
+    if (!s)
+      return false;
+    if (s->live) {
+      s->get()->~T();
+      s->live = false;
+      --size_;
+    }
+    s->used = false;
+    s->gen = s->gen == max_gen_ ? 1 : s->gen + 1;
+    free_.push_back(handle & index_mask());
+    return true;
+  }
+
+  // 按槽位下标访问对象，用于遍历所有对象，槽位中没有对象时返回nullptr
+  inline T *At(uint32_t index) {
+    return slots_[index].live ? slots_[index].get() : nullptr;
+  }
+
+  inline uint32_t capacity() const { return capacity_; }
+  inline uint32_t size() const { return size_; }
+
+private:
+  struct slot {
+    alignas(T) unsigned char storage[sizeof(T)];
+    uint32_t gen{1};
+    // 槽位已分配
+    bool used{false};
+    // 槽位中已构造对象
+    bool live{false};
+    inline T *get() { return std::launder(reinterpret_cast<T *>(storage)); }
+  };
+
+  inline uint32_t index_mask() const { return (1U << index_bits_) - 1; }
+
+  inline slot *lookup(uint32_t handle) {
+    uint32_t index = handle & index_mask();
+    if (index >= capacity_ || !slots_[index].used ||
+        slots_[index].gen != handle >> index_bits_)
+      return nullptr;
+    return &slots_[index];
+  }
+
+  std::unique_ptr<slot[]> slots_;
+  // 空闲槽位下标，后进先出，优先复用刚释放且仍在缓存中的槽位
+  std::vector<uint32_t> free_;
+  uint32_t capacity_;
+  uint32_t size_{0};
+  unsigned index_bits_{0};
+  uint32_t max_gen_;
+};
+
+} // namespace jdocs
+
+#endif
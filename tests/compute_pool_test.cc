@@ -0,0 +1,59 @@
+// Copyright (c) 2025-2026 Juantgd. All Rights Reserved.
+
+#include "core/compute_pool.h"
+
+#include <atomic>
+#include <future>
+#include <thread>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+using namespace jdocs;
+
+TEST(ComputePoolTest, ComputePoolRunTest) {
+  constexpr int kProducers = 4;
+  constexpr int kJobs = 10000;
+  std::atomic<int> sum{0};
+  std::atomic<int> done{0};
+  {
+    ComputePool pool(3, kProducers * kJobs);
+    std::vector<std::thread> producers;
+    for (int p = 0; p != kProducers; ++p)
+      producers.emplace_back([&pool, &sum, &done] {
+        for (int i = 0; i != kJobs; ++i)
+          ASSERT_TRUE(pool.Submit([&sum, &done, i] {
+            sum.fetch_add(i, std::memory_order_relaxed);
+            done.fetch_add(1, std::memory_order_release);
+          }));
+      });
+    for (auto &producer : producers)
+      producer.join();
+    while (done.load(std::memory_order_acquire) != kProducers * kJobs)
+      std::this_thread::yield();
+  }
+  EXPECT_EQ(sum.load(), kProducers * (kJobs - 1) * kJobs / 2);
+}
+
+TEST(ComputePoolTest, ComputePoolCapacityTest) {
+  ComputePool pool(1, 2);
+  std::promise<void> started, release;
+  std::shared_future<void> gate = release.get_future().share();
+  // 占住唯一的计算线程，之后提交的任务只能在队列中等待
+  ASSERT_TRUE(pool.Submit([&started, gate] {
+    started.set_value();
+    gate.wait();
+  }));
+  started.get_future().wait();
+  std::atomic<int> count{0};
+  EXPECT_TRUE(pool.Submit([&count] { ++count; }));
+  EXPECT_TRUE(pool.Submit([&count] { ++count; }));
+  EXPECT_FALSE(pool.Submit([&count] { ++count; }));
+  release.set_value();
+  while (count.load() != 2)
+    std::this_thread::yield();
+  // 队列中的任务被取出后可以继续提交
+  EXPECT_TRUE(pool.Submit([&count] { ++count; }));
+  while (count.load() != 3)
+    std::this_thread::yield();
+}
@@ -0,0 +1,224 @@
+// Copyright (c) 2025-2026 Juantgd. All Rights Reserved.
+
+#include "core/config.h"
+
+#include <cstdio>
+#include <fstream>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+using namespace jdocs;
+
+TEST(ConfigTest, ConfigSetTest) {
+  ServerConfig config;
+  ASSERT_EQ(config.port, 7788);
+  ASSERT_EQ(config.buffer_size, 2048);
+  ASSERT_TRUE(config.Set("port", "8080"));
+  ASSERT_EQ(config.port, 8080);
+  ASSERT_TRUE(config.Set("queue_depth", "0x1000"));
+  ASSERT_EQ(config.queue_depth, 4096);
+  ASSERT_FALSE(config.Set("port", "-1"));
+  ASSERT_FALSE(config.Set("port", "80a"));
+  ASSERT_FALSE(config.Set("port", ""));
+  ASSERT_FALSE(config.Set("unknown", "1"));
+  ASSERT_EQ(config.port, 8080);
+}
+
+TEST(ConfigTest, ConfigRingModeTest) {
+  ServerConfig config;
+  ASSERT_EQ(config.ring_mode, kRingModeDeferTaskrun);
+  ASSERT_TRUE(config.Set("ring_mode", "sqpoll"));
+  ASSERT_EQ(config.ring_mode, kRingModeSqpoll);
+  ASSERT_TRUE(config.Set("ring_mode", "coop"));
+  ASSERT_EQ(config.ring_mode, kRingModeCoopTaskrun);
+  ASSERT_FALSE(config.Set("ring_mode", "poll"));
+  ASSERT_EQ(config.ring_mode, kRingModeCoopTaskrun);
+  ASSERT_TRUE(config.Set("sqpoll_cpu", "0"));
+  ASSERT_EQ(config.sqpoll_cpu, 0);
+  ASSERT_TRUE(config.Validate());
+  ASSERT_TRUE(config.Set("sqpoll_cpu", "-2"));
+  ASSERT_FALSE(config.Validate());
+  ASSERT_TRUE(config.Set("sqpoll_shared", "true"));
+  ASSERT_TRUE(config.sqpoll_shared);
+  ASSERT_TRUE(config.Set("sqpoll_shared", "0"));
+  ASSERT_FALSE(config.sqpoll_shared);
+  ASSERT_FALSE(config.Set("sqpoll_shared", "yes"));
+}
+
+TEST(ConfigTest, ConfigAcceptModeTest) {
+  ServerConfig config;
+  ASSERT_EQ(config.accept_mode, kAcceptModeMaster);
+  ASSERT_TRUE(config.Set("accept_mode", "reuseport"));
+  ASSERT_EQ(config.accept_mode, kAcceptModeReuseport);
+  ASSERT_TRUE(config.Set("reuseport_steering", "bpf"));
+  ASSERT_EQ(config.reuseport_steering, kSteeringBpf);
+  ASSERT_TRUE(config.Validate());
+  // 按接收CPU引导连接需要绑定worker线程
+  ASSERT_TRUE(config.Set("reuseport_steering", "cpu"));
+  ASSERT_FALSE(config.Validate());
+  ASSERT_TRUE(config.Set("worker_cpus", "0"));
+  ASSERT_TRUE(config.Validate());
+  ASSERT_FALSE(config.Set("reuseport_steering", "rss"));
+}
+
+TEST(ConfigTest, ConfigDispatchPolicyTest) {
+  ServerConfig config;
+  ASSERT_EQ(config.dispatch_policy, kDispatchRoundRobin);
+  ASSERT_TRUE(config.Set("dispatch_policy", "least_conn"));
+  ASSERT_EQ(config.dispatch_policy, kDispatchLeastConn);
+  ASSERT_TRUE(config.Set("dispatch_policy", "least_cpu"));
+  ASSERT_EQ(config.dispatch_policy, kDispatchLeastCpu);
+  ASSERT_TRUE(config.Set("dispatch_policy", "p2c"));
+  ASSERT_EQ(config.dispatch_policy, kDispatchPowerOfTwo);
+  ASSERT_FALSE(config.Set("dispatch_policy", "random"));
+}
+
+TEST(ConfigTest, ConfigSlowConsumerTest) {
+  ServerConfig config;
+  ASSERT_EQ(config.slow_consumer, kSlowConsumerDrop);
+  ASSERT_TRUE(config.Set("slow_consumer", "disconnect"));
+  ASSERT_EQ(config.slow_consumer, kSlowConsumerDisconnect);
+  ASSERT_TRUE(config.Set("slow_consumer", "wait"));
+  ASSERT_EQ(config.slow_consumer, kSlowConsumerWait);
+  ASSERT_FALSE(config.Set("slow_consumer", "block"));
+  ASSERT_TRUE(config.Set("send_queue_budget", "0"));
+  ASSERT_FALSE(config.Validate());
+}
+
+TEST(ConfigTest, ConfigRecvBufferSizesTest) {
+  ServerConfig config;
+  std::vector<uint32_t> sizes;
+  ASSERT_TRUE(config.RecvBufferSizes(&sizes));
+  ASSERT_EQ(sizes, (std::vector<uint32_t>{512, 4096, 65536}));
+  ASSERT_TRUE(config.Set("recv_buffer_sizes", "256, 2048"));
+  ASSERT_TRUE(config.Validate());
+  ASSERT_TRUE(config.RecvBufferSizes(&sizes));
+  ASSERT_EQ(sizes, (std::vector<uint32_t>{256, 2048}));
+  // 为空时只使用buffer_size
+  ASSERT_TRUE(config.Set("recv_buffer_sizes", ""));
+  ASSERT_TRUE(config.Validate());
+  ASSERT_TRUE(config.RecvBufferSizes(&sizes));
+  ASSERT_EQ(sizes, (std::vector<uint32_t>{config.buffer_size}));
+  // 必须为从小到大排列的2的幂
+  ASSERT_TRUE(config.Set("recv_buffer_sizes", "4096,512"));
+  ASSERT_FALSE(config.Validate());
+  ASSERT_TRUE(config.Set("recv_buffer_sizes", "1000"));
+  ASSERT_FALSE(config.Validate());
+  ASSERT_TRUE(config.Set("recv_buffer_sizes", "512,,4096"));
+  ASSERT_FALSE(config.Validate());
+  ASSERT_TRUE(config.Set("recv_buffer_sizes", "64,128,256,512,1024,2048,4096,"
+                                              "8192,16384"));
+  ASSERT_FALSE(config.Validate());
+}
+
+TEST(ConfigTest, ConfigValidateTest) {
+  {
+    ServerConfig config;
+    ASSERT_TRUE(config.Validate());
+  }
+  {
+    // 缓冲区大小必须为2的幂
+    ServerConfig config;
+    config.buffer_size = 3000;
+    ASSERT_FALSE(config.Validate());
+  }
+  {
+    // 块大小会被修正为缓冲区大小的2的幂倍
+    ServerConfig config;
+    config.buffer_size = 4096;
+    config.block_size = 4096 * 100;
+    ASSERT_TRUE(config.Validate());
+    ASSERT_EQ(config.block_size, 4096 * 128);
+  }
+  {
+    // 大页模式下块大小至少为一个2MB大页
+    ServerConfig config;
+    ASSERT_TRUE(config.Set("buffer_hugepages", "hugetlb"));
+    ASSERT_TRUE(config.Validate());
+    ASSERT_EQ(config.block_size, 2 << 20);
+    ASSERT_FALSE(config.Set("buffer_hugepages", "1g"));
+  }
+  {
+    // 缓冲区条目数量不能少于每块缓冲区数量
+    ServerConfig config;
+    config.buffer_entries_max = 128;
+    ASSERT_FALSE(config.Validate());
+    config.buffer_entries_max = 1 << 20;
+    ASSERT_TRUE(config.Validate());
+    ASSERT_EQ(config.buffer_entries_max, 1 << 15);
+  }
+  {
+    // 关闭通知的分散时间不能超过平滑退出期限
+    ServerConfig config;
+    config.drain_timeout = 1000;
+    ASSERT_FALSE(config.Validate());
+    config.drain_pace = 1000;
+    ASSERT_TRUE(config.Validate());
+  }
+  {
+    ServerConfig config;
+    config.upgrade = true;
+    ASSERT_FALSE(config.Validate());
+    config.upgrade_socket = "/tmp/jdocs.sock";
+    ASSERT_TRUE(config.Validate());
+  }
+  {
+    ServerConfig config;
+    config.accept_resume_watermark = config.accept_pause_watermark;
+    ASSERT_FALSE(config.Validate());
+    config.accept_pause_watermark = 101;
+    ASSERT_FALSE(config.Validate());
+    config.accept_pause_watermark = 100;
+    ASSERT_TRUE(config.Validate());
+  }
+  {
+    ServerConfig config;
+    config.wait_batch_max = 0;
+    ASSERT_FALSE(config.Validate());
+    config.wait_batch_max = config.queue_depth + 1;
+    ASSERT_FALSE(config.Validate());
+    config.wait_batch_max = 16;
+    config.wait_timeout_us = 0;
+    ASSERT_FALSE(config.Validate());
+    config.wait_timeout_us = 50;
+    ASSERT_TRUE(config.Validate());
+  }
+  {
+    ServerConfig config;
+    config.compute_queue_capacity = 0;
+    ASSERT_FALSE(config.Validate());
+    // 不启用计算线程池时不检查队列容量
+    config.compute_threads = 0;
+    ASSERT_TRUE(config.Validate());
+  }
+}
+
+TEST(ConfigTest, ConfigParseArgsTest) {
+  const char *path = "config_test.conf";
+  {
+    std::ofstream file(path);
+    file << "# comment\n\nport = 9000\n  worker_threads=4  \ntimer_tick = 50\n";
+  }
+  {
+    ServerConfig config;
+    const char *argv[] = {"jdocs", "--timer_tick=10",
+                          "--config=config_test.conf"};
+    ASSERT_TRUE(config.ParseArgs(3, const_cast<char **>(argv)));
+    ASSERT_EQ(config.port, 9000);
+    ASSERT_EQ(config.worker_threads, 4);
+    // 命令行参数覆盖配置文件
+    ASSERT_EQ(config.timer_tick, 10);
+  }
+  {
+    ServerConfig config;
+    const char *argv[] = {"jdocs", "port=1"};
+    ASSERT_FALSE(config.ParseArgs(2, const_cast<char **>(argv)));
+  }
+  {
+    ServerConfig config;
+    const char *argv[] = {"jdocs", "--config=not_exists.conf"};
+    ASSERT_FALSE(config.ParseArgs(2, const_cast<char **>(argv)));
+  }
+  remove(path);
+}
@@ -0,0 +1,89 @@
+// Copyright (c) 2025-2026 Juantgd. All Rights Reserved.
+
+#include "core/coro.h"
+
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+using namespace jdocs;
+
+namespace {
+
+Task<int> add(Completion<int> &a, Completion<int> &b) {
+  int x = co_await a;
+  int y = co_await b;
+  co_return x + y;
+}
+
+Task<std::string> nested(Completion<int> &a, Completion<int> &b) {
+  int sum = co_await add(a, b);
+  co_return std::to_string(sum);
+}
+
+Task<int> fail() {
+  throw std::runtime_error("failed");
+  co_return 0;
+}
+
+} // namespace
+
+TEST(CoroTest, CoroTaskTest) {
+  TaskGroup group;
+  Completion<int> a, b;
+  std::string result;
+  group.Spawn([](Completion<int> &a, Completion<int> &b,
+                 std::string *result) -> Task<void> {
+    *result = co_await nested(a, b);
+  }(a, b, &result));
+  // 任务挂起等待第一个结果
+  ASSERT_EQ(group.size(), 1);
+  ASSERT_TRUE(result.empty());
+  a.Set(1);
+  ASSERT_EQ(group.size(), 1);
+  b.Set(2);
+  // 任务结束后从任务组中移除
+  ASSERT_EQ(group.size(), 0);
+  ASSERT_EQ(result, "3");
+}
+
+TEST(CoroTest, CoroExceptionTest) {
+  TaskGroup group;
+  bool caught = false;
+  group.Spawn([](bool *caught) -> Task<void> {
+    try {
+      co_await fail();
+    } catch (const std::runtime_error &) {
+      *caught = true;
+    }
+  }(&caught));
+  ASSERT_TRUE(caught);
+  ASSERT_EQ(group.size(), 0);
+  // 分离运行的任务中未捕获的异常只记录日志
+  group.Spawn([]() -> Task<void> { co_await fail(); }());
+  ASSERT_EQ(group.size(), 0);
+}
+
+TEST(CoroTest, CoroGroupDestroyTest) {
+  std::vector<int> destroyed;
+  struct guard {
+    std::vector<int> *destroyed;
+    int id;
+    ~guard() { destroyed->push_back(id); }
+  };
+  Completion<int> never;
+  {
+    TaskGroup group;
+    for (int i = 0; i != 3; ++i)
+      group.Spawn([](Completion<int> &never, std::vector<int> *destroyed,
+                     int id) -> Task<void> {
+        guard g{destroyed, id};
+        co_await never;
+      }(never, &destroyed, i));
+    ASSERT_EQ(group.size(), 3);
+  }
+  // 任务组析构时销毁所有挂起中的任务
+  ASSERT_EQ(destroyed.size(), 3);
+}
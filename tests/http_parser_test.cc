@@ -125,3 +125,19 @@ TEST(HttpParserTest, HttpParserUriTest) {
     ASSERT_STREQ(files[2].c_str(), "video.mp4");
   }
 }
+
+// 不含websocket握手字段的普通GET请求同样解析完成，由调用方按路径处理
+TEST(HttpParserTest, HttpParserPlainGetTest) {
+  const char *request = "GET /metrics HTTP/1.1\r\nHost: example.com\r\n\r\n";
+  HttpParser parser;
+  parser.ParserExecute((void *)request, strlen(request));
+  ASSERT_TRUE(parser.IsDone());
+  ASSERT_EQ(parser.GetErrorCode(), 0);
+  ASSERT_FALSE(parser.IsWebsocketHandshake());
+  ASSERT_STREQ(parser.location_.c_str(), "/metrics");
+  parser.Reset();
+  for (const char *line : request1)
+    parser.ParserExecute((void *)line, strlen(line));
+  ASSERT_TRUE(parser.IsDone());
+  ASSERT_TRUE(parser.IsWebsocketHandshake());
+}
@@ -0,0 +1,88 @@
+// Copyright (c) 2025-2026 Juantgd. All Rights Reserved.
+
+#include "core/mailbox.h"
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+using namespace jdocs;
+
+TEST(MailboxTest, MailboxBasicTest) {
+  Mailbox<int> mailbox(4);
+  ASSERT_EQ(mailbox.capacity(), 4);
+  // 只有由空变为非空时需要发送门铃
+  ASSERT_EQ(mailbox.Push(1), 1);
+  ASSERT_EQ(mailbox.Push(2), 0);
+  ASSERT_EQ(mailbox.Push(3), 0);
+  ASSERT_EQ(mailbox.Push(4), 0);
+  ASSERT_EQ(mailbox.Push(5), -1);
+  std::vector<int> values;
+  ASSERT_EQ(mailbox.Drain([&](int v) { values.push_back(v); }), 4);
+  ASSERT_EQ(values, std::vector<int>({1, 2, 3, 4}));
+  ASSERT_EQ(mailbox.Drain([&](int v) { values.push_back(v); }), 0);
+  // 取空后再次写入需要重新发送门铃
+  ASSERT_EQ(mailbox.Push(6), 1);
+  ASSERT_EQ(mailbox.Push(7), 0);
+  values.clear();
+  ASSERT_EQ(mailbox.Drain([&](int v) { values.push_back(v); }), 2);
+  ASSERT_EQ(values, std::vector<int>({6, 7}));
+}
+
+TEST(MailboxTest, MailboxConcurrentTest) {
+  constexpr uint32_t kProducers = 4;
+  constexpr uint32_t kMessages = 100000;
+  Mailbox<uint64_t> mailbox(256);
+  // 模拟门铃，生产者每发送一次门铃加一
+  std::atomic<uint32_t> doorbells{0};
+  std::vector<std::thread> producers;
+  for (uint32_t p = 0; p != kProducers; ++p) {
+    producers.emplace_back([&, p] {
+      for (uint32_t i = 0; i != kMessages; ++i) {
+        int ret;
+        while ((ret = mailbox.Push((uint64_t(p) << 32) | i)) == -1)
+          std::this_thread::yield();
+        if (ret == 1)
+          doorbells.fetch_add(1, std::memory_order_release);
+      }
+    });
+  }
+  std::vector<uint32_t> next(kProducers, 0);
+  uint64_t received = 0;
+  bool ordered = true;
+  while (received != uint64_t(kProducers) * kMessages) {
+    uint32_t rings = doorbells.load(std::memory_order_acquire);
+    if (rings == 0) {
+      std::this_thread::yield();
+      continue;
+    }
+    doorbells.fetch_sub(1, std::memory_order_relaxed);
+    received += mailbox.Drain([&](uint64_t v) {
+      uint32_t p = v >> 32;
+      // 同一生产者的消息保持先后顺序
+      if ((v & 0xFFFFFFFF) != next[p]++)
+        ordered = false;
+    });
+  }
+  for (auto &producer : producers)
+    producer.join();
+  ASSERT_TRUE(ordered);
+  for (uint32_t p = 0; p != kProducers; ++p)
+    ASSERT_EQ(next[p], kMessages);
+  // 所有消息都已被取出，不应存在多余的门铃
+  ASSERT_EQ(doorbells.load(), 0);
+}
+
+TEST(MailboxTest, MailboxCloseTest) {
+  Mailbox<int> mailbox(4);
+  ASSERT_FALSE(mailbox.closed());
+  ASSERT_EQ(mailbox.Push(1), 1);
+  mailbox.Close();
+  ASSERT_TRUE(mailbox.closed());
+  // 关闭前写入的消息仍可由消费者取出
+  std::vector<int> values;
+  ASSERT_EQ(mailbox.Drain([&](int v) { values.push_back(v); }), 1);
+  ASSERT_EQ(values, std::vector<int>({1}));
+}
@@ -0,0 +1,34 @@
+// Copyright (c) 2025-2026 Juantgd. All Rights Reserved.
+
+#include "core/metrics.h"
+
+#include <thread>
+
+#include <gtest/gtest.h>
+
+TEST(MetricsTest, MetricsExportTest) {
+  using namespace jdocs;
+  // 未注册线程的更新写入占位槽，不会被导出
+  metrics_add(METRIC_ACCEPTS, 100);
+  std::thread thread([]() {
+    Metrics *metrics = Metrics::Register("test-0");
+    ASSERT_NE(metrics, nullptr);
+    metrics_add(METRIC_ACCEPTS);
+    metrics_add(METRIC_ACCEPTS, 2);
+    metrics_add(METRIC_CONNECTIONS, 5);
+    metrics_add(METRIC_CONNECTIONS, -1);
+    ASSERT_EQ(metrics->Get(METRIC_ACCEPTS), 3);
+    ASSERT_EQ(metrics->Get(METRIC_CONNECTIONS), 4);
+  });
+  thread.join();
+  std::string text = Metrics::Export();
+  ASSERT_NE(text.find("# TYPE jdocs_accepts_total counter\n"),
+            std::string::npos);
+  ASSERT_NE(text.find("# TYPE jdocs_open_connections gauge\n"),
+            std::string::npos);
+  ASSERT_NE(text.find("jdocs_accepts_total{thread=\"test-0\"} 3\n"),
+            std::string::npos);
+  ASSERT_NE(text.find("jdocs_open_connections{thread=\"test-0\"} 4\n"),
+            std::string::npos);
+  ASSERT_EQ(text.find("100"), std::string::npos);
+}
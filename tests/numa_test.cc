@@ -0,0 +1,53 @@
+// Copyright (c) 2025-2026 Juantgd. All Rights Reserved.
+
+#include "utils/numa.h"
+
+#include <cstring>
+
+#include <gtest/gtest.h>
+
+using namespace jdocs;
+
+TEST(NumaTest, ParseCpuListTest) {
+  std::vector<int> cpus;
+  ASSERT_TRUE(parse_cpu_list("3", &cpus));
+  ASSERT_EQ(cpus, std::vector<int>({3}));
+  ASSERT_TRUE(parse_cpu_list("0-3,8,10-11", &cpus));
+  ASSERT_EQ(cpus, std::vector<int>({0, 1, 2, 3, 8, 10, 11}));
+  ASSERT_FALSE(parse_cpu_list("", &cpus));
+  ASSERT_FALSE(parse_cpu_list("1,", &cpus));
+  ASSERT_FALSE(parse_cpu_list("3-1", &cpus));
+  ASSERT_FALSE(parse_cpu_list("-1", &cpus));
+  ASSERT_FALSE(parse_cpu_list("a", &cpus));
+  ASSERT_FALSE(parse_cpu_list("100000", &cpus));
+  // auto为进程当前允许运行的全部CPU
+  ASSERT_TRUE(parse_cpu_list("auto", &cpus));
+  ASSERT_FALSE(cpus.empty());
+}
+
+TEST(NumaTest, AllocBlockTest) {
+  size_t size = 2048 * 256;
+  char *block = static_cast<char *>(alloc_block(size));
+  ASSERT_NE(block, nullptr);
+  ASSERT_EQ(reinterpret_cast<uintptr_t>(block) & 4095, 0);
+  memset(block, 0xFF, size);
+  free_block(block, size);
+}
+
+TEST(NumaTest, AllocHugeBlockTest) {
+  size_t size = kHugePageSize * 2;
+  // 没有预留大页时退回透明大页，两种方式的内存块都按大页对齐
+  bool hugetlb = true;
+  char *block = static_cast<char *>(alloc_huge_block(size, &hugetlb));
+  ASSERT_NE(block, nullptr);
+  ASSERT_EQ(reinterpret_cast<uintptr_t>(block) & (kHugePageSize - 1), 0);
+  memset(block, 0xFF, size);
+  free_block(block, size);
+  hugetlb = false;
+  block = static_cast<char *>(alloc_huge_block(size, &hugetlb));
+  ASSERT_NE(block, nullptr);
+  ASSERT_FALSE(hugetlb);
+  ASSERT_EQ(reinterpret_cast<uintptr_t>(block) & (kHugePageSize - 1), 0);
+  memset(block, 0xFF, size);
+  free_block(block, size);
+}
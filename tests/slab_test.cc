@@ -0,0 +1,89 @@
+// Copyright (c) 2025-2026 Juantgd. All Rights Reserved.
+
+#include "utils/slab.h"
+
+#include <string>
+
+#include <gtest/gtest.h>
+
+using namespace jdocs;
+
+namespace {
+
+struct Object {
+  Object(int value, int *destroyed) : value(value), destroyed(destroyed) {}
+  ~Object() { ++*destroyed; }
+  int value;
+  int *destroyed;
+};
+
+} // namespace
+
+TEST(SlabTest, SlabBasicTest) {
+  int destroyed = 0;
+  Slab<Object> slab(3, 8);
+  ASSERT_EQ(slab.capacity(), 3);
+  uint32_t a = slab.Allocate();
+  uint32_t b = slab.Allocate();
+  uint32_t c = slab.Allocate();
+  ASSERT_NE(a, 0);
+  ASSERT_NE(b, 0);
+  ASSERT_NE(c, 0);
+  // 槽位已满
+  ASSERT_EQ(slab.Allocate(), 0);
+  // 分配后尚未构造对象
+  ASSERT_EQ(slab.Get(a), nullptr);
+  ASSERT_NE(slab.Emplace(a, 1, &destroyed), nullptr);
+  ASSERT_NE(slab.Emplace(b, 2, &destroyed), nullptr);
+  // 不允许重复构造
+  ASSERT_EQ(slab.Emplace(a, 3, &destroyed), nullptr);
+  ASSERT_EQ(slab.size(), 2);
+  ASSERT_EQ(slab.Get(a)->value, 1);
+  ASSERT_EQ(slab.Get(b)->value, 2);
+  // 按下标遍历时只返回已构造的对象
+  ASSERT_EQ(slab.At(b & 3)->value, 2);
+  ASSERT_EQ(slab.At(c & 3), nullptr);
+  ASSERT_TRUE(slab.Free(a));
+  ASSERT_EQ(destroyed, 1);
+  // 未构造对象的槽位同样可以释放
+  ASSERT_TRUE(slab.Free(c));
+  ASSERT_EQ(destroyed, 1);
+  ASSERT_EQ(slab.size(), 1);
+}
+
+TEST(SlabTest, SlabStaleHandleTest) {
+  int destroyed = 0;
+  Slab<Object> slab(4, 4);
+  uint32_t old_handle = slab.Allocate();
+  slab.Emplace(old_handle, 1, &destroyed);
+  ASSERT_TRUE(slab.Free(old_handle));
+  // 重复释放与过期句柄访问均会被发现
+  ASSERT_FALSE(slab.Free(old_handle));
+  uint32_t new_handle = slab.Allocate();
+  slab.Emplace(new_handle, 2, &destroyed);
+  // 复用同一个槽位，但代数不同
+  ASSERT_EQ(new_handle & 3, old_handle & 3);
+  ASSERT_NE(new_handle, old_handle);
+  ASSERT_EQ(slab.Get(old_handle), nullptr);
+  ASSERT_EQ(slab.Get(new_handle)->value, 2);
+  // 超出容量的下标无效
+  ASSERT_EQ(slab.Get((1U << 2) | 3), nullptr);
+  // 2位代数在回绕时跳过0，句柄不会为0
+  for (int i = 0; i != 10; ++i) {
+    ASSERT_TRUE(slab.Free(new_handle));
+    new_handle = slab.Allocate();
+    ASSERT_NE(new_handle, 0);
+    ASSERT_NE(new_handle >> 2, 0);
+  }
+}
+
+TEST(SlabTest, SlabDestructTest) {
+  int destroyed = 0;
+  {
+    Slab<Object> slab(8, 16);
+    for (int i = 0; i != 5; ++i)
+      slab.Emplace(slab.Allocate(), i, &destroyed);
+  }
+  // 析构时销毁所有仍存活的对象
+  ASSERT_EQ(destroyed, 5);
+}
@@ -2,6 +2,9 @@
 
 #include "core/timer.h"
 
+#include <memory>
+#include <vector>
+
 #include <gtest/gtest.h>
 
 TEST(TimerTest, TimerBasicTest) {
@@ -73,3 +76,126 @@ TEST(TimerTest, TimerBasicTest) {
     ASSERT_EQ(count, 3);
   }
 }
+
+TEST(TimerTest, TimerDestroyFiredTest) {
+  using namespace jdocs;
+  TimeWheel tw;
+  int count = 0, later = 0;
+  auto timer1 =
+      std::make_unique<TimeWheel::timer_node>([&count]() { ++count; });
+  TimeWheel::timer_node timer2([&count]() { ++count; });
+  // 同一槽位中的两个计时器一起触发，timer1位于槽位头部
+  tw.AddTimer(&timer2, 100);
+  tw.AddTimer(timer1.get(), 100);
+  tw.Tick();
+  ASSERT_EQ(count, 2);
+  // 时间轮转过一圈后新的计时器落在同一槽位，之后销毁已触发的节点
+  TimeWheel::timer_node timer3([&later]() { ++later; });
+  for (int i = 0; i != TIME_WHEEL_TVR_SIZE - 1; ++i)
+    tw.Tick();
+  tw.AddTimer(&timer3, 100);
+  timer1.reset();
+  tw.Tick();
+  ASSERT_EQ(later, 1);
+  ASSERT_EQ(count, 2);
+  for (int i = 0; i != TIME_WHEEL_TVR_SIZE; ++i)
+    tw.Tick();
+  ASSERT_EQ(later, 1);
+  ASSERT_EQ(count, 2);
+}
+
+TEST(TimerTest, TimerNextExpiryTest) {
+  using namespace jdocs;
+  TimeWheel tw(10);
+  int count = 0;
+  TimeWheel::timer_node t1([&]() { ++count; });
+  TimeWheel::timer_node t2([&]() { ++count; });
+  ASSERT_EQ(tw.NextExpiry(), UINT64_MAX);
+  // 50个刻度后到期，位于第一层
+  tw.AddTimer(&t1, 500);
+  ASSERT_EQ(tw.NextExpiry(), 50);
+  // 500个刻度后到期，位于第二层，在第256个刻度迁移到第一层
+  tw.AddTimer(&t2, 5000);
+  ASSERT_EQ(tw.NextExpiry(), 50);
+  TimeWheel::timer_cancel(&t1);
+  ASSERT_EQ(tw.NextExpiry(), 256);
+  while (tw.GetCurrentTick() < 256)
+    tw.Tick();
+  ASSERT_EQ(tw.NextExpiry(), 500);
+  while (tw.GetCurrentTick() < 499)
+    tw.Tick();
+  ASSERT_EQ(count, 0);
+  tw.Tick();
+  ASSERT_EQ(count, 1);
+  ASSERT_EQ(tw.NextExpiry(), UINT64_MAX);
+}
+
+namespace {
+
+struct timer_owner {
+  int count{0};
+  jdocs::TimeWheel::timer_node timer =
+      jdocs::TimeWheel::timer_node::Bind<&timer_owner::on_timeout>(this);
+  void on_timeout() { ++count; }
+};
+
+} // namespace
+
+TEST(TimerTest, TimerBindTest) {
+  using namespace jdocs;
+  TimeWheel tw;
+  timer_owner owner;
+  tw.AddTimer(&owner.timer, 200);
+  tw.Tick();
+  ASSERT_EQ(owner.count, 0);
+  tw.Tick();
+  ASSERT_EQ(owner.count, 1);
+  ASSERT_TRUE(owner.timer.IsFired());
+  // 计时器可以重复添加
+  tw.AddTimer(&owner.timer, 100);
+  tw.Tick();
+  ASSERT_EQ(owner.count, 2);
+}
+
+namespace {
+
+struct precise_owner {
+  std::vector<int> *fired;
+  int id;
+  jdocs::TimerHeap::timer_node timer =
+      jdocs::TimerHeap::timer_node::Bind<&precise_owner::on_timeout>(this);
+  void on_timeout() { fired->push_back(id); }
+};
+
+} // namespace
+
+TEST(TimerTest, TimerHeapTest) {
+  using namespace jdocs;
+  TimerHeap heap;
+  std::vector<int> fired;
+  precise_owner a{&fired, 1}, b{&fired, 2}, c{&fired, 3}, d{&fired, 4};
+  heap.Add(&a.timer, 300);
+  heap.Add(&b.timer, 100);
+  heap.Add(&c.timer, 200);
+  heap.Add(&d.timer, 400);
+  ASSERT_EQ(heap.NextDeadline(), 100u);
+  // 修改到期时间后重新排序
+  heap.Add(&a.timer, 50);
+  ASSERT_EQ(heap.NextDeadline(), 50u);
+  heap.Cancel(&c.timer);
+  ASSERT_FALSE(c.timer.IsPending());
+  ASSERT_EQ(heap.Run(49), 0u);
+  ASSERT_EQ(heap.Run(300), 2u);
+  ASSERT_EQ(fired, (std::vector<int>{1, 2}));
+  ASSERT_EQ(heap.NextDeadline(), 400u);
+  {
+    // 节点析构时从堆中移除
+    precise_owner e{&fired, 5};
+    heap.Add(&e.timer, 350);
+    ASSERT_EQ(heap.size(), 2u);
+  }
+  ASSERT_EQ(heap.size(), 1u);
+  ASSERT_EQ(heap.Run(1000), 1u);
+  ASSERT_EQ(fired, (std::vector<int>{1, 2, 4}));
+  ASSERT_EQ(heap.NextDeadline(), UINT64_MAX);
+}
@@ -0,0 +1,53 @@
+// Copyright (c) 2025-2026 Juantgd. All Rights Reserved.
+
+#include "core/upgrade.h"
+
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <gtest/gtest.h>
+
+using namespace jdocs;
+
+TEST(UpgradeTest, UpgradeMessageTest) {
+  int socks[2];
+  ASSERT_EQ(socketpair(AF_UNIX, SOCK_SEQPACKET, 0, socks), 0);
+  int pipe_fds[2];
+  ASSERT_EQ(pipe(pipe_fds), 0);
+  // 超过单个数据包大小的载荷会被拆分发送
+  std::string large(100 * 1024 + 7, '\0');
+  for (size_t i = 0; i != large.size(); ++i)
+    large[i] = static_cast<char>('a' + i % 26);
+  std::thread sender([&] {
+    ASSERT_EQ(upgrade_send(socks[0], kUpgradeConn, large, &pipe_fds[1], 1), 0);
+    ASSERT_EQ(upgrade_send(socks[0], kUpgradeEnd, std::string()), 0);
+  });
+  uint32_t type;
+  std::string payload;
+  std::vector<int> fds;
+  ASSERT_EQ(upgrade_recv(socks[1], &type, &payload, &fds), 0);
+  ASSERT_EQ(type, kUpgradeConn);
+  ASSERT_EQ(payload, large);
+  ASSERT_EQ(fds.size(), 1);
+  // 收到的文件描述符与发送方的指向同一个管道
+  ASSERT_EQ(write(fds[0], "x", 1), 1);
+  char c;
+  ASSERT_EQ(read(pipe_fds[0], &c, 1), 1);
+  ASSERT_EQ(c, 'x');
+  close(fds[0]);
+  ASSERT_EQ(upgrade_recv(socks[1], &type, &payload, &fds), 0);
+  ASSERT_EQ(type, kUpgradeEnd);
+  ASSERT_TRUE(payload.empty());
+  ASSERT_TRUE(fds.empty());
+  sender.join();
+  // 对端关闭后接收失败
+  close(socks[0]);
+  ASSERT_EQ(upgrade_recv(socks[1], &type, &payload, &fds), -1);
+  close(socks[1]);
+  close(pipe_fds[0]);
+  close(pipe_fds[1]);
+}